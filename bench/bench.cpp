@@ -0,0 +1,735 @@
+/*
+*  Benchmarks of the REL loader, run against the stand-in of the IDA SDK
+*  in stub/ on a generated corpus.
+*
+*  bench [-q] [-v] [-f prefix] [-d corpus dir] [-o results] [-c baseline [-t percent]]
+*
+*/
+
+#include "bench_gen.h"
+#include "stub/ida_stub.h"
+#include "../rel/rel_cache.h"
+#include "../rel/rel_decode.h"
+#include "../rel/rel_gcm.h"
+#include "../rel/rel_engine.h"
+#include "../rel/rel_index.h"
+#include "../rel/rel_link.h"
+#include "../rel/rel_map.h"
+#include "../rel/rel_rso.h"
+#include "../rel/rel_symbols.h"
+#include "../rel/rel_track.h"
+#include "../rel/rel_yaz0.h"
+#include "../dol/dol_image.h"
+#include "../loader/ldr_trace.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+#define RESULTS_VERSION 1
+#define MIN_SECONDS     0.2     // minimum time spent in each round
+#define ROUNDS          3       // the best round is kept
+#define NUM_SIBLINGS    16      // modules next to the loaded one
+#define NUM_DISCOVERED  64      // modules indexed by the discovery benchmark
+#define NUM_LINKED      64      // modules linked by the whole game benchmark
+#define NUM_RSO         8       // RSO modules next to the loaded one
+#define NUM_DISC_OTHER  1000    // files that aren't modules on the disc image
+#define DOL_SEGMENT     0x80000 // segment size of the seeding benchmark, 9 MB in all
+
+struct bench_result
+{
+  std::string m_name;
+  uint32_t m_size;        // relocations, or modules for discovery and linking
+  double m_seconds;       // per iteration
+  double m_rate;          // items per second
+};
+
+struct bench_config
+{
+  std::string m_corpus;
+  std::string m_filter;
+  bool m_quick;
+};
+
+static std::vector<bench_result> g_results;
+
+// Seconds per call of fn, the best of a few rounds of repeated calls
+static double measure(std::function<void()> const &fn)
+{
+  typedef std::chrono::steady_clock clock;
+  double best = 0;
+  for (int round = 0; round < ROUNDS; ++round)
+  {
+    uint64_t iterations = 0;
+    double seconds = 0;
+    clock::time_point start = clock::now();
+    do
+    {
+      fn();
+      ++iterations;
+      seconds = std::chrono::duration<double>(clock::now() - start).count();
+    } while (seconds < MIN_SECONDS);
+
+    double per_call = seconds / iterations;
+    if (round == 0 || per_call < best)
+      best = per_call;
+  }
+  return best;
+}
+
+static bool selected(bench_config const &config, char const *name)
+{
+  return config.m_filter.empty() || strncmp(name, config.m_filter.c_str(), config.m_filter.size()) == 0;
+}
+
+static void run(bench_config const &config, char const *name, uint32_t size, uint64_t items, std::function<void()> const &fn)
+{
+  if (!selected(config, name))
+    return;
+
+  bench_result result;
+  result.m_name = name;
+  result.m_size = size;
+  result.m_seconds = measure(fn);
+  result.m_rate = items / result.m_seconds;
+  g_results.push_back(result);
+  printf("%-12s %8u %14.3f us %14.0f items/s\n", name, size, result.m_seconds * 1e6, result.m_rate);
+  fflush(stdout);
+
+  // Phases of every repetition, only shown with -v
+  ldr_trace::get().report(name, nullptr);
+}
+
+// Decodes every import list of a module, as rel_track does
+static bool decode_module(std::vector<uint8_t> const &file, std::vector<rel_stream> &streams)
+{
+  uint8_t const *data = file.data();
+  uint32_t num_sections = read_be32(data + offsetof(relhdr, info.num_sections));
+  uint32_t section_offset = read_be32(data + offsetof(relhdr, info.section_offset));
+  uint32_t import_offset = read_be32(data + offsetof(relhdr, import_offset));
+  uint32_t import_size = read_be32(data + offsetof(relhdr, import_size));
+
+  uint32_t sizes[256];
+  for (uint32_t i = 0; i < num_sections; ++i)
+    sizes[i] = read_be32(data + section_offset + i * sizeof(section_entry) + 4);
+
+  streams.resize(import_size / sizeof(import_entry));
+  for (size_t i = 0; i < streams.size(); ++i)
+  {
+    uint32_t offset = read_be32(data + import_offset + i * sizeof(import_entry) + 4);
+    streams[i].clear();
+    rel_decode_result result = rel_decode_stream(data + offset, file.size() - offset, sizes, num_sections, streams[i]);
+    if (result.m_status != REL_DECODE_OK)
+      return false;
+  }
+  return true;
+}
+
+// Loaded sections of a module, as if it was loaded at START
+static std::vector<rel_section_image> module_images(std::vector<uint8_t> const &file)
+{
+  uint8_t const *data = file.data();
+  uint32_t num_sections = read_be32(data + offsetof(relhdr, info.num_sections));
+  uint32_t section_offset = read_be32(data + offsetof(relhdr, info.section_offset));
+
+  std::vector<rel_section_image> images(num_sections);
+  uint32_t base = START;
+  for (uint32_t i = 0; i < num_sections; ++i)
+  {
+    uint32_t offset = SECTION_OFF(read_be32(data + section_offset + i * sizeof(section_entry)));
+    uint32_t size = read_be32(data + section_offset + i * sizeof(section_entry) + 4);
+    images[i].m_base = size != 0 ? base : 0;
+    images[i].m_size = size;
+    images[i].m_data = offset != 0 ? data + offset : nullptr;
+    base += size;
+  }
+  return images;
+}
+
+static int idaapi list_cb(char const *file, void *ud)
+{
+  static_cast<std::vector<std::string> *>(ud)->push_back(file);
+  return 0;
+}
+
+static void bench_discovery(bench_config const &config)
+{
+  if (!selected(config, "discover"))
+    return;
+
+  std::string dir = config.m_corpus + "/discover";
+  make_dir(dir.c_str());
+  bench_rel_options options;
+  std::vector<std::string> files = bench_write_corpus(dir, NUM_DISCOVERED, options);
+  if (files.empty())
+  {
+    printf("discover: unable to write the corpus to %s\n", dir.c_str());
+    return;
+  }
+  std::string index_path = dir + "/" + INDEX_FILENAME;
+
+  // Listing and parsing every module, as on the first load
+  run(config, "discover", NUM_DISCOVERED, NUM_DISCOVERED, [&]()
+  {
+    remove(index_path.c_str());
+    std::vector<std::string> found;
+    enumerate_files(nullptr, 0, dir.c_str(), "*.rel", &list_cb, &found);
+    rel_index index(dir);
+    index.load();
+    index.refresh(found);
+    index.save();
+  });
+
+  // Listing and checking the stamps against the saved index
+  run(config, "discover-idx", NUM_DISCOVERED, NUM_DISCOVERED, [&]()
+  {
+    std::vector<std::string> found;
+    enumerate_files(nullptr, 0, dir.c_str(), "*.rel", &list_cb, &found);
+    rel_index index(dir);
+    index.load();
+    index.refresh(found);
+    index.save();
+  });
+
+  // The first load of Yaz0 compressed modules, decoding their headers only
+  std::string szs_dir = config.m_corpus + "/discover-szs";
+  make_dir(szs_dir.c_str());
+  if (bench_write_corpus(szs_dir, NUM_DISCOVERED, options, true).empty())
+  {
+    printf("discover-szs: unable to write the corpus to %s\n", szs_dir.c_str());
+    return;
+  }
+  std::string szs_index_path = szs_dir + "/" + INDEX_FILENAME;
+  run(config, "discover-szs", NUM_DISCOVERED, NUM_DISCOVERED, [&]()
+  {
+    remove(szs_index_path.c_str());
+    std::vector<std::string> found;
+    enumerate_files(nullptr, 0, szs_dir.c_str(), YAZ0_PATTERN, &list_cb, &found);
+    rel_index index(szs_dir);
+    index.load();
+    index.refresh(found);
+    index.save();
+  });
+}
+
+// Function seeding of a DOL with every segment in use, in bytes scanned
+static void bench_dol(bench_config const &config)
+{
+  if (!selected(config, "dol-seed"))
+    return;
+
+  bench_dol_options options;
+  options.m_num_text = 7;
+  options.m_num_data = 11;
+  options.m_section_size = DOL_SEGMENT;
+  std::string path = config.m_corpus + "/seed.dol";
+  std::vector<uint8_t> file = bench_make_dol(options);
+  if (!bench_write_file(path, file))
+  {
+    printf("dol-seed: unable to write %s\n", path.c_str());
+    return;
+  }
+
+  // Seeding works on the contents the load read
+  linput_t *li = open_linput(path.c_str(), false);
+  dolhdr dhdr;
+  dol_contents contents;
+  bool parsed = dol_read_header(li, &dhdr) != 0 && dol_read_contents(li, &dhdr, &contents) != 0;
+  close_linput(li);
+  if (!parsed)
+  {
+    printf("dol-seed: generated DOL doesn't parse\n");
+    return;
+  }
+  run(config, "dol-seed", static_cast<uint32_t>(file.size() >> 20), file.size(), [&]()
+  {
+    dol_seed_functions(&dhdr, &contents);
+  });
+}
+
+// main.dol and every module loaded into one database
+static void bench_link(bench_config const &config)
+{
+  if (!selected(config, "link"))
+    return;
+
+  std::string dir = config.m_corpus + "/link";
+  make_dir(dir.c_str());
+  bench_rel_options options;
+  if (bench_write_corpus(dir, NUM_LINKED, options).empty())
+  {
+    printf("link: unable to write the corpus to %s\n", dir.c_str());
+    return;
+  }
+
+  std::string dol = dir + "/" + LINK_DOL_NAME;
+  stub_set_database_path((dir + "/bench.idb").c_str());
+  stub_reset();
+  run(config, "link", NUM_LINKED, NUM_LINKED, [&]()
+  {
+    linput_t *li = open_linput(dol.c_str(), false);
+    rel_link game(dir);
+    game.load(li, false, false, nullptr);
+    close_linput(li);
+  });
+
+  // The same game read from a disc image, without extracting anything
+  std::string disc_path = config.m_corpus + "/game.gcm";
+  if (!bench_write_disc(disc_path, NUM_LINKED, NUM_DISC_OTHER, options))
+  {
+    printf("link-disc: unable to write %s\n", disc_path.c_str());
+    return;
+  }
+
+  // Mapping the image and walking its FST
+  run(config, "link-disc-fst", NUM_LINKED, NUM_LINKED + NUM_DISC_OTHER, [&]()
+  {
+    rel_gcm disc;
+    disc.open(disc_path.c_str());
+  });
+
+  run(config, "link-disc", NUM_LINKED, NUM_LINKED, [&]()
+  {
+    rel_gcm disc;
+    if (!disc.open(disc_path.c_str()))
+      return;
+    linput_t *li = disc.open_linput(disc.get_main());
+    rel_link game(dir, &disc);
+    game.load(li, false, false, nullptr);
+    close_linput(li);
+  });
+}
+
+static void bench_module(bench_config const &config, uint32_t num_relocations)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "/%u", num_relocations);
+  std::string dir = config.m_corpus + name;
+  make_dir(dir.c_str());
+
+  // Small siblings, so imports resolve to real modules
+  bench_rel_options sibling;
+  if (bench_write_corpus(dir, NUM_SIBLINGS, sibling).empty())
+  {
+    printf("unable to write the corpus to %s\n", dir.c_str());
+    return;
+  }
+
+  // The module being measured replaces the first sibling
+  bench_rel_options options;
+  options.m_num_relocations = num_relocations;
+  options.m_imports.push_back(0);
+  options.m_imports.push_back(2);
+  options.m_imports.push_back(3);
+  std::vector<uint8_t> file = bench_make_rel(options);
+  std::string path = dir + "/m0001.rel";
+  if (!bench_write_file(path, file))
+    return;
+
+  // Header checks only
+  run(config, "probe", num_relocations, 1, [&]()
+  {
+    volatile bool ok = rel_probe_header(file.data(), file.size(), file.size());
+    (void)ok;
+  });
+
+  // Header and section table through an input
+  run(config, "header", num_relocations, 1, [&]()
+  {
+    linput_t *li = open_linput(path.c_str(), false);
+    rel_track track(li);
+    close_linput(li);
+  });
+
+  std::vector<rel_stream> streams;
+  if (!decode_module(file, streams))
+  {
+    printf("%s: generated module doesn't decode\n", path.c_str());
+    return;
+  }
+
+  run(config, "decode", num_relocations, num_relocations, [&]()
+  {
+    decode_module(file, streams);
+  });
+
+  // Relocations against the module itself, and imports with their slots
+  // already resolved
+  std::vector<rel_section_image> images = module_images(file);
+  std::vector<std::vector<uint32_t> > resolved(streams.size());
+  for (size_t i = 1; i < streams.size(); ++i)
+  {
+    resolved[i].resize(streams[i].size());
+    for (size_t k = 0; k < streams[i].size(); ++k)
+      resolved[i][k] = 0x81000000 + static_cast<uint32_t>(k) * 4;
+  }
+
+  std::vector<rel_patch> patches;
+  rel_engine_stats stats;
+  run(config, "relocate", num_relocations, num_relocations, [&]()
+  {
+    patches.clear();
+    rel_engine_reset(stats);
+    for (size_t i = 0; i < streams.size(); ++i)
+    {
+      rel_relocate(streams[i], images.data(), images.size(), images.data(), images.size(),
+                   i == 0 ? nullptr : resolved[i].data(), patches, stats);
+    }
+  });
+
+  // The whole load, committed to the stub
+  std::string database = dir + "/bench.idb";
+  stub_set_database_path(database.c_str());
+  stub_reset();
+
+  // A dry run leaves neither the module index nor a plan cache behind
+  {
+    linput_t *li = open_linput(path.c_str(), false);
+    rel_track track(li);
+    char cache[32];
+    snprintf(cache, sizeof(cache), CACHE_FORMAT, track.get_id());
+    std::string files[] = { dir + "/" + INDEX_FILENAME, dir + "/" + cache };
+    for (size_t i = 0; i < 2; ++i)
+      remove(files[i].c_str());
+    track.set_plan_cache(true);
+    track.apply_patches(true);
+    close_linput(li);
+    for (size_t i = 0; i < 2; ++i)
+    {
+      FILE *fp = fopen(files[i].c_str(), "rb");
+      if (fp != nullptr)
+      {
+        fclose(fp);
+        printf("%s: dry run wrote %s\n", path.c_str(), files[i].c_str());
+      }
+    }
+  }
+  run(config, "load", num_relocations, num_relocations, [&]()
+  {
+    linput_t *li = open_linput(path.c_str(), false);
+    rel_track track(li);
+    track.apply_patches(false);
+    close_linput(li);
+  });
+
+  // The same load against unchanged siblings, served from the plan cache
+  run(config, "load-cached", num_relocations, num_relocations, [&]()
+  {
+    linput_t *li = open_linput(path.c_str(), false);
+    rel_track track(li);
+    track.set_plan_cache(true);
+    track.apply_patches(false);
+    close_linput(li);
+  });
+
+  // Reloading the unchanged module into the database of a load
+  if (selected(config, "reload"))
+  {
+    linput_t *li = open_linput(path.c_str(), false);
+    rel_track track(li);
+    track.apply_patches(false);
+    close_linput(li);
+  }
+  run(config, "reload", num_relocations, num_relocations, [&]()
+  {
+    linput_t *li = open_linput(path.c_str(), false);
+    rel_track track(li);
+    track.apply_patches(false, true);
+    close_linput(li);
+  });
+
+  // Yaz0 decompression, counted in bytes produced
+  std::vector<uint8_t> packed = bench_yaz0_encode(file);
+  std::vector<uint8_t> unpacked(file.size());
+  if (rel_yaz0_decode(packed.data() + YAZ0_HEADER_SIZE, packed.size() - YAZ0_HEADER_SIZE, unpacked.data(), unpacked.size()) != file.size() ||
+      unpacked != file)
+  {
+    printf("%s: compressed module doesn't round trip\n", path.c_str());
+    return;
+  }
+  run(config, "yaz0", num_relocations, file.size(), [&]()
+  {
+    rel_yaz0_decode(packed.data() + YAZ0_HEADER_SIZE, packed.size() - YAZ0_HEADER_SIZE, unpacked.data(), unpacked.size());
+  });
+
+  // Only the header and section table, as module discovery does
+  run(config, "yaz0-header", num_relocations, 1, [&]()
+  {
+    rel_yaz0_decode(packed.data() + YAZ0_HEADER_SIZE, packed.size() - YAZ0_HEADER_SIZE, unpacked.data(), INDEX_YAZ0_PEEK);
+  });
+
+  // The whole load of the compressed module
+  std::string szs_path = path + YAZ0_EXTENSION;
+  if (!bench_write_file(szs_path, packed))
+    return;
+  run(config, "load-szs", num_relocations, num_relocations, [&]()
+  {
+    linput_t *li = open_linput(szs_path.c_str(), false);
+    rel_track track(li);
+    track.apply_patches(false);
+    close_linput(li);
+  });
+  remove(szs_path.c_str());
+}
+
+static void bench_rso(bench_config const &config, uint32_t num_relocations)
+{
+  if (!selected(config, "rso"))
+    return;
+
+  char name[32];
+  snprintf(name, sizeof(name), "/rso%u", num_relocations);
+  std::string dir = config.m_corpus + name;
+  make_dir(dir.c_str());
+
+  // Siblings export as many names as the module has relocations, the
+  // module imports a quarter of them from the main program and the others
+  uint32_t num_exports = num_relocations / NUM_RSO;
+  if (bench_write_rso_corpus(dir, NUM_RSO, num_exports).empty())
+  {
+    printf("rso: unable to write the corpus to %s\n", dir.c_str());
+    return;
+  }
+
+  bench_rso_options options;
+  options.m_name = "target";
+  options.m_num_relocations = num_relocations;
+  options.m_self_percent = 40;
+  uint32_t state = num_relocations;
+  for (uint32_t i = 0; i < num_relocations / 4; ++i)
+  {
+    state = state * 1664525 + 1013904223;
+    uint32_t module = (state >> 8) % (NUM_RSO + 1);
+    char import[64];
+    if (module == 0)
+      snprintf(import, sizeof(import), "main_%u", (state >> 4) % num_exports);
+    else
+      snprintf(import, sizeof(import), "r%04u_%u", module, (state >> 4) % num_exports);
+    options.m_imports.push_back(import);
+  }
+  std::string path = dir + "/target.rso";
+  if (!bench_write_file(path, bench_make_rso(options)))
+    return;
+
+  // Indexing the exports of the siblings, then resolving every import
+  std::vector<std::vector<uint8_t> > files;
+  for (uint32_t id = 0; id <= NUM_RSO; ++id)
+  {
+    char file[32];
+    snprintf(file, sizeof(file), id == 0 ? "/main.sel" : "/r%04u.rso", id);
+    linput_t *li = open_linput((dir + file).c_str(), false);
+    std::vector<uint8_t> data(static_cast<size_t>(qlsize(li)));
+    qlread(li, data.data(), data.size());
+    close_linput(li);
+    files.push_back(data);
+  }
+
+  rel_export_index index;
+  run(config, "rso-index", num_relocations, NUM_RSO * num_exports, [&]()
+  {
+    index.clear();
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+      rel_rso_tables tables;
+      rel_rso_read_tables(files[i].data(), tables);
+      uint32_t bases[8] = { 0, 0x80500000, 0x80510000, 0x80520000, 0x80530000, 0x80540000, 0x80550000, 0 };
+      index.add_module(static_cast<uint32_t>(i), files[i].data(), files[i].size(), tables, i == 0 ? nullptr : bases, 8);
+    }
+    index.build();
+  });
+
+  run(config, "rso-resolve", num_relocations, options.m_imports.size(), [&]()
+  {
+    size_t found = 0;
+    rel_export symbol;
+    for (auto it = options.m_imports.begin(); it != options.m_imports.end(); ++it)
+      found += index.find(it->c_str(), symbol);
+    volatile size_t sink = found;
+    (void)sink;
+  });
+
+  // The whole load of the module, resolving against the siblings
+  stub_set_database_path((dir + "/bench.idb").c_str());
+  stub_reset();
+  run(config, "rso-load", num_relocations, num_relocations, [&]()
+  {
+    linput_t *li = open_linput(path.c_str(), false);
+    rel_track track(li);
+    track.apply_patches(false);
+    close_linput(li);
+  });
+}
+
+static void bench_map(bench_config const &config, uint32_t num_symbols)
+{
+  if (!selected(config, "map") && !selected(config, "symbols"))
+    return;
+
+  char name[32];
+  snprintf(name, sizeof(name), "/symbols%u.map", num_symbols);
+  std::string path = config.m_corpus + name;
+  std::string text = bench_make_map(num_symbols, false, num_symbols);
+  if (!bench_write_file(path, std::vector<uint8_t>(text.begin(), text.end())))
+    return;
+
+  // A module with only the .text and .data sections of the map
+  std::vector<section_entry> sections(3);
+  sections[1].file_offset = 0x100 | SECTION_EXEC;
+  sections[2].file_offset = 0x100;
+  sections[1].size = sections[2].size = 0x10000000;
+
+  rel_map map;
+  std::string mismatch;
+  if (!map.load(path.c_str(), false) || !map.match_sections(sections, mismatch) || map.size() != num_symbols)
+  {
+    printf("%s: parsed %u of %u symbols\n", path.c_str(), static_cast<unsigned>(map.size()), num_symbols);
+    return;
+  }
+
+  run(config, "map", num_symbols, num_symbols, [&]()
+  {
+    map.load(path.c_str(), false);
+  });
+
+  // Nearest symbol lookups of import targets, spread over the sections
+  rel_symbol_index index;
+  index.add_module(0, map);
+  std::vector<uint32_t> targets(num_symbols);
+  uint32_t state = num_symbols;
+  uint32_t extent = map.get_symbol(map.size() - 1).m_offset + 0x100;
+  for (size_t i = 0; i < targets.size(); ++i)
+  {
+    state = state * 1664525 + 1013904223;
+    targets[i] = state % extent;
+  }
+
+  run(config, "symbols", num_symbols, num_symbols, [&]()
+  {
+    uint32_t delta;
+    size_t found = 0;
+    for (size_t i = 0; i < targets.size(); ++i)
+      found += index.find(0, (i & 1) ? 2 : 1, targets[i], delta) != nullptr;
+    volatile size_t sink = found;
+    (void)sink;
+  });
+}
+
+static bool write_results(char const *path)
+{
+  FILE *fp = fopen(path, "w");
+  if (fp == nullptr)
+    return false;
+
+  fprintf(fp, "# rel loader benchmarks %d\n", RESULTS_VERSION);
+  fprintf(fp, "# name size seconds items_per_second\n");
+  for (auto it = g_results.begin(); it != g_results.end(); ++it)
+    fprintf(fp, "%s %u %.9f %.1f\n", it->m_name.c_str(), it->m_size, it->m_seconds, it->m_rate);
+  return fclose(fp) == 0;
+}
+
+// Compares with the results of an earlier run, returns the number of
+// benchmarks that got slower than tolerance percent
+static int compare_results(char const *path, double tolerance)
+{
+  FILE *fp = fopen(path, "r");
+  if (fp == nullptr)
+  {
+    printf("unable to open %s\n", path);
+    return -1;
+  }
+
+  std::map<std::pair<std::string, uint32_t>, double> baseline;
+  char line[256];
+  while (fgets(line, sizeof(line), fp) != nullptr)
+  {
+    char name[64];
+    unsigned size;
+    double seconds, rate;
+    if (line[0] != '#' && sscanf(line, "%63s %u %lf %lf", name, &size, &seconds, &rate) == 4)
+      baseline[std::make_pair(std::string(name), static_cast<uint32_t>(size))] = rate;
+  }
+  fclose(fp);
+
+  int regressions = 0;
+  printf("\ncompared with %s:\n", path);
+  for (auto it = g_results.begin(); it != g_results.end(); ++it)
+  {
+    auto old = baseline.find(std::make_pair(it->m_name, it->m_size));
+    if (old == baseline.end() || old->second <= 0)
+      continue;
+
+    double change = (it->m_rate / old->second - 1) * 100;
+    bool regressed = change < -tolerance;
+    regressions += regressed;
+    printf("%-12s %8u %+8.1f%%%s\n", it->m_name.c_str(), it->m_size, change, regressed ? "  REGRESSION" : "");
+  }
+  return regressions;
+}
+
+int main(int argc, char **argv)
+{
+  bench_config config;
+  config.m_corpus = "bench_corpus";
+  config.m_quick = false;
+  char const *output = "bench_results.txt";
+  char const *baseline = nullptr;
+  double tolerance = 10;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "-q") == 0)
+      config.m_quick = true;
+    else if (strcmp(argv[i], "-v") == 0)
+      stub_set_verbose(true);
+    else if (strcmp(argv[i], "-f") == 0 && has_value)
+      config.m_filter = argv[++i];
+    else if (strcmp(argv[i], "-d") == 0 && has_value)
+      config.m_corpus = argv[++i];
+    else if (strcmp(argv[i], "-o") == 0 && has_value)
+      output = argv[++i];
+    else if (strcmp(argv[i], "-c") == 0 && has_value)
+      baseline = argv[++i];
+    else if (strcmp(argv[i], "-t") == 0 && has_value)
+      tolerance = atof(argv[++i]);
+    else
+    {
+      printf("usage: %s [-q] [-v] [-f prefix] [-d corpus dir] [-o results] [-c baseline [-t percent]]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  make_dir(config.m_corpus.c_str());
+
+  bench_discovery(config);
+  bench_link(config);
+  bench_dol(config);
+
+  uint32_t sizes[] = { 1000, 10000, 100000, 1000000 };
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+  {
+    if (config.m_quick && sizes[i] > 100000)
+      break;
+    bench_module(config, sizes[i]);
+    bench_rso(config, sizes[i]);
+    bench_map(config, sizes[i]);
+  }
+
+  if (!write_results(output))
+    printf("unable to write %s\n", output);
+
+  if (baseline != nullptr)
+    return compare_results(baseline, tolerance) != 0 ? 1 : 0;
+  return 0;
+}
@@ -0,0 +1,855 @@
+#include "bench_gen.h"
+#include "../rel/rel_decode.h"
+#include "../rel/rel_rso.h"
+#include "../rel/rel_yaz0.h"
+#include "../loader/gcm.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#define MAIN_ADDRESS 0x80003100
+#define MAIN_SIZE    0x00300000
+
+#define PPC_NOP      0x60000000
+#define PPC_BL       0x48000001
+#define PPC_LIS_R3   0x3C600000
+#define PPC_ADDI_R3  0x38630000
+#define PPC_STWU_R1  0x9421FFF0   // stwu r1, -0x10(r1)
+#define PPC_MFLR_R0  0x7C0802A6
+
+#define DOL_FUNCTION 64           // words per function of a generated DOL
+
+bench_rel_options::bench_rel_options()
+  : m_id(1)
+  , m_version(3)
+  , m_num_sections(8)
+  , m_section_size(0)
+  , m_bss_size(0x1000)
+  , m_num_relocations(1000)
+  , m_self_percent(60)
+  , m_seed(1)
+{}
+
+bench_rso_options::bench_rso_options()
+  : m_name("module")
+  , m_num_sections(8)
+  , m_bss_size(0x1000)
+  , m_num_relocations(1000)
+  , m_self_percent(60)
+  , m_num_exports(64)
+  , m_seed(1)
+{}
+
+bench_dol_options::bench_dol_options()
+  : m_num_text(2)
+  , m_num_data(8)
+  , m_section_size(0x10000)
+  , m_bss_size(0x10000)
+  , m_address(MAIN_ADDRESS)
+  , m_seed(1)
+{}
+
+// xorshift32, never returns 0 for a non zero state
+static uint32_t next_random(uint32_t &state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static uint32_t align_up(uint32_t value, uint32_t align)
+{
+  return (value + align - 1) & ~(align - 1);
+}
+
+static uint8_t pick_type(std::vector<bench_rel_mix> const &mix, uint32_t total, uint32_t &state)
+{
+  uint32_t roll = next_random(state) % total;
+  for (auto it = mix.begin(); it != mix.end(); ++it)
+  {
+    if (roll < it->m_weight)
+      return it->m_type;
+    roll -= it->m_weight;
+  }
+  return mix.back().m_type;
+}
+
+// Instruction a site of a relocation type is found in
+static uint32_t site_template(uint8_t type)
+{
+  switch (type)
+  {
+  case R_PPC_REL24:
+  case R_PPC_ADDR24:
+    return PPC_BL;
+  case R_PPC_ADDR16_HA:
+  case R_PPC_ADDR16_HI:
+    return PPC_LIS_R3;
+  case R_PPC_ADDR16_LO:
+  case R_PPC_ADDR16:
+    return PPC_ADDI_R3;
+  default:
+    return 0;
+  }
+}
+
+std::vector<section_entry> bench_rel_sections(bench_rel_options const &options)
+{
+  uint32_t num_sections = options.m_num_sections < 3 ? 3 : options.m_num_sections;
+  uint32_t file_sections = num_sections - 2;
+
+  // Every relocation gets a word of its own
+  uint32_t size = options.m_section_size;
+  if (size == 0)
+    size = align_up((options.m_num_relocations / file_sections + 16) * 4, 32);
+
+  std::vector<section_entry> sections(num_sections);
+  uint32_t offset = align_up(sizeof(relhdr) + num_sections * sizeof(section_entry), 32);
+  for (uint32_t i = 1; i <= file_sections; ++i)
+  {
+    // Code and data alternate
+    sections[i].file_offset = offset | ((i & 1) ? SECTION_EXEC : 0);
+    sections[i].size = size;
+    offset += size;
+  }
+  sections[num_sections - 1].file_offset = 0;
+  sections[num_sections - 1].size = options.m_bss_size;
+  return sections;
+}
+
+struct gen_relocation
+{
+  uint32_t m_word;      // index of the site among all words of the module
+  uint8_t  m_type;
+  uint8_t  m_section;
+  uint32_t m_addend;
+};
+
+std::vector<uint8_t> bench_make_rel(bench_rel_options const &options)
+{
+  std::vector<section_entry> sections = bench_rel_sections(options);
+  uint32_t num_sections = static_cast<uint32_t>(sections.size());
+  uint32_t file_sections = num_sections - 2;
+  uint32_t section_size = sections[1].size;
+  uint32_t words_per_section = section_size / 4;
+  uint32_t state = options.m_seed != 0 ? options.m_seed : 1;
+
+  std::vector<bench_rel_mix> mix = options.m_mix;
+  if (mix.empty())
+  {
+    bench_rel_mix standard[] =
+    {
+      { R_PPC_REL24,     50 },
+      { R_PPC_ADDR16_HA, 15 },
+      { R_PPC_ADDR16_LO, 15 },
+      { R_PPC_ADDR32,    20 },
+    };
+    mix.assign(standard, standard + 4);
+  }
+  uint32_t total_weight = 0;
+  for (auto it = mix.begin(); it != mix.end(); ++it)
+    total_weight += it->m_weight;
+  if (total_weight == 0)
+    return std::vector<uint8_t>();
+
+  // The module imports from itself first, then from the others
+  std::vector<uint32_t> imports(1, options.m_id);
+  imports.insert(imports.end(), options.m_imports.begin(), options.m_imports.end());
+
+  uint32_t num_imports = static_cast<uint32_t>(imports.size());
+  uint32_t self_count = static_cast<uint32_t>(static_cast<uint64_t>(options.m_num_relocations) * options.m_self_percent / 100);
+  if (num_imports == 1)
+    self_count = options.m_num_relocations;
+
+  // Every relocation patches a word of its own. Words are handed out to
+  // the imports in a shuffled order so the sites of the imports interleave,
+  // walking them in order keeps every list sorted.
+  uint32_t max_words = file_sections * words_per_section;
+  uint32_t num_relocations = options.m_num_relocations < max_words ? options.m_num_relocations : max_words;
+  std::vector<uint32_t> owner(num_relocations, 0);
+  for (uint32_t i = self_count, m = 1; i < num_relocations; ++i, m = m % (num_imports - 1) + 1)
+    owner[i] = m;
+  for (uint32_t i = num_relocations; i > 1; --i)
+    std::swap(owner[i - 1], owner[next_random(state) % i]);
+
+  std::vector<std::vector<gen_relocation> > lists(num_imports);
+  for (uint32_t word = 0; word < num_relocations; ++word)
+  {
+    uint32_t m = owner[word];
+    gen_relocation rel;
+    rel.m_word = word;
+    rel.m_type = pick_type(mix, total_weight, state);
+    if (imports[m] == 0)
+    {
+      rel.m_section = 0;
+      rel.m_addend = (MAIN_ADDRESS + next_random(state) % MAIN_SIZE) & ~3u;
+    }
+    else
+    {
+      rel.m_section = static_cast<uint8_t>(1 + next_random(state) % (num_sections - 1));
+      uint32_t target_size = sections[rel.m_section].size;
+      rel.m_addend = target_size != 0 ? (next_random(state) % target_size) & ~3u : 0;
+    }
+    lists[m].push_back(rel);
+  }
+
+  // Layout: header, section table, sections, import table, relocations
+  uint32_t import_offset = SECTION_OFF(sections[file_sections].file_offset) + section_size;
+  uint32_t import_size = num_imports * sizeof(import_entry);
+  uint32_t rel_offset = align_up(import_offset + import_size, 4);
+
+  std::vector<uint8_t> out(rel_offset);
+
+  // Sections, with each relocation site holding a matching instruction
+  for (uint32_t i = 1; i <= file_sections; ++i)
+  {
+    uint8_t *p = &out[SECTION_OFF(sections[i].file_offset)];
+    uint32_t fill = (sections[i].file_offset & SECTION_EXEC) ? PPC_NOP : 0;
+    for (uint32_t w = 0; w < words_per_section; ++w)
+      write_be32(p + w * 4, fill);
+  }
+  for (uint32_t m = 0; m < num_imports; ++m)
+  {
+    for (auto it = lists[m].begin(); it != lists[m].end(); ++it)
+    {
+      uint32_t section = 1 + it->m_word / words_per_section;
+      uint32_t offset = (it->m_word % words_per_section) * 4;
+      write_be32(&out[SECTION_OFF(sections[section].file_offset) + offset], site_template(it->m_type));
+    }
+  }
+
+  // Relocation lists, one per import
+  for (uint32_t m = 0; m < num_imports; ++m)
+  {
+    write_be32(&out[import_offset + m * sizeof(import_entry)], imports[m]);
+    write_be32(&out[import_offset + m * sizeof(import_entry) + 4], static_cast<uint32_t>(out.size()));
+
+    uint32_t current_section = 0;
+    uint32_t current_offset = 0;
+    for (auto it = lists[m].begin(); it != lists[m].end(); ++it)
+    {
+      uint32_t section = 1 + it->m_word / words_per_section;
+      uint32_t offset = (it->m_word % words_per_section) * 4;
+      if (rel_patch_width(it->m_type) == 2)
+        offset += 2;    // low halfword of the instruction
+
+      uint8_t record[sizeof(rel_entry)];
+      if (section != current_section)
+      {
+        memset(record, 0, sizeof(record));
+        record[2] = R_DOLPHIN_SECTION;
+        record[3] = static_cast<uint8_t>(section);
+        out.insert(out.end(), record, record + sizeof(record));
+        current_section = section;
+        current_offset = 0;
+      }
+
+      // Gaps too large for a record are bridged with nops
+      uint32_t delta = offset - current_offset;
+      while (delta > 0xFFFF)
+      {
+        memset(record, 0, sizeof(record));
+        write_be16(record, 0xFFFF);
+        record[2] = R_DOLPHIN_NOP;
+        out.insert(out.end(), record, record + sizeof(record));
+        delta -= 0xFFFF;
+      }
+
+      write_be16(record, static_cast<uint16_t>(delta));
+      record[2] = it->m_type;
+      record[3] = it->m_section;
+      write_be32(record + 4, it->m_addend);
+      out.insert(out.end(), record, record + sizeof(record));
+      current_offset = offset;
+    }
+
+    uint8_t end[sizeof(rel_entry)] = { 0, 0, R_DOLPHIN_END, 0, 0, 0, 0, 0 };
+    out.insert(out.end(), end, end + sizeof(end));
+  }
+
+  // Header and section table
+  uint8_t *h = out.data();
+  write_be32(h + offsetof(relhdr, info.id), options.m_id);
+  write_be32(h + offsetof(relhdr, info.num_sections), num_sections);
+  write_be32(h + offsetof(relhdr, info.section_offset), sizeof(relhdr));
+  write_be32(h + offsetof(relhdr, info.version), options.m_version);
+  write_be32(h + offsetof(relhdr, bss_size), options.m_bss_size);
+  write_be32(h + offsetof(relhdr, rel_offset), rel_offset);
+  write_be32(h + offsetof(relhdr, import_offset), import_offset);
+  write_be32(h + offsetof(relhdr, import_size), import_size);
+  h[offsetof(relhdr, prolog_section)] = 1;
+  h[offsetof(relhdr, epilog_section)] = 1;
+  h[offsetof(relhdr, unresolved_section)] = 1;
+  write_be32(h + offsetof(relhdr, prolog_offset), 0);
+  write_be32(h + offsetof(relhdr, epilog_offset), 4);
+  write_be32(h + offsetof(relhdr, unresolved_offset), 8);
+  if (options.m_version >= 2)
+  {
+    write_be32(h + offsetof(relhdr, align), 32);
+    write_be32(h + offsetof(relhdr, bss_align), 32);
+  }
+  if (options.m_version >= 3)
+    write_be32(h + offsetof(relhdr, fix_size), rel_offset);
+
+  for (uint32_t i = 0; i < num_sections; ++i)
+  {
+    write_be32(h + sizeof(relhdr) + i * sizeof(section_entry), sections[i].file_offset);
+    write_be32(h + sizeof(relhdr) + i * sizeof(section_entry) + 4, sections[i].size);
+  }
+  return out;
+}
+
+std::vector<uint8_t> bench_make_dol(bench_dol_options const &options)
+{
+  uint32_t num_text = options.m_num_text > 7 ? 7 : options.m_num_text;
+  uint32_t num_data = options.m_num_data > 11 ? 11 : options.m_num_data;
+  uint32_t size = align_up(options.m_section_size, 32);
+  uint32_t state = options.m_seed != 0 ? options.m_seed : 1;
+
+  std::vector<uint8_t> out(0x100 + (num_text + num_data) * size);
+  uint8_t *h = out.data();
+  uint32_t offset = 0x100;
+  uint32_t address = options.m_address;
+
+  for (uint32_t i = 0; i < num_text; ++i, offset += size, address += size)
+  {
+    write_be32(h + offsetof(dolhdr, offsetText) + i * 4, offset);
+    write_be32(h + offsetof(dolhdr, addressText) + i * 4, address);
+    write_be32(h + offsetof(dolhdr, sizeText) + i * 4, size);
+
+    // Functions setting up a stack frame, then mostly nops with the odd call
+    for (uint32_t w = 0; w < size / 4; ++w)
+    {
+      uint32_t word = (next_random(state) & 7) == 0 ? PPC_BL : PPC_NOP;
+      if (w % DOL_FUNCTION == 0)
+        word = PPC_STWU_R1;
+      else if (w % DOL_FUNCTION == 1)
+        word = PPC_MFLR_R0;
+      write_be32(&out[offset + w * 4], word);
+    }
+  }
+
+  // A random function of the text segments
+  uint32_t num_functions = num_text * (size / 4 / DOL_FUNCTION);
+  auto function = [&]() -> uint32_t
+  {
+    return num_functions != 0 ? options.m_address + next_random(state) % num_functions * DOL_FUNCTION * 4 : 0;
+  };
+
+  // The first two data segments are the _ctors and _dtors tables, the
+  // others random data with the odd vtable entry
+  for (uint32_t i = 0; i < num_data; ++i, offset += size, address += size)
+  {
+    write_be32(h + offsetof(dolhdr, offsetData) + i * 4, offset);
+    write_be32(h + offsetof(dolhdr, addressData) + i * 4, address);
+    write_be32(h + offsetof(dolhdr, sizeData) + i * 4, size);
+
+    for (uint32_t w = 0; w < size / 4; ++w)
+    {
+      uint32_t word;
+      if (i < 2)
+        word = w < 16 / (i + 1) ? function() : 0;
+      else
+        word = (w & 15) == 0 ? function() : next_random(state);
+      write_be32(&out[offset + w * 4], word);
+    }
+  }
+
+  write_be32(h + offsetof(dolhdr, addressBSS), address);
+  write_be32(h + offsetof(dolhdr, sizeBSS), options.m_bss_size);
+  write_be32(h + offsetof(dolhdr, entrypoint), num_text != 0 ? options.m_address : 0);
+  return out;
+}
+
+std::string bench_make_map(uint32_t num_symbols, bool old_format, uint32_t seed)
+{
+  static char const * const sections[] = { ".text", ".data" };
+  uint32_t state = seed != 0 ? seed : 1;
+  std::string out;
+  char line[160];
+
+  for (uint32_t s = 0; s < 2; ++s)
+  {
+    out += sections[s];
+    out += " section layout\n";
+    out += old_format ? "  Starting        Virtual\n  address  Size   address\n  -----------------------\n"
+                      : "  Starting        Virtual  File\n  address  Size   address  offset\n  ---------------------------------\n";
+
+    uint32_t offset = 0;
+    for (uint32_t i = s; i < num_symbols; i += 2)
+    {
+      uint32_t size = 4 + (next_random(state) % 64) * 4;
+
+      // Every object starts with a section entry, some symbols are unused
+      if (i % 16 < 2)
+      {
+        snprintf(line, sizeof(line), "  %08x %06x %08x %s 1 %s \tobject%u.o \n", offset, 0x40, 0,
+                 old_format ? "" : "000000e0 ", sections[s], i / 16);
+        out += line;
+      }
+      if (i % 32 == 7)
+      {
+        snprintf(line, sizeof(line), "  UNUSED   %06x ........ unused_%u object%u.o \n", size, i, i / 16);
+        out += line;
+      }
+
+      snprintf(line, sizeof(line), "  %08x %06x %08x %s 4 %s_%u \tobject%u.o \n", offset, size, 0,
+               old_format ? "" : "000000e0 ", s == 0 ? "function" : "object", i, i / 16);
+      out += line;
+      offset += size;
+    }
+    out += "\n\n";
+  }
+  return out;
+}
+
+#define YAZ0_WINDOW   0x1000
+#define YAZ0_MIN_RUN  3
+#define YAZ0_MAX_RUN  (0xFF + 0x12)
+#define YAZ0_DEPTH    32        // candidates tried per position
+#define YAZ0_HASH     (1 << 14)
+
+static inline uint32_t hash3(uint8_t const *p)
+{
+  return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - 14);
+}
+
+std::vector<uint8_t> bench_yaz0_encode(std::vector<uint8_t> const &data)
+{
+  std::vector<uint8_t> out(YAZ0_HEADER_SIZE, 0);
+  write_be32(&out[0], YAZ0_MAGIC);
+  write_be32(&out[4], static_cast<uint32_t>(data.size()));
+
+  // Chains of earlier positions with the same first three bytes
+  size_t size = data.size();
+  std::vector<int32_t> head(YAZ0_HASH, -1);
+  std::vector<int32_t> prev(size, -1);
+  auto insert = [&](size_t pos)
+  {
+    if (pos + YAZ0_MIN_RUN > size)
+      return;
+    uint32_t h = hash3(&data[pos]);
+    prev[pos] = head[h];
+    head[h] = static_cast<int32_t>(pos);
+  };
+
+  size_t pos = 0;
+  while (pos < size)
+  {
+    size_t group = out.size();
+    out.push_back(0);
+    for (int bit = 0; bit < 8 && pos < size; ++bit)
+    {
+      size_t best_len = 0, best_dist = 0;
+      if (pos + YAZ0_MIN_RUN <= size)
+      {
+        size_t limit = std::min<size_t>(YAZ0_MAX_RUN, size - pos);
+        int32_t candidate = head[hash3(&data[pos])];
+        for (int depth = 0; candidate >= 0 && pos - candidate <= YAZ0_WINDOW && depth < YAZ0_DEPTH; ++depth)
+        {
+          size_t len = 0;
+          while (len < limit && data[candidate + len] == data[pos + len])
+            ++len;
+          if (len > best_len)
+          {
+            best_len = len;
+            best_dist = pos - candidate;
+            if (len == limit)
+              break;
+          }
+          candidate = prev[candidate];
+        }
+      }
+
+      if (best_len < YAZ0_MIN_RUN)
+      {
+        out[group] |= 0x80 >> bit;
+        out.push_back(data[pos]);
+        insert(pos++);
+        continue;
+      }
+
+      size_t dist = best_dist - 1;
+      if (best_len >= 0x12)
+      {
+        out.push_back(static_cast<uint8_t>(dist >> 8));
+        out.push_back(static_cast<uint8_t>(dist));
+        out.push_back(static_cast<uint8_t>(best_len - 0x12));
+      }
+      else
+      {
+        out.push_back(static_cast<uint8_t>((best_len - 2) << 4 | dist >> 8));
+        out.push_back(static_cast<uint8_t>(dist));
+      }
+      for (size_t i = 0; i < best_len; ++i)
+        insert(pos++);
+    }
+  }
+  return out;
+}
+
+bool bench_write_file(std::string const &path, std::vector<uint8_t> const &data)
+{
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (fp == nullptr)
+    return false;
+  bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+  return fclose(fp) == 0 && ok;
+}
+
+std::vector<std::string> bench_write_corpus(std::string const &directory, uint32_t num_modules,
+                                            bench_rel_options const &options, bool compressed)
+{
+  std::vector<std::string> paths;
+  if (!bench_write_file(directory + "/main.dol", bench_make_dol(bench_dol_options())))
+    return paths;
+
+  for (uint32_t id = 1; id <= num_modules; ++id)
+  {
+    bench_rel_options module = options;
+    module.m_id = id;
+    module.m_seed = options.m_seed + id;
+    module.m_imports.clear();
+    module.m_imports.push_back(0);
+    if (id > 1)
+      module.m_imports.push_back(id - 1);
+    if (id < num_modules)
+      module.m_imports.push_back(id + 1);
+
+    char name[32];
+    snprintf(name, sizeof(name), compressed ? "/m%04u.rel.szs" : "/m%04u.rel", id);
+    std::string path = directory + name;
+    std::vector<uint8_t> file = bench_make_rel(module);
+    if (!bench_write_file(path, compressed ? bench_yaz0_encode(file) : file))
+      return std::vector<std::string>();
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+// A directory or file of a generated disc. Directories hold the index
+// after their last entry in m_size.
+struct disc_entry
+{
+  bool m_directory;
+  std::string m_name;
+  uint32_t m_parent;
+  uint32_t m_size;
+  std::vector<uint8_t> m_data;
+};
+
+bool bench_write_disc(std::string const &path, uint32_t num_modules, uint32_t num_other,
+                      bench_rel_options const &options)
+{
+  // Root, /audio with the other files, then /rels with the modules
+  std::vector<disc_entry> entries(1);
+  entries[0].m_directory = true;
+
+  disc_entry audio = { true, "audio", 0, 0, std::vector<uint8_t>() };
+  entries.push_back(audio);
+  uint32_t state = options.m_seed != 0 ? options.m_seed : 1;
+  for (uint32_t i = 0; i < num_other; ++i)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "bgm_%03u.adp", i);
+    disc_entry file = { false, name, 0, 0, std::vector<uint8_t>(0x800 + next_random(state) % 0x8000) };
+    entries.push_back(file);
+  }
+  entries[1].m_size = static_cast<uint32_t>(entries.size());
+
+  disc_entry rels = { true, "rels", 0, 0, std::vector<uint8_t>() };
+  entries.push_back(rels);
+  size_t rels_index = entries.size() - 1;
+  for (uint32_t id = 1; id <= num_modules; ++id)
+  {
+    bench_rel_options module = options;
+    module.m_id = id;
+    module.m_seed = options.m_seed + id;
+    module.m_imports.clear();
+    module.m_imports.push_back(0);
+    if (id > 1)
+      module.m_imports.push_back(id - 1);
+    if (id < num_modules)
+      module.m_imports.push_back(id + 1);
+
+    char name[32];
+    snprintf(name, sizeof(name), "m%04u.rel", id);
+    disc_entry file = { false, name, 0, 0, bench_make_rel(module) };
+    entries.push_back(file);
+  }
+  entries[rels_index].m_size = static_cast<uint32_t>(entries.size());
+  entries[0].m_size = static_cast<uint32_t>(entries.size());
+
+  // Names after the entries
+  std::vector<uint8_t> names;
+  std::vector<uint32_t> name_offsets;
+  for (auto it = entries.begin(); it != entries.end(); ++it)
+  {
+    name_offsets.push_back(static_cast<uint32_t>(names.size()));
+    names.insert(names.end(), it->m_name.begin(), it->m_name.end());
+    names.push_back(0);
+  }
+  uint32_t fst_size = static_cast<uint32_t>(entries.size() * GCM_FST_ENTRY_SIZE + names.size());
+
+  // Header, main.dol, the FST and the files, each 32 byte aligned
+  std::vector<uint8_t> dol = bench_make_dol(bench_dol_options());
+  uint32_t dol_offset = align_up(GCM_HEADER_SIZE + 0x2000, 32);
+  uint32_t fst_offset = align_up(dol_offset + static_cast<uint32_t>(dol.size()), 32);
+  uint32_t offset = align_up(fst_offset + fst_size, 32);
+
+  std::vector<uint8_t> fst(fst_size);
+  for (size_t i = 0; i < entries.size(); ++i)
+  {
+    uint8_t *e = &fst[i * GCM_FST_ENTRY_SIZE];
+    disc_entry &entry = entries[i];
+    write_be32(e, name_offsets[i] | (entry.m_directory ? GCM_FST_DIRECTORY << 24 : 0));
+    if (entry.m_directory)
+    {
+      write_be32(e + 4, i == 0 ? 0 : entry.m_parent);
+      write_be32(e + 8, entry.m_size);
+      continue;
+    }
+    write_be32(e + 4, offset);
+    write_be32(e + 8, static_cast<uint32_t>(entry.m_data.size()));
+    offset = align_up(offset + static_cast<uint32_t>(entry.m_data.size()), 32);
+  }
+  memcpy(&fst[entries.size() * GCM_FST_ENTRY_SIZE], names.data(), names.size());
+
+  std::vector<uint8_t> out(offset);
+  memcpy(&out[0], "GBNE01", 6);
+  write_be32(&out[GCM_MAGIC_OFFSET], GCM_MAGIC);
+  write_be32(&out[GCM_DOL_OFFSET], dol_offset);
+  write_be32(&out[GCM_FST_OFFSET], fst_offset);
+  write_be32(&out[GCM_FST_SIZE], fst_size);
+  memcpy(&out[dol_offset], dol.data(), dol.size());
+  memcpy(&out[fst_offset], fst.data(), fst.size());
+  for (size_t i = 0; i < entries.size(); ++i)
+  {
+    if (!entries[i].m_directory && !entries[i].m_data.empty())
+      memcpy(&out[read_be32(&fst[i * GCM_FST_ENTRY_SIZE + 4])], entries[i].m_data.data(), entries[i].m_data.size());
+  }
+  return bench_write_file(path, out);
+}
+
+// Appends a string table holding names, setting offsets to where each went
+static void append_names(std::vector<uint8_t> &out, std::vector<std::string> const &names, std::vector<uint32_t> &offsets)
+{
+  uint32_t start = static_cast<uint32_t>(out.size());
+  offsets.clear();
+  for (auto it = names.begin(); it != names.end(); ++it)
+  {
+    offsets.push_back(static_cast<uint32_t>(out.size()) - start);
+    out.insert(out.end(), it->begin(), it->end());
+    out.push_back(0);
+  }
+}
+
+// Export table entries for names, placed at (sections[i], offsets[i])
+static void append_exports(std::vector<uint8_t> &out, std::vector<std::string> const &names, std::vector<uint32_t> const &name_offsets,
+                           std::vector<uint32_t> const &sections, std::vector<uint32_t> const &offsets)
+{
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    uint8_t entry[sizeof(rso_export)];
+    write_be32(entry + offsetof(rso_export, name_offset), name_offsets[i]);
+    write_be32(entry + offsetof(rso_export, offset), offsets[i]);
+    write_be32(entry + offsetof(rso_export, section), sections[i]);
+    write_be32(entry + offsetof(rso_export, hash), rel_elf_hash(names[i].c_str()));
+    out.insert(out.end(), entry, entry + sizeof(entry));
+  }
+}
+
+static void write_rso_header(uint8_t *h, uint32_t num_sections, uint32_t name_offset, uint32_t name_size, uint32_t bss_size)
+{
+  write_be32(h + offsetof(rsohdr, num_sections), num_sections);
+  write_be32(h + offsetof(rsohdr, section_offset), sizeof(rsohdr));
+  write_be32(h + offsetof(rsohdr, name_offset), name_offset);
+  write_be32(h + offsetof(rsohdr, name_size), name_size);
+  write_be32(h + offsetof(rsohdr, version), 1);
+  write_be32(h + offsetof(rsohdr, bss_size), bss_size);
+}
+
+static void write_rso_table(uint8_t *h, size_t field, uint32_t offset, uint32_t size)
+{
+  write_be32(h + field, offset);
+  write_be32(h + field + 4, size);
+}
+
+std::vector<uint8_t> bench_make_rso(bench_rso_options const &options)
+{
+  uint32_t num_sections = options.m_num_sections < 3 ? 3 : options.m_num_sections;
+  uint32_t file_sections = num_sections - 2;
+  uint32_t section_size = align_up((options.m_num_relocations / file_sections + 16) * 4, 32);
+  uint32_t words_per_section = section_size / 4;
+  uint32_t state = options.m_seed != 0 ? options.m_seed : 1;
+
+  // Layout: header, section table, name, sections, then the tables
+  std::string filename = options.m_name + ".rso";
+  uint32_t name_offset = sizeof(rsohdr) + num_sections * sizeof(section_entry);
+  std::vector<section_entry> sections(num_sections);
+  uint32_t offset = align_up(name_offset + static_cast<uint32_t>(filename.size()), 32);
+  for (uint32_t i = 1; i <= file_sections; ++i)
+  {
+    sections[i].file_offset = offset | ((i & 1) ? SECTION_EXEC : 0);
+    sections[i].size = section_size;
+    offset += section_size;
+  }
+  sections[num_sections - 1].size = options.m_bss_size;
+
+  std::vector<uint8_t> out(offset);
+  for (uint32_t i = 1; i <= file_sections; ++i)
+  {
+    uint8_t *p = &out[SECTION_OFF(sections[i].file_offset)];
+    uint32_t fill = (sections[i].file_offset & SECTION_EXEC) ? PPC_NOP : 0;
+    for (uint32_t w = 0; w < words_per_section; ++w)
+      write_be32(p + w * 4, fill);
+  }
+  memcpy(&out[name_offset], filename.data(), filename.size());
+
+  // Every relocation patches a word of its own, internal ones first
+  uint32_t max_words = file_sections * words_per_section;
+  uint32_t num_relocations = options.m_num_relocations < max_words ? options.m_num_relocations : max_words;
+  uint32_t num_internal = options.m_imports.empty() ? num_relocations :
+                          static_cast<uint32_t>(static_cast<uint64_t>(num_relocations) * options.m_self_percent / 100);
+  std::vector<uint8_t> internal;
+  std::vector<uint8_t> external;
+  for (uint32_t word = 0; word < num_relocations; ++word)
+  {
+    uint32_t section = 1 + word / words_per_section;
+    uint8_t type = (word & 1) ? R_PPC_REL24 : R_PPC_ADDR32;
+    uint32_t site = SECTION_OFF(sections[section].file_offset) + (word % words_per_section) * 4;
+    write_be32(&out[site], site_template(type));
+
+    uint8_t record[sizeof(rso_relocation)];
+    write_be32(record, site);
+    if (word < num_internal)
+    {
+      uint32_t target = 1 + next_random(state) % (num_sections - 1);
+      write_be32(record + 4, (target << 8) | type);
+      write_be32(record + 8, sections[target].size != 0 ? (next_random(state) % sections[target].size) & ~3u : 0);
+      internal.insert(internal.end(), record, record + sizeof(record));
+    }
+    else
+    {
+      uint32_t symbol = next_random(state) % static_cast<uint32_t>(options.m_imports.size());
+      write_be32(record + 4, (symbol << 8) | type);
+      write_be32(record + 8, 0);
+      external.insert(external.end(), record, record + sizeof(record));
+    }
+  }
+
+  uint32_t internal_offset = static_cast<uint32_t>(out.size());
+  out.insert(out.end(), internal.begin(), internal.end());
+  uint32_t external_offset = static_cast<uint32_t>(out.size());
+  out.insert(out.end(), external.begin(), external.end());
+
+  // Exports spread over the sections with data
+  std::vector<std::string> export_names;
+  std::vector<uint32_t> export_sections, export_offsets, name_offsets;
+  for (uint32_t i = 0; i < options.m_num_exports; ++i)
+  {
+    char name[64];
+    snprintf(name, sizeof(name), "%s_%u", options.m_name.c_str(), i);
+    export_names.push_back(name);
+    export_sections.push_back(1 + i % file_sections);
+    export_offsets.push_back((i * 4) % section_size);
+  }
+  uint32_t export_names_offset = static_cast<uint32_t>(out.size());
+  append_names(out, export_names, name_offsets);
+  out.resize(align_up(static_cast<uint32_t>(out.size()), 4));
+  uint32_t export_offset = static_cast<uint32_t>(out.size());
+  append_exports(out, export_names, name_offsets, export_sections, export_offsets);
+
+  uint32_t import_names_offset = static_cast<uint32_t>(out.size());
+  append_names(out, options.m_imports, name_offsets);
+  out.resize(align_up(static_cast<uint32_t>(out.size()), 4));
+  uint32_t import_offset = static_cast<uint32_t>(out.size());
+  for (size_t i = 0; i < options.m_imports.size(); ++i)
+  {
+    uint8_t entry[sizeof(rso_import)] = {};
+    write_be32(entry + offsetof(rso_import, name_offset), name_offsets[i]);
+    out.insert(out.end(), entry, entry + sizeof(entry));
+  }
+
+  uint8_t *h = out.data();
+  write_rso_header(h, num_sections, name_offset, static_cast<uint32_t>(filename.size()), options.m_bss_size);
+  h[offsetof(rsohdr, prolog_section)] = 1;
+  h[offsetof(rsohdr, epilog_section)] = 1;
+  h[offsetof(rsohdr, unresolved_section)] = 1;
+  h[offsetof(rsohdr, bss_section)] = static_cast<uint8_t>(num_sections - 1);
+  write_be32(h + offsetof(rsohdr, epilog_offset), 4);
+  write_be32(h + offsetof(rsohdr, unresolved_offset), 8);
+  write_rso_table(h, offsetof(rsohdr, internal_offset), internal_offset, static_cast<uint32_t>(internal.size()));
+  write_rso_table(h, offsetof(rsohdr, external_offset), external_offset, static_cast<uint32_t>(external.size()));
+  write_rso_table(h, offsetof(rsohdr, export_offset), export_offset, options.m_num_exports * sizeof(rso_export));
+  write_be32(h + offsetof(rsohdr, export_names), export_names_offset);
+  write_rso_table(h, offsetof(rsohdr, import_offset), import_offset, static_cast<uint32_t>(options.m_imports.size() * sizeof(rso_import)));
+  write_be32(h + offsetof(rsohdr, import_names), import_names_offset);
+
+  for (uint32_t i = 0; i < num_sections; ++i)
+  {
+    write_be32(h + sizeof(rsohdr) + i * sizeof(section_entry), sections[i].file_offset);
+    write_be32(h + sizeof(rsohdr) + i * sizeof(section_entry) + 4, sections[i].size);
+  }
+  return out;
+}
+
+std::vector<uint8_t> bench_make_sel(std::string const &name, uint32_t num_exports)
+{
+  // Two empty sections, the program is in main.dol
+  uint32_t num_sections = 2;
+  std::string filename = name + ".sel";
+  uint32_t name_offset = sizeof(rsohdr) + num_sections * sizeof(section_entry);
+  std::vector<uint8_t> out(name_offset + filename.size());
+  memcpy(&out[name_offset], filename.data(), filename.size());
+
+  std::vector<std::string> names;
+  std::vector<uint32_t> sections, addresses, name_offsets;
+  for (uint32_t i = 0; i < num_exports; ++i)
+  {
+    char symbol[64];
+    snprintf(symbol, sizeof(symbol), "%s_%u", name.c_str(), i);
+    names.push_back(symbol);
+    sections.push_back(0);
+    addresses.push_back(MAIN_ADDRESS + i * 4);
+  }
+  uint32_t names_offset = static_cast<uint32_t>(out.size());
+  append_names(out, names, name_offsets);
+  out.resize(align_up(static_cast<uint32_t>(out.size()), 4));
+  uint32_t export_offset = static_cast<uint32_t>(out.size());
+  append_exports(out, names, name_offsets, sections, addresses);
+
+  uint8_t *h = out.data();
+  write_rso_header(h, num_sections, name_offset, static_cast<uint32_t>(filename.size()), 0);
+  write_rso_table(h, offsetof(rsohdr, export_offset), export_offset, num_exports * sizeof(rso_export));
+  write_be32(h + offsetof(rsohdr, export_names), names_offset);
+  return out;
+}
+
+std::vector<std::string> bench_write_rso_corpus(std::string const &directory, uint32_t num_modules, uint32_t num_exports)
+{
+  std::vector<std::string> paths;
+  if (!bench_write_file(directory + "/main.sel", bench_make_sel("main", num_exports)))
+    return paths;
+
+  for (uint32_t id = 1; id <= num_modules; ++id)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "r%04u", id);
+
+    bench_rso_options module;
+    module.m_name = name;
+    module.m_num_exports = num_exports;
+    module.m_seed = id;
+    for (uint32_t i = 0; i < 16; ++i)
+      module.m_imports.push_back("main_" + std::to_string(static_cast<unsigned long long>(i)));
+
+    std::string path = directory + "/" + name + ".rso";
+    if (!bench_write_file(path, bench_make_rso(module)))
+      return std::vector<std::string>();
+    paths.push_back(path);
+  }
+  return paths;
+}
@@ -0,0 +1,103 @@
+#ifndef __BENCH_GEN_H__
+#define __BENCH_GEN_H__
+
+#include "../rel/rel_format.h"
+#include "../dol/dol.h"
+#include <string>
+#include <vector>
+
+// Synthetic modules for the benchmarks. Everything is derived from a
+// seed, so the same options always produce the same bytes.
+
+// Share of the relocations using a type
+struct bench_rel_mix
+{
+  uint8_t  m_type;
+  uint32_t m_weight;
+};
+
+struct bench_rel_options
+{
+  uint32_t m_id;
+  uint32_t m_version;           // 1 to 3
+  uint32_t m_num_sections;      // including the null and the bss section
+  uint32_t m_section_size;      // 0 sizes sections to fit the relocations
+  uint32_t m_bss_size;
+  uint32_t m_num_relocations;   // spread over all imports
+  uint32_t m_self_percent;      // share of relocations against the module itself
+  std::vector<uint32_t> m_imports;          // ids of the modules imported from, 0 is the main program
+  std::vector<bench_rel_mix> m_mix;         // empty uses a CodeWarrior-like mix
+  uint32_t m_seed;
+
+  bench_rel_options();
+};
+
+struct bench_rso_options
+{
+  std::string m_name;
+  uint32_t m_num_sections;      // including the null and the bss section
+  uint32_t m_bss_size;
+  uint32_t m_num_relocations;
+  uint32_t m_self_percent;      // share of internal relocations
+  uint32_t m_num_exports;       // named <name>_<n>
+  std::vector<std::string> m_imports;   // names imported, external relocations pick among them
+  uint32_t m_seed;
+
+  bench_rso_options();
+};
+
+struct bench_dol_options
+{
+  uint32_t m_num_text;          // up to 7
+  uint32_t m_num_data;          // up to 11
+  uint32_t m_section_size;
+  uint32_t m_bss_size;
+  uint32_t m_address;           // address of the first section
+  uint32_t m_seed;
+
+  bench_dol_options();
+};
+
+// Builds a module. Imported modules are assumed to have the same section
+// layout as the module itself, as in a corpus from bench_write_corpus.
+std::vector<uint8_t> bench_make_rel(bench_rel_options const &options);
+
+// Section table bench_make_rel lays out for options
+std::vector<section_entry> bench_rel_sections(bench_rel_options const &options);
+
+std::vector<uint8_t> bench_make_dol(bench_dol_options const &options);
+
+// RSO module, and the SEL of a main program exporting num_exports names
+// (<name>_<n>) at absolute addresses
+std::vector<uint8_t> bench_make_rso(bench_rso_options const &options);
+std::vector<uint8_t> bench_make_sel(std::string const &name, uint32_t num_exports);
+
+// CodeWarrior linker map with num_symbols symbols spread over the .text
+// and .data layouts, in the format of newer linkers (with file offsets)
+// unless old_format is set
+std::string bench_make_map(uint32_t num_symbols, bool old_format, uint32_t seed);
+
+// Yaz0 compression of data, greedy with a short search per position
+// like the usual game tools
+std::vector<uint8_t> bench_yaz0_encode(std::vector<uint8_t> const &data);
+
+bool bench_write_file(std::string const &path, std::vector<uint8_t> const &data);
+
+// Writes main.dol and num_modules sibling modules named mNNNN.rel, with
+// ids 1 to num_modules, to directory. Each module imports from the main
+// program, itself and its neighbours. With compressed set the modules are
+// Yaz0 compressed and named mNNNN.rel.szs. Returns the paths of the modules.
+std::vector<std::string> bench_write_corpus(std::string const &directory, uint32_t num_modules,
+                                            bench_rel_options const &options, bool compressed = false);
+
+// Writes a GameCube disc image holding main.dol and the modules of
+// bench_write_corpus as /rels/mNNNN.rel, next to num_other files in
+// other directories. Returns false if it can't be written.
+bool bench_write_disc(std::string const &path, uint32_t num_modules, uint32_t num_other,
+                      bench_rel_options const &options);
+
+// Writes main.sel and num_modules modules named rNNNN.rso to directory,
+// exporting num_exports names each. Returns the paths of the modules.
+std::vector<std::string> bench_write_rso_corpus(std::string const &directory, uint32_t num_modules, uint32_t num_exports);
+
+#endif // #ifndef __BENCH_GEN_H__
@@ -0,0 +1,446 @@
+#include "stub/ida_stub.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
+// A file, or memory when m_fp is null
+struct linput_t
+{
+  FILE *m_fp;
+  int64 m_size;
+  uchar const *m_memory;
+  int64 m_pos;
+};
+
+static stub_record g_record;
+static std::string g_database_path;
+static bool g_verbose = false;
+static std::map<std::string, bytevec_t> g_blobs;    // by netnode name, start and tag
+
+void stub_reset()
+{
+  memset(&g_record, 0, sizeof(g_record));
+}
+
+void stub_reset_database()
+{
+  g_blobs.clear();
+}
+
+stub_record const &stub_get_record()
+{
+  return g_record;
+}
+
+void stub_set_database_path(char const *path)
+{
+  g_database_path = path;
+}
+
+void stub_set_verbose(bool verbose)
+{
+  g_verbose = verbose;
+}
+
+// Folds written bytes into the record checksum (FNV-1a)
+static void checksum(ea_t ea, void const *buf, size_t size)
+{
+  uint32_t h = g_record.m_checksum ^ ea;
+  uint8_t const *p = static_cast<uint8_t const *>(buf);
+  for (size_t i = 0; i < size; ++i)
+    h = (h ^ p[i]) * 16777619u;
+  g_record.m_checksum = h;
+}
+
+linput_t *open_linput(char const *file, bool /*remote*/)
+{
+  FILE *fp = fopen(file, "rb");
+  if (fp == nullptr)
+    return nullptr;
+
+  linput_t *li = new linput_t;
+  li->m_fp = fp;
+  fseek(fp, 0, SEEK_END);
+  li->m_size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  li->m_memory = nullptr;
+  li->m_pos = 0;
+  return li;
+}
+
+linput_t *create_memory_linput(void const *start, size_t size)
+{
+  linput_t *li = new linput_t;
+  li->m_fp = nullptr;
+  li->m_size = static_cast<int64>(size);
+  li->m_memory = static_cast<uchar const *>(start);
+  li->m_pos = 0;
+  return li;
+}
+
+void close_linput(linput_t *li)
+{
+  if (li == nullptr)
+    return;
+  if (li->m_fp != nullptr)
+    fclose(li->m_fp);
+  delete li;
+}
+
+ssize_t qlread(linput_t *li, void *buf, size_t size)
+{
+  ++g_record.m_reads;
+  size_t n;
+  if (li->m_fp != nullptr)
+  {
+    n = fread(buf, 1, size, li->m_fp);
+  }
+  else
+  {
+    n = li->m_pos < li->m_size ? std::min<size_t>(size, static_cast<size_t>(li->m_size - li->m_pos)) : 0;
+    memcpy(buf, li->m_memory + li->m_pos, n);
+    li->m_pos += n;
+  }
+  g_record.m_read_bytes += n;
+  return static_cast<ssize_t>(n);
+}
+
+qoff64_t qlseek(linput_t *li, qoff64_t pos, int whence)
+{
+  if (li->m_fp == nullptr)
+  {
+    qoff64_t base = whence == SEEK_CUR ? li->m_pos : whence == SEEK_END ? li->m_size : 0;
+    if (base + pos < 0)
+      return -1;
+    li->m_pos = base + pos;
+    return li->m_pos;
+  }
+  if (fseek(li->m_fp, static_cast<long>(pos), whence) != 0)
+    return -1;
+  return ftell(li->m_fp);
+}
+
+int64 qlsize(linput_t *li)
+{
+  return li->m_size;
+}
+
+FILE *qfopen(char const *file, char const *mode)
+{
+  return fopen(file, mode);
+}
+
+ssize_t qfread(FILE *fp, void *buf, size_t size)
+{
+  return static_cast<ssize_t>(fread(buf, 1, size, fp));
+}
+
+ssize_t qfwrite(FILE *fp, void const *buf, size_t size)
+{
+  return static_cast<ssize_t>(fwrite(buf, 1, size, fp));
+}
+
+int qfclose(FILE *fp)
+{
+  return fclose(fp);
+}
+
+int vmsg(char const *format, va_list va)
+{
+  ++g_record.m_messages;
+  return g_verbose ? vprintf(format, va) : 0;
+}
+
+int msg(char const *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  int n = vmsg(format, va);
+  va_end(va);
+  return n;
+}
+
+int qvsnprintf(char *buf, size_t size, char const *format, va_list va)
+{
+  int n = vsnprintf(buf, size, format, va);
+  if (size != 0)
+    buf[size - 1] = '\0';
+  return n;
+}
+
+int qsnprintf(char *buf, size_t size, char const *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  int n = qvsnprintf(buf, size, format, va);
+  va_end(va);
+  return n;
+}
+
+char const *get_path(path_type_t /*pt*/)
+{
+  return g_database_path.c_str();
+}
+
+char const *qbasename(char const *path)
+{
+  char const *base = path;
+  for (char const *p = path; *p != '\0'; ++p)
+  {
+    if (*p == '/' || *p == '\\')
+      base = p + 1;
+  }
+  return base;
+}
+
+bool qdirname(char *buf, size_t bufsize, char const *path)
+{
+  size_t len = static_cast<size_t>(qbasename(path) - path);
+  if (len > 0)
+    --len;    // drop the separator
+  if (len >= bufsize)
+    return false;
+  memcpy(buf, path, len);
+  buf[len] = '\0';
+  return true;
+}
+
+// Only the "*.ext" patterns the loader uses are supported
+static bool match_pattern(char const *name, char const *pattern)
+{
+  if (pattern[0] != '*')
+    return strcmp(name, pattern) == 0;
+
+  size_t n = strlen(name);
+  size_t m = strlen(pattern + 1);
+  return n >= m && strcmp(name + n - m, pattern + 1) == 0;
+}
+
+int enumerate_files(char *answer, size_t answer_size, char const *path, char const *fname,
+                    int (idaapi *func)(char const *file, void *ud), void *ud)
+{
+  std::string dir = path;
+  std::string file;
+  int code = 0;
+
+#ifdef _WIN32
+  _finddata_t data;
+  intptr_t handle = _findfirst((dir + "\\" + fname).c_str(), &data);
+  if (handle == -1)
+    return 0;
+  do
+  {
+    file = dir + "\\" + data.name;
+    code = func(file.c_str(), ud);
+  } while (code == 0 && _findnext(handle, &data) == 0);
+  _findclose(handle);
+#else
+  DIR *d = opendir(dir.c_str());
+  if (d == nullptr)
+    return 0;
+  while (code == 0)
+  {
+    dirent *entry = readdir(d);
+    if (entry == nullptr)
+      break;
+    if (!match_pattern(entry->d_name, fname))
+      continue;
+    file = dir + "/" + entry->d_name;
+    code = func(file.c_str(), ud);
+  }
+  closedir(d);
+#endif
+
+  if (code != 0 && answer != nullptr && answer_size != 0)
+  {
+    strncpy(answer, file.c_str(), answer_size);
+    answer[answer_size - 1] = '\0';
+  }
+  return code;
+}
+
+static segment_t g_segment;
+
+segment_t *getseg(ea_t /*ea*/)
+{
+  return &g_segment;
+}
+
+bool add_segm(ea_t /*para*/, ea_t start, ea_t end, char const * /*name*/, char const * /*sclass*/, int /*flags*/)
+{
+  ++g_record.m_segments;
+  return start <= end;
+}
+
+void set_segm_addressing(segment_t * /*s*/, size_t /*bitness*/)
+{
+}
+
+int file2base(linput_t * /*li*/, qoff64_t /*pos*/, ea_t ea1, ea_t ea2, int /*patchable*/)
+{
+  g_record.m_loaded += ea2 - ea1;
+  return 1;
+}
+
+int mem2base(void const *memptr, ea_t ea1, ea_t ea2, qoff64_t /*fpos*/)
+{
+  if (memptr == nullptr)
+    return 0;
+  g_record.m_loaded += ea2 - ea1;
+  return 1;
+}
+
+bool set_segm_end(ea_t /*ea*/, ea_t /*newend*/, int /*flags*/)
+{
+  return true;
+}
+
+// Nothing is stored, the database always reads back as zeros
+ssize_t get_bytes(void *buf, ssize_t size, ea_t /*ea*/, int /*gmb_flags*/, void * /*mask*/)
+{
+  ++g_record.m_database_reads;
+  memset(buf, 0, size);
+  return size;
+}
+
+void patch_bytes(ea_t ea, void const *buf, size_t size)
+{
+  ++g_record.m_writes;
+  g_record.m_written += size;
+  checksum(ea, buf, size);
+}
+
+void put_bytes(ea_t ea, void const *buf, size_t size)
+{
+  patch_bytes(ea, buf, size);
+}
+
+bool force_name(ea_t /*ea*/, char const * /*name*/, int /*flags*/)
+{
+  ++g_record.m_names;
+  return true;
+}
+
+bool set_name(ea_t /*ea*/, char const * /*name*/, int /*flags*/)
+{
+  return true;
+}
+
+bool add_extra_line(ea_t /*ea*/, bool /*isprev*/, char const * /*format*/, ...)
+{
+  ++g_record.m_comments;
+  return true;
+}
+
+bool add_extra_cmt(ea_t /*ea*/, bool /*isprev*/, char const * /*format*/, ...)
+{
+  ++g_record.m_comments;
+  return true;
+}
+
+void add_pgm_cmt(char const * /*format*/, ...)
+{
+  ++g_record.m_comments;
+}
+
+void delete_extra_cmts(ea_t /*ea*/, int /*what*/)
+{
+}
+
+bool add_entry(uint64 /*ord*/, ea_t /*ea*/, char const * /*name*/, bool /*makecode*/, int /*flags*/)
+{
+  ++g_record.m_entries;
+  return true;
+}
+
+void set_libitem(ea_t /*ea*/)
+{
+}
+
+bool create_dword(ea_t /*ea*/, asize_t /*length*/, bool /*force*/)
+{
+  return true;
+}
+
+int create_insn(ea_t /*ea*/, insn_t * /*out*/)
+{
+  return 4;
+}
+
+// Custom reference types of the PPC module, by id
+static char const * const g_custom_refinfos[] = { "HIGHA16" };
+
+int find_custom_refinfo(char const *name)
+{
+  for (size_t i = 0; i < sizeof(g_custom_refinfos) / sizeof(g_custom_refinfos[0]); ++i)
+  {
+    if (strcmp(g_custom_refinfos[i], name) == 0)
+      return static_cast<int>(i);
+  }
+  return -1;
+}
+
+bool op_offset(ea_t /*ea*/, int /*n*/, uint32 type, ea_t /*target*/, ea_t /*base*/, adiff_t /*tdelta*/)
+{
+  // Like IDA, unknown reference types are refused (7 and 8 are retired)
+  uint32 id = type & REFINFO_TYPE;
+  bool valid = (type & REFINFO_CUSTOM) != 0 ? id < sizeof(g_custom_refinfos) / sizeof(g_custom_refinfos[0])
+                                            : id >= REF_OFF16 && id <= REF_OFF8 && id != 7 && id != 8;
+  if (!valid)
+    return false;
+  ++g_record.m_offsets;
+  return true;
+}
+
+bool op_plain_offset(ea_t /*ea*/, int /*n*/, ea_t /*base*/)
+{
+  ++g_record.m_offsets;
+  return true;
+}
+
+bool add_dref(ea_t /*from*/, ea_t /*to*/, dref_t /*type*/)
+{
+  ++g_record.m_xrefs;
+  return true;
+}
+
+bool auto_make_proc(ea_t /*ea*/)
+{
+  ++g_record.m_functions;
+  return true;
+}
+
+netnode::netnode(char const *name, size_t namlen, bool /*do_create*/)
+  : m_name(name, namlen != 0 ? namlen : strlen(name))
+{
+}
+
+static std::string blob_key(std::string const &name, nodeidx_t start, uchar tag)
+{
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), "/%u/%c", start, tag);
+  return name + suffix;
+}
+
+ssize_t netnode::getblob(bytevec_t *blob, nodeidx_t start, uchar tag) const
+{
+  auto it = g_blobs.find(blob_key(m_name, start, tag));
+  if (it == g_blobs.end())
+    return -1;
+  *blob = it->second;
+  return static_cast<ssize_t>(blob->size());
+}
+
+size_t netnode::setblob(void const *buf, size_t size, nodeidx_t start, uchar tag)
+{
+  uchar const *p = static_cast<uchar const *>(buf);
+  g_blobs[blob_key(m_name, start, tag)].assign(p, p + size);
+  return size;
+}
@@ -0,0 +1,2 @@
+// Forwards to the benchmark stand-in of the IDA SDK
+#include "ida_stub.h"
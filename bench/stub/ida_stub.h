@@ -0,0 +1,160 @@
+/*
+*  Stand-in for the parts of the IDA SDK used by the REL loader, so the
+*  loader sources can be built into the benchmark without IDA. Database
+*  calls are not applied anywhere, they are only recorded.
+*
+*/
+
+#ifndef __IDA_STUB_H__
+#define __IDA_STUB_H__
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define idaapi
+#define MAXSTR 1024
+
+typedef unsigned char uchar;
+typedef unsigned short ushort;
+typedef unsigned int uint;
+typedef int64_t int64;
+typedef uint64_t uint64;
+typedef uint32_t uint32;
+typedef int64_t qoff64_t;
+typedef uint32_t ea_t;      // the loader only targets 32-bit databases
+typedef uint32_t asize_t;
+typedef uint32_t nodeidx_t;
+typedef std::vector<uchar> bytevec_t;
+#ifdef _MSC_VER
+typedef ptrdiff_t ssize_t;
+#endif
+
+#define BADADDR ea_t(-1)
+
+#define FILEREG_PATCHABLE 1
+#define SEGMOD_KEEP 0x0002
+#define E_PREV 1000
+#define SN_NOWARN 0x80
+
+// Input files
+struct linput_t;
+linput_t *open_linput(char const *file, bool remote);
+void close_linput(linput_t *li);
+linput_t *create_memory_linput(void const *start, size_t size);
+ssize_t qlread(linput_t *li, void *buf, size_t size);
+qoff64_t qlseek(linput_t *li, qoff64_t pos, int whence = SEEK_SET);
+int64 qlsize(linput_t *li);
+
+// Plain files
+FILE *qfopen(char const *file, char const *mode);
+ssize_t qfread(FILE *fp, void *buf, size_t size);
+ssize_t qfwrite(FILE *fp, void const *buf, size_t size);
+int qfclose(FILE *fp);
+
+inline uint32 swap32(uint32 x)
+{
+  return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24);
+}
+
+// Messages are counted, and only printed when verbose is set
+int msg(char const *format, ...);
+int vmsg(char const *format, va_list va);
+int qsnprintf(char *buf, size_t size, char const *format, ...);
+int qvsnprintf(char *buf, size_t size, char const *format, va_list va);
+
+// Paths, the database lives wherever stub_set_database_path says
+enum path_type_t { PATH_TYPE_CMD, PATH_TYPE_IDB, PATH_TYPE_ID0 };
+char const *get_path(path_type_t pt);
+char const *qbasename(char const *path);
+bool qdirname(char *buf, size_t bufsize, char const *path);
+int enumerate_files(char *answer, size_t answer_size, char const *path, char const *fname,
+                    int (idaapi *func)(char const *file, void *ud), void *ud = nullptr);
+
+// Database
+struct segment_t {};
+segment_t *getseg(ea_t ea);
+bool add_segm(ea_t para, ea_t start, ea_t end, char const *name, char const *sclass, int flags = 0);
+void set_segm_addressing(segment_t *s, size_t bitness);
+int file2base(linput_t *li, qoff64_t pos, ea_t ea1, ea_t ea2, int patchable);
+int mem2base(void const *memptr, ea_t ea1, ea_t ea2, qoff64_t fpos);
+bool set_segm_end(ea_t ea, ea_t newend, int flags);
+ssize_t get_bytes(void *buf, ssize_t size, ea_t ea, int gmb_flags = 0, void *mask = nullptr);
+void patch_bytes(ea_t ea, void const *buf, size_t size);
+void put_bytes(ea_t ea, void const *buf, size_t size);
+bool force_name(ea_t ea, char const *name, int flags = 0);
+bool set_name(ea_t ea, char const *name, int flags = 0);
+bool add_extra_line(ea_t ea, bool isprev, char const *format, ...);
+bool add_extra_cmt(ea_t ea, bool isprev, char const *format, ...);
+void add_pgm_cmt(char const *format, ...);
+void delete_extra_cmts(ea_t ea, int what);
+bool add_entry(uint64 ord, ea_t ea, char const *name, bool makecode, int flags = 0);
+void set_libitem(ea_t ea);
+bool create_dword(ea_t ea, asize_t length, bool force = false);
+struct insn_t;
+int create_insn(ea_t ea, insn_t *out = nullptr);
+
+// Offsets and cross references, reference types as in nalt.hpp. Others
+// than these are registered by processor modules and looked up by name.
+#define REF_OFF16   1
+#define REF_OFF32   2
+#define REF_LOW8    3
+#define REF_LOW16   4
+#define REF_HIGH8   5
+#define REF_HIGH16  6
+#define REF_OFF64   9
+#define REF_OFF8    10
+#define REFINFO_TYPE    0x000F
+#define REFINFO_CUSTOM  0x0040
+int find_custom_refinfo(char const *name);    // the PPC module's "HIGHA16" is known
+enum dref_t { dr_O = 1, dr_W, dr_R };
+typedef int32_t adiff_t;
+bool op_offset(ea_t ea, int n, uint32 type, ea_t target = BADADDR, ea_t base = 0, adiff_t tdelta = 0);
+bool op_plain_offset(ea_t ea, int n, ea_t base);
+bool add_dref(ea_t from, ea_t to, dref_t type);
+
+// Auto-analysis queue
+bool auto_make_proc(ea_t ea);
+
+// Netnodes only hold blobs, kept in memory until stub_reset_database
+class netnode
+{
+public:
+  netnode(char const *name, size_t namlen = 0, bool do_create = false);
+  ssize_t getblob(bytevec_t *blob, nodeidx_t start, uchar tag) const;
+  size_t setblob(void const *buf, size_t size, nodeidx_t start, uchar tag);
+
+private:
+  std::string m_name;
+};
+
+// What the loader asked of the database since the last stub_reset
+struct stub_record
+{
+  uint64_t m_segments;
+  uint64_t m_writes;        // patch_bytes and put_bytes calls
+  uint64_t m_written;       // bytes passed to them
+  uint64_t m_loaded;        // bytes loaded with file2base and mem2base
+  uint64_t m_names;
+  uint64_t m_comments;
+  uint64_t m_entries;
+  uint64_t m_offsets;       // op_offset and op_plain_offset calls with a valid type
+  uint64_t m_xrefs;         // add_dref calls
+  uint64_t m_functions;     // auto_make_proc calls
+  uint64_t m_database_reads; // get_bytes calls
+  uint64_t m_reads;         // qlread calls
+  uint64_t m_read_bytes;
+  uint64_t m_messages;
+  uint32_t m_checksum;      // over the written bytes and their addresses
+};
+
+void stub_reset();
+void stub_reset_database();   // forgets the netnodes
+stub_record const &stub_get_record();
+void stub_set_database_path(char const *path);
+void stub_set_verbose(bool verbose);
+
+#endif // #ifndef __IDA_STUB_H__
@@ -5,39 +5,11 @@
  */
 
 #include "../loader/idaloader.h"
-#include "dol.h"
+#include "dol_image.h"
+#include "../loader/ldr_trace.h"
+#include <cstring>
 
-/*--------------------------------------------------------------------------
- *
- *   Read the header of the (possible) DOL file into memory. Swap all bytes
- *   because the file is stored as big endian.
- *
- */
-
-int read_header(linput_t *fp, dolhdr *dhdr)
-{
-  int i;
-
-  // read in dolheader
-  qlseek(fp, 0, SEEK_SET);
-  if(qlread(fp, dhdr, sizeof(dolhdr)) != sizeof(dolhdr)) return(0);
-
-  // convert header
-  for (i=0; i<7; i++) {
-    dhdr->offsetText[i] = swap32(dhdr->offsetText[i]);
-    dhdr->addressText[i] = swap32(dhdr->addressText[i]);
-    dhdr->sizeText[i] = swap32(dhdr->sizeText[i]);
-  }
-  for (i=0; i<11; i++) {
-    dhdr->offsetData[i] = swap32(dhdr->offsetData[i]);
-    dhdr->addressData[i] = swap32(dhdr->addressData[i]);
-    dhdr->sizeData[i] = swap32(dhdr->sizeData[i]);
-  }
-  dhdr->entrypoint = swap32(dhdr->entrypoint);
-  dhdr->sizeBSS = swap32(dhdr->sizeBSS);
-  dhdr->addressBSS = swap32(dhdr->addressBSS);
-  return(1);
-}
+#define DOL_DISC_FORMAT_NAME "Nintendo GameCube disc (main.dol)"
 
 /*--------------------------------------------------------------------------
  *
@@ -48,50 +20,23 @@ int read_header(linput_t *fp, dolhdr *dhdr)
  */
 
 int idaapi accept_file (qstring *fileformatname, qstring *processor, linput_t *fp, const char *filename) {
-  int i;
-
   dolhdr dhdr;
-  int64 filelen, valid = 0;
+  ldr_scope trace("accept_file");
 
   //if(n) return(0);
 
-  // first get the lenght of the file
-  
-  filelen = qlsize(fp);
-  // if too short for a DOL header then this is no DOL
-  if (filelen < 0x100) return(0);
-
   // read DOL header from file
-  if (read_header(fp, &dhdr)==0) return(0);
+  if (dol_read_header(fp, &dhdr)==0) return(0);
   
   // now perform some sanitychecks
-  for (i=0; i<7; i++) {
-    
-    // DOL segment MAY NOT physically stored in the header
-    if (dhdr.offsetText[i]!=0 && dhdr.offsetText[i]<0x100) return(0);
-    // end of physical storage must be within file
-    if (dhdr.offsetText[i]+dhdr.sizeText[i]>filelen) return(0);
-    // we only accept DOLs with segments above 2GB
-    if (dhdr.addressText[i] != 0 && !(dhdr.addressText[i] & 0x80000000)) return(0);
-
-    // remember that entrypoint was in a code segment
-    if (dhdr.entrypoint >= dhdr.addressText[i] && dhdr.entrypoint < dhdr.addressText[i]+dhdr.sizeText[i]) valid = 1;
-  }
-  for (i=0; i<11; i++) {
-
-    // DOL segment MAY NOT physically stored in the header
-    if (dhdr.offsetData[i]!=0 && dhdr.offsetData[i]<0x100) return(0);
-    // end of physical storage must be within file
-    if (dhdr.offsetData[i]+dhdr.sizeData[i]>filelen) return(0);
-    // we only accept DOLs with segments above 2GB
-    if (dhdr.addressData[i] != 0 && !(dhdr.addressData[i] & 0x80000000)) return(0);
+  if (dol_check_header(&dhdr, qlsize(fp))==0) {
+
+    // a GameCube disc image, load its main.dol
+    if (dol_read_disc_header(fp, &dhdr)==0 || dol_check_header(&dhdr, qlsize(fp))==0) return(0);
+    *fileformatname = DOL_DISC_FORMAT_NAME;
+    *processor = "PPC";
+    return(0xD07);
   }
-  
-  // if there is a BSS segment it must be above 2GB, too
-  if (dhdr.addressBSS != 0 && !(dhdr.addressBSS & 0x80000000)) return(0);
-  
-  // if entrypoint is not within a code segment reject this file
-  if (!valid) return(0);
 
   // file has passed all sanity checks and might be a DOL
   *fileformatname = "Nintendo GameCube DOL";
@@ -108,11 +53,9 @@ int idaapi accept_file (qstring *fileformatname, qstring *processor, linput_t *f
  *
  */
 
-void idaapi load_file(linput_t *fp, ushort /*neflag*/, const char * /*fileformatname*/)
+void idaapi load_file(linput_t *fp, ushort neflag, const char *fileformatname)
 {
   dolhdr dhdr;
-  uint snum;
-  int i;
 
   // Hello here I am
   msg("---------------------------------------\n");
@@ -125,8 +68,13 @@ void idaapi load_file(linput_t *fp, ushort /*neflag*/, const char * /*fileformat
 
   set_compiler_id(COMP_GNU);
 
-  // read DOL header into memory
-  if (read_header(fp, &dhdr)==0) qexit(1);
+  ldr_trace::get().begin("load_file");
+
+  // read DOL header into memory, from where it is on a disc
+  if (fileformatname != NULL && strcmp(fileformatname, DOL_DISC_FORMAT_NAME) == 0) {
+    if (dol_read_disc_header(fp, &dhdr)==0) qexit(1);
+  }
+  else if (dol_read_header(fp, &dhdr)==0) qexit(1);
   
   // every journey has a beginning
   inf.start_ea = inf.start_ip = dhdr.entrypoint;
@@ -134,55 +82,25 @@ void idaapi load_file(linput_t *fp, ushort /*neflag*/, const char * /*fileformat
   // map selector 1 to 0
   set_selector(1, 0);
 
-  // create all code segments
-  for (i=0, snum=1; i<7; i++, snum++) {
-    char buf[50];
-    
-    // 0 == no segment
-    if (dhdr.addressText[i] == 0) continue;
-    
-    // create a name according to segmenttype and number
-    qsnprintf(buf, sizeof(buf), NAME_CODE "%u", snum);
-    
-    // add the code segment
-    if (!add_segm(1, dhdr.addressText[i], dhdr.addressText[i]+dhdr.sizeText[i], buf, CLASS_CODE)) qexit(1);
-    
-    // set addressing to 32 bit
-    set_segm_addressing(getseg(dhdr.addressText[i]), 1);
-
-    // and get the content from the file
-    file2base(fp, dhdr.offsetText[i], dhdr.addressText[i], dhdr.addressText[i]+dhdr.sizeText[i], FILEREG_PATCHABLE);
+  // create all segments and load their contents, or on a reload only
+  // write what changed into the existing ones
+  dol_contents contents;
+  if (neflag & NEF_RELOAD) {
+    if (dol_reload_segments(fp, &dhdr, &contents)==0) {
+      msg("DOL: The segments changed, the database must be recreated\n");
+      return;
+    }
   }
+  else if (dol_load_segments(fp, &dhdr, &contents)==0) qexit(1);
 
-  // create all data segments
-  for (i=0, snum=1; i<11; i++, snum++) {
-    char buf[50];
-
-    // 0 == no segment
-    if (dhdr.addressData[i] == 0) continue;
+  // give auto-analysis more to start from than the entrypoint
+  dol_seed_functions(&dhdr, &contents);
 
-    // create a name according to segmenttype and number
-	qsnprintf(buf, sizeof(buf), NAME_DATA "%u", snum);
-
-    // add the data segment
-    if (!add_segm(1, dhdr.addressData[i], dhdr.addressData[i]+dhdr.sizeData[i], buf, CLASS_DATA)) qexit(1);
-    
-    // set addressing to 32 bit
-    set_segm_addressing(getseg(dhdr.addressData[i]), 1);
-
-    // and get the content from the file
-    file2base(fp, dhdr.offsetData[i], dhdr.addressData[i], dhdr.addressData[i]+dhdr.sizeData[i], FILEREG_PATCHABLE);
-  }
-
-  // is there a BSS defined?
-  if (dhdr.addressBSS != NULL) {
-    // then add it
-    if(!add_segm(1, dhdr.addressBSS, dhdr.addressBSS+dhdr.sizeBSS, NAME_BSS, CLASS_BSS)) qexit(1);
-
-    // and set addressing mode to 32 bit
-    set_segm_addressing(getseg(dhdr.addressBSS), 1);
-  }
- 
+  // summary, and a Chrome trace if LDR_TRACE names a file
+  ldr_trace::get().end();
+  qstring trace_path;
+  qgetenv(TRACE_ENV, &trace_path);
+  ldr_trace::get().report("DOL", trace_path.c_str());
 }
 
 /*--------------------------------------------------------------------------
@@ -193,7 +111,7 @@ void idaapi load_file(linput_t *fp, ushort /*neflag*/, const char * /*fileformat
 
 extern "C" loader_t LDSC = {
   IDP_INTERFACE_VERSION,
-  0, /* no loader flags */
+  LDRF_RELOAD,  /* reloading writes only what changed */
   accept_file,
   load_file,
   NULL,
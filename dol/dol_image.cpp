@@ -0,0 +1,423 @@
+/*
+ *  IDA Nintendo GameCube DOL Loader Module
+ *  (C) Copyright 2004 by Stefan Esser
+ *
+ */
+
+#include "dol_image.h"
+#include "../loader/ldr_trace.h"
+#include "../loader/gcm.h"
+#include <set>
+#include <vector>
+
+#define PPC_MFLR_R0     0x7C0802A6
+#define PPC_STWU_R1     0x94218000    // stwu r1, -d(r1)
+#define PPC_STWU_MASK   0xFFFF8000
+
+// big endian word
+static unsigned int dol_word(const unsigned char *p)
+{
+  return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+/*--------------------------------------------------------------------------
+ *
+ *   Read the header of the (possible) DOL file into memory. Swap all bytes
+ *   because the file is stored as big endian.
+ *
+ */
+
+static void dol_swap_header(dolhdr *dhdr)
+{
+  int i;
+
+  for (i=0; i<7; i++) {
+    dhdr->offsetText[i] = swap32(dhdr->offsetText[i]);
+    dhdr->addressText[i] = swap32(dhdr->addressText[i]);
+    dhdr->sizeText[i] = swap32(dhdr->sizeText[i]);
+  }
+  for (i=0; i<11; i++) {
+    dhdr->offsetData[i] = swap32(dhdr->offsetData[i]);
+    dhdr->addressData[i] = swap32(dhdr->addressData[i]);
+    dhdr->sizeData[i] = swap32(dhdr->sizeData[i]);
+  }
+  dhdr->entrypoint = swap32(dhdr->entrypoint);
+  dhdr->sizeBSS = swap32(dhdr->sizeBSS);
+  dhdr->addressBSS = swap32(dhdr->addressBSS);
+}
+
+int dol_read_header(linput_t *fp, dolhdr *dhdr)
+{
+  // read in dolheader
+  qlseek(fp, 0, SEEK_SET);
+  if(ldr_qlread(fp, dhdr, sizeof(dolhdr)) != sizeof(dolhdr)) return(0);
+
+  // convert header
+  dol_swap_header(dhdr);
+  return(1);
+}
+
+/*--------------------------------------------------------------------------
+ *
+ *   A disc image tells where main.dol starts. Its segments are loaded
+ *   from the image directly, nothing has to be extracted.
+ *
+ */
+
+int dol_read_disc_header(linput_t *fp, dolhdr *dhdr)
+{
+  unsigned char header[GCM_HEADER_SIZE];
+  unsigned int base;
+  int i;
+
+  qlseek(fp, 0, SEEK_SET);
+  if (ldr_qlread(fp, header, sizeof(header)) != sizeof(header)) return(0);
+  if (dol_word(header + GCM_MAGIC_OFFSET) != GCM_MAGIC) return(0);
+  base = dol_word(header + GCM_DOL_OFFSET);
+
+  // read the header of main.dol where it is
+  qlseek(fp, base, SEEK_SET);
+  if (ldr_qlread(fp, dhdr, sizeof(dolhdr)) != sizeof(dolhdr)) return(0);
+  dol_swap_header(dhdr);
+
+  // sections are found relative to the image from now on
+  for (i=0; i<7; i++)
+    if (dhdr->offsetText[i] != 0) dhdr->offsetText[i] += base;
+  for (i=0; i<11; i++)
+    if (dhdr->offsetData[i] != 0) dhdr->offsetData[i] += base;
+  return(1);
+}
+
+/*--------------------------------------------------------------------------
+ *
+ *   Check the supposed header for sanity.
+ *
+ */
+
+int dol_check_header(const dolhdr *dhdr, int64 filelen)
+{
+  int i, valid = 0;
+
+  // if too short for a DOL header then this is no DOL
+  if (filelen < 0x100) return(0);
+
+  for (i=0; i<7; i++) {
+    
+    // DOL segment MAY NOT physically stored in the header
+    if (dhdr->offsetText[i]!=0 && dhdr->offsetText[i]<0x100) return(0);
+    // end of physical storage must be within file
+    if (dhdr->offsetText[i]+dhdr->sizeText[i]>filelen) return(0);
+    // we only accept DOLs with segments above 2GB
+    if (dhdr->addressText[i] != 0 && !(dhdr->addressText[i] & 0x80000000)) return(0);
+
+    // remember that entrypoint was in a code segment
+    if (dhdr->entrypoint >= dhdr->addressText[i] && dhdr->entrypoint < dhdr->addressText[i]+dhdr->sizeText[i]) valid = 1;
+  }
+  for (i=0; i<11; i++) {
+
+    // DOL segment MAY NOT physically stored in the header
+    if (dhdr->offsetData[i]!=0 && dhdr->offsetData[i]<0x100) return(0);
+    // end of physical storage must be within file
+    if (dhdr->offsetData[i]+dhdr->sizeData[i]>filelen) return(0);
+    // we only accept DOLs with segments above 2GB
+    if (dhdr->addressData[i] != 0 && !(dhdr->addressData[i] & 0x80000000)) return(0);
+  }
+  
+  // if there is a BSS segment it must be above 2GB, too
+  if (dhdr->addressBSS != 0 && !(dhdr->addressBSS & 0x80000000)) return(0);
+  
+  // if entrypoint is not within a code segment reject this file
+  return(valid);
+}
+
+/*--------------------------------------------------------------------------
+ *
+ *   Read the contents of the text and data segments, one read each
+ *
+ */
+
+// read the contents of a segment, empty if it has none
+static int dol_read_segment(linput_t *fp, unsigned int offset, unsigned int address, unsigned int size, dol_segment *seg)
+{
+  seg->address = address;
+  seg->bytes.clear();
+  if (address == 0 || size == 0) return(1);
+
+  seg->bytes.resize(size);
+  qlseek(fp, offset, SEEK_SET);
+  if (ldr_qlread(fp, seg->bytes.data(), seg->bytes.size()) != (ssize_t)seg->bytes.size()) {
+    seg->bytes.clear();
+    return(0);
+  }
+  return(1);
+}
+
+int dol_read_contents(linput_t *fp, const dolhdr *dhdr, dol_contents *contents)
+{
+  int i;
+
+  for (i=0; i<7; i++)
+    if (!dol_read_segment(fp, dhdr->offsetText[i], dhdr->addressText[i], dhdr->sizeText[i], &contents->text[i])) return(0);
+  for (i=0; i<11; i++)
+    if (!dol_read_segment(fp, dhdr->offsetData[i], dhdr->addressData[i], dhdr->sizeData[i], &contents->data[i])) return(0);
+  return(1);
+}
+
+/*--------------------------------------------------------------------------
+ *
+ *   Create the segments of the DOL and fill them with their contents,
+ *   which are kept for seeding the analysis
+ *
+ */
+
+int dol_load_segments(linput_t *fp, const dolhdr *dhdr, dol_contents *contents)
+{
+  uint snum;
+  int i;
+
+  if (!dol_read_contents(fp, dhdr, contents)) return(0);
+
+  // create all code segments
+  for (i=0, snum=1; i<7; i++, snum++) {
+    char buf[50];
+    
+    // 0 == no segment
+    if (dhdr->addressText[i] == 0) continue;
+    
+    // create a name according to segmenttype and number
+    qsnprintf(buf, sizeof(buf), NAME_CODE "%u", snum);
+    
+    // add the code segment
+    if (!add_segm(1, dhdr->addressText[i], dhdr->addressText[i]+dhdr->sizeText[i], buf, CLASS_CODE)) return(0);
+    
+    // set addressing to 32 bit
+    set_segm_addressing(getseg(dhdr->addressText[i]), 1);
+
+    // and get the content, already read from the file
+    if (!contents->text[i].bytes.empty())
+      mem2base(contents->text[i].bytes.data(), dhdr->addressText[i], dhdr->addressText[i]+dhdr->sizeText[i], dhdr->offsetText[i]);
+    ldr_count(LDR_SEGMENTS);
+    ldr_count(LDR_LOADED_BYTES, dhdr->sizeText[i]);
+  }
+
+  // create all data segments
+  for (i=0, snum=1; i<11; i++, snum++) {
+    char buf[50];
+
+    // 0 == no segment
+    if (dhdr->addressData[i] == 0) continue;
+
+    // create a name according to segmenttype and number
+    qsnprintf(buf, sizeof(buf), NAME_DATA "%u", snum);
+
+    // add the data segment
+    if (!add_segm(1, dhdr->addressData[i], dhdr->addressData[i]+dhdr->sizeData[i], buf, CLASS_DATA)) return(0);
+    
+    // set addressing to 32 bit
+    set_segm_addressing(getseg(dhdr->addressData[i]), 1);
+
+    // and get the content, already read from the file
+    if (!contents->data[i].bytes.empty())
+      mem2base(contents->data[i].bytes.data(), dhdr->addressData[i], dhdr->addressData[i]+dhdr->sizeData[i], dhdr->offsetData[i]);
+    ldr_count(LDR_SEGMENTS);
+    ldr_count(LDR_LOADED_BYTES, dhdr->sizeData[i]);
+  }
+
+  // is there a BSS defined?
+  if (dhdr->addressBSS != 0) {
+    // then add it
+    if(!add_segm(1, dhdr->addressBSS, dhdr->addressBSS+dhdr->sizeBSS, NAME_BSS, CLASS_BSS)) return(0);
+
+    // and set addressing mode to 32 bit
+    set_segm_addressing(getseg(dhdr->addressBSS), 1);
+    ldr_count(LDR_SEGMENTS);
+  }
+
+  return(1);
+}
+
+/*--------------------------------------------------------------------------
+ *
+ *   Rewrite the contents of the segments of an earlier load, for a
+ *   rebuilt DOL
+ *
+ */
+
+// write back the runs of bytes that differ from the database
+static int dol_reload_segment(const dol_segment *seg)
+{
+  std::vector<unsigned char> current;
+  size_t size = seg->bytes.size();
+  size_t k, end;
+
+  if (size == 0) return(1);
+  if (getseg(seg->address) == NULL) return(0);
+
+  current.resize(size);
+  if (get_bytes(current.data(), (ssize_t)size, seg->address) != (ssize_t)size) current.assign(size, 0);
+
+  for (k=0; k<size; k=end) {
+    if (seg->bytes[k] == current[k]) { end = k+1; continue; }
+    for (end=k+1; end<size && seg->bytes[end]!=current[end]; end++) ;
+    put_bytes(seg->address+k, &seg->bytes[k], end-k);
+    ldr_count(LDR_WRITTEN_BYTES, end-k);
+  }
+  return(1);
+}
+
+int dol_reload_segments(linput_t *fp, const dolhdr *dhdr, dol_contents *contents)
+{
+  int i;
+
+  if (!dol_read_contents(fp, dhdr, contents)) return(0);
+
+  for (i=0; i<7; i++)
+    if (!dol_reload_segment(&contents->text[i])) return(0);
+  for (i=0; i<11; i++)
+    if (!dol_reload_segment(&contents->data[i])) return(0);
+  return(1);
+}
+
+/*--------------------------------------------------------------------------
+ *
+ *   Find the end of the highest segment
+ *
+ */
+
+unsigned int dol_end_address(const dolhdr *dhdr)
+{
+  unsigned int end = 0;
+  int i;
+
+  for (i=0; i<7; i++)
+    if (dhdr->addressText[i] != 0 && dhdr->addressText[i]+dhdr->sizeText[i] > end) end = dhdr->addressText[i]+dhdr->sizeText[i];
+  for (i=0; i<11; i++)
+    if (dhdr->addressData[i] != 0 && dhdr->addressData[i]+dhdr->sizeData[i] > end) end = dhdr->addressData[i]+dhdr->sizeData[i];
+  if (dhdr->addressBSS != 0 && dhdr->addressBSS+dhdr->sizeBSS > end) end = dhdr->addressBSS+dhdr->sizeBSS;
+
+  return(end);
+}
+
+/*--------------------------------------------------------------------------
+ *
+ *   Queue functions for auto-analysis. IDA otherwise starts from the
+ *   entrypoint alone, which takes ages on a large DOL.
+ *
+ *   The CodeWarrior linker puts the static constructor and destructor
+ *   tables in data segments of their own: code pointers ending in a null
+ *   word. Everything in them is a function. Any other word of the data
+ *   segments pointing into code is only taken if the code there starts
+ *   with a stack frame (stwu r1 or mflr r0), which keeps jump tables
+ *   into the middle of functions out.
+ *
+ */
+
+// instruction at a code address, NULL if it isn't in a text segment
+static const unsigned char *dol_code_at(const dol_segment *text, unsigned int ea)
+{
+  int i;
+
+  if (ea & 3) return(NULL);
+  for (i=0; i<7; i++) {
+    if (ea >= text[i].address && ea - text[i].address + 4 <= text[i].bytes.size())
+      return(&text[i].bytes[ea - text[i].address]);
+  }
+  return(NULL);
+}
+
+// code pointers followed by nulls only, returns the number of pointers or
+// 0 if the segment isn't such a table
+static unsigned int dol_pointer_table(const dol_segment *text, const dol_segment *seg)
+{
+  unsigned int i, count = 0, size = (unsigned int)seg->bytes.size() & ~3u;
+
+  for (i=0; i<size; i+=4) {
+    unsigned int word = dol_word(&seg->bytes[i]);
+    if (word == 0) break;
+    if (dol_code_at(text, word) == NULL) return(0);
+    count++;
+  }
+  if (i == size) return(0);
+  for (; i<size; i+=4)
+    if (dol_word(&seg->bytes[i]) != 0) return(0);
+  return(count);
+}
+
+static int dol_all_zero(const dol_segment *seg)
+{
+  unsigned int i;
+
+  if (seg->bytes.empty()) return(0);
+  for (i=0; i<seg->bytes.size(); i++)
+    if (seg->bytes[i] != 0) return(0);
+  return(1);
+}
+
+// name a table and turn its entries into offsets to their functions
+static unsigned int dol_apply_table(const dol_segment *seg, unsigned int count, const char *name, std::set<unsigned int> &targets)
+{
+  unsigned int i;
+
+  force_name(seg->address, name, 0);
+  ldr_count(LDR_NAMES);
+  for (i=0; i<count; i++) {
+    create_dword(seg->address + i*4, 4);
+    op_plain_offset(seg->address + i*4, 0, 0);
+    targets.insert(dol_word(&seg->bytes[i*4]));
+  }
+  return(count);
+}
+
+unsigned int dol_seed_functions(const dolhdr *dhdr, const dol_contents *contents)
+{
+  const dol_segment *text = contents->text, *data = contents->data;
+  unsigned int count[11];
+  std::set<unsigned int> targets;
+  int i, ctors = -1, dtors = -1;
+  unsigned int tables = 0, pointers = 0;
+
+  ldr_scope trace("seed_functions");
+
+  // the first table is _ctors and the second _dtors. Without static
+  // constructors _ctors is only nulls, right before _dtors.
+  for (i=0; i<11; i++) {
+    count[i] = dol_pointer_table(text, &data[i]);
+    if (count[i] == 0) continue;
+    if (ctors < 0) ctors = i;
+    else if (dtors < 0) dtors = i;
+  }
+  if (ctors >= 0 && dtors < 0) {
+    for (i=0; i<11; i++) {
+      unsigned int end = data[i].address + (unsigned int)data[i].bytes.size();
+      if (dol_all_zero(&data[i]) && end <= data[ctors].address && data[ctors].address - end < 0x20) {
+        dtors = ctors;
+        ctors = i;
+        break;
+      }
+    }
+  }
+  if (ctors >= 0) tables += dol_apply_table(&data[ctors], count[ctors], "_ctors", targets);
+  if (dtors >= 0) tables += dol_apply_table(&data[dtors], count[dtors], "_dtors", targets);
+
+  // any other code pointer leading to a stack frame
+  for (i=0; i<11; i++) {
+    unsigned int offset;
+    if (i == ctors || i == dtors) continue;
+    for (offset=0; offset+4<=data[i].bytes.size(); offset+=4) {
+      const unsigned char *code = dol_code_at(text, dol_word(&data[i].bytes[offset]));
+      if (code == NULL) continue;
+      if (dol_word(code) == PPC_MFLR_R0 || (dol_word(code) & PPC_STWU_MASK) == PPC_STWU_R1) {
+        targets.insert(dol_word(&data[i].bytes[offset]));
+        pointers++;
+      }
+    }
+  }
+
+  // queue them in address order, along with the entrypoint
+  targets.insert(dhdr->entrypoint);
+  for (std::set<unsigned int>::const_iterator it = targets.begin(); it != targets.end(); ++it)
+    auto_make_proc(*it);
+
+  msg("DOL: Queued %u functions from %u table entries and %u code pointers\n", (unsigned int)targets.size(), tables, pointers);
+  return((unsigned int)targets.size());
+}
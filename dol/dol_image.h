@@ -0,0 +1,60 @@
+/*
+ *  IDA Nintendo GameCube DOL Loader Module
+ *  (C) Copyright 2004 by Stefan Esser
+ *
+ *  Reading and mapping of DOL images, shared by the DOL loader and the
+ *  linked game mode of the REL loader.
+ *
+ */
+
+#ifndef __DOL_IMAGE_H__
+#define __DOL_IMAGE_H__
+
+#include "../loader/idaloader.h"
+#include "dol.h"
+#include <vector>
+
+// contents of a segment as in the file, empty if it has none
+struct dol_segment {
+  unsigned int address;
+  std::vector<unsigned char> bytes;
+};
+
+struct dol_contents {
+  dol_segment text[7];
+  dol_segment data[11];
+};
+
+// read the header and swap it to host order, returns 0 on failure
+int dol_read_header(linput_t *fp, dolhdr *dhdr);
+
+// read the header of main.dol on a GameCube disc image, its section
+// offsets made relative to the image. Returns 0 if fp isn't a disc.
+int dol_read_disc_header(linput_t *fp, dolhdr *dhdr);
+
+// sanity check a header against the size of its file, returns 0 if the
+// file can't be a DOL
+int dol_check_header(const dolhdr *dhdr, int64 filelen);
+
+// read the contents of the text and data segments, returns 0 on a short
+// read
+int dol_read_contents(linput_t *fp, const dolhdr *dhdr, dol_contents *contents);
+
+// create the text, data and bss segments and load their contents, read
+// into contents once. Returns 0 if a segment could not be created or read
+int dol_load_segments(linput_t *fp, const dolhdr *dhdr, dol_contents *contents);
+
+// write the contents into the segments of an earlier load where they
+// differ, for reloading a rebuilt DOL. Returns 0 if a segment is missing,
+// the database must then be recreated
+int dol_reload_segments(linput_t *fp, const dolhdr *dhdr, dol_contents *contents);
+
+// first address after all segments, including the bss
+unsigned int dol_end_address(const dolhdr *dhdr);
+
+// find the _ctors/_dtors tables and other code pointers in the data
+// segments and queue their targets as functions, returns the number of
+// functions queued. Works on the contents dol_load_segments read.
+unsigned int dol_seed_functions(const dolhdr *dhdr, const dol_contents *contents);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef __LDR_GCM_H__
+#define __LDR_GCM_H__
+
+// Layout of GameCube disc images (.gcm, .iso), shared by the loaders.
+// All fields are big endian.
+//
+//    0000-0005  game code
+//    001C       magic
+//    0020-03FF  game name
+//    0420       file offset of main.dol
+//    0424       file offset of the FST
+//    0428       size of the FST
+//
+// The FST (file system table) is a flat array of 12 byte entries. The
+// first is the root directory, its size field holding the number of
+// entries. Directories hold their parent's index and the index after
+// their last child, files their offset and size on the disc. Names
+// follow the entries as a string table.
+
+#define GCM_MAGIC           0xC2339F3D
+#define GCM_MAGIC_OFFSET    0x1C
+#define GCM_DOL_OFFSET      0x420
+#define GCM_FST_OFFSET      0x424
+#define GCM_FST_SIZE        0x428
+#define GCM_HEADER_SIZE     0x440
+
+#define GCM_FST_ENTRY_SIZE  12
+#define GCM_FST_DIRECTORY   0x01    // flags, the top byte of the first word
+
+#endif // #ifndef __LDR_GCM_H__
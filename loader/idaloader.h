@@ -17,6 +17,7 @@
 #include <kernwin.hpp>
 #include <nalt.hpp>
 #include <typeinf.hpp>
+#include <ua.hpp>
 
 #define CLASS_CODE    "CODE"
 #define NAME_CODE     ".text"
@@ -0,0 +1,183 @@
+#include "ldr_trace.h"
+#include <algorithm>
+#include <cstring>
+
+static char const * const g_counter_names[LDR_COUNTER_COUNT] =
+{
+  "reads", "read_bytes", "segments", "loaded_bytes", "patches",
+  "written_bytes", "names", "comments", "entries", "inflated_bytes",
+  "functions", "offsets",
+};
+
+ldr_trace &ldr_trace::get()
+{
+  static ldr_trace trace;
+  return trace;
+}
+
+ldr_trace::ldr_trace()
+{
+  this->reset();
+}
+
+void ldr_trace::reset()
+{
+  m_origin = clock::now();
+  m_open.clear();
+  m_phases.clear();
+  m_phase_index.clear();
+  m_events.clear();
+  memset(m_counters, 0, sizeof(m_counters));
+  memset(m_types, 0, sizeof(m_types));
+  memset(m_unsupported, 0, sizeof(m_unsupported));
+  m_modules.clear();
+}
+
+double ldr_trace::since_origin(clock::time_point const &t) const
+{
+  return std::chrono::duration<double, std::micro>(t - m_origin).count();
+}
+
+void ldr_trace::begin(char const *name)
+{
+  // Totals per phase and nesting depth, for the summary
+  unsigned depth = static_cast<unsigned>(m_open.size());
+  auto key = std::make_pair(depth, std::string(name));
+  auto it = m_phase_index.find(key);
+  if ( it == m_phase_index.end() )
+  {
+    phase total = { name, depth, 0, 0 };
+    it = m_phase_index.insert(std::make_pair(key, m_phases.size())).first;
+    m_phases.push_back(total);
+  }
+
+  open_phase p = { name, it->second, clock::now() };
+  m_open.push_back(p);
+}
+
+void ldr_trace::end()
+{
+  if ( m_open.empty() )
+    return;
+
+  clock::time_point now = clock::now();
+  open_phase p = m_open.back();
+  m_open.pop_back();
+  unsigned depth = static_cast<unsigned>(m_open.size());
+  double seconds = std::chrono::duration<double>(now - p.m_start).count();
+
+  m_phases[p.m_phase].m_calls += 1;
+  m_phases[p.m_phase].m_seconds += seconds;
+
+  if ( m_events.size() < TRACE_MAX_EVENTS )
+  {
+    event e = { p.m_name, this->since_origin(p.m_start), seconds * 1e6, depth };
+    m_events.push_back(e);
+  }
+}
+
+void ldr_trace::count(ldr_counter counter, uint64_t n)
+{
+  m_counters[counter] += n;
+}
+
+void ldr_trace::count_type(uint8_t type, uint64_t n, bool supported)
+{
+  m_types[type] += n;
+  m_unsupported[type] = !supported;
+}
+
+void ldr_trace::count_module(uint32_t module, uint64_t n)
+{
+  m_modules[module] += n;
+}
+
+void ldr_trace::report(char const *title, char const *path)
+{
+  msg("%s: time by phase\n", title);
+  for ( auto it = m_phases.begin(); it != m_phases.end(); ++it )
+  {
+    msg("%s:   %*s%-*s %8.3fs %6llu call%s\n", title, it->m_depth * 2, "", 28 - it->m_depth * 2, it->m_name.c_str(),
+        it->m_seconds, static_cast<unsigned long long>(it->m_calls), it->m_calls == 1 ? "" : "s");
+  }
+
+  msg("%s: %llu reads (%llu bytes), %llu segments (%llu bytes loaded), %llu patches (%llu bytes written), %llu names, %llu comments, %llu entries, %llu functions, %llu offsets, %llu bytes inflated\n",
+      title,
+      static_cast<unsigned long long>(m_counters[LDR_READS]), static_cast<unsigned long long>(m_counters[LDR_READ_BYTES]),
+      static_cast<unsigned long long>(m_counters[LDR_SEGMENTS]), static_cast<unsigned long long>(m_counters[LDR_LOADED_BYTES]),
+      static_cast<unsigned long long>(m_counters[LDR_PATCHES]), static_cast<unsigned long long>(m_counters[LDR_WRITTEN_BYTES]),
+      static_cast<unsigned long long>(m_counters[LDR_NAMES]), static_cast<unsigned long long>(m_counters[LDR_COMMENTS]),
+      static_cast<unsigned long long>(m_counters[LDR_ENTRIES]), static_cast<unsigned long long>(m_counters[LDR_FUNCTIONS]),
+      static_cast<unsigned long long>(m_counters[LDR_OFFSETS]), static_cast<unsigned long long>(m_counters[LDR_INFLATED_BYTES]));
+
+  for ( unsigned type = 0; type < 256; ++type )
+  {
+    if ( m_types[type] != 0 )
+      msg("%s:   relocation type %3u: %llu%s\n", title, type, static_cast<unsigned long long>(m_types[type]), m_unsupported[type] ? " (unsupported)" : "");
+  }
+  for ( auto it = m_modules.begin(); it != m_modules.end(); ++it )
+    msg("%s:   patches against module %u: %llu\n", title, it->first, static_cast<unsigned long long>(it->second));
+
+  if ( path != nullptr && path[0] != '\0' )
+  {
+    if ( this->write_chrome(path) )
+      msg("%s: Trace written to %s\n", title, path);
+    else
+      msg("%s: Unable to write the trace to %s\n", title, path);
+  }
+
+  this->reset();
+}
+
+// Phase names are identifiers, they need no escaping
+bool ldr_trace::write_chrome(char const *path) const
+{
+  FILE *fp = qfopen(path, "w");
+  if ( fp == nullptr )
+    return false;
+
+  std::string out = "{\"traceEvents\":[\n";
+  char line[MAXSTR];
+  for ( auto it = m_events.begin(); it != m_events.end(); ++it )
+  {
+    qsnprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%u}},\n",
+              it->m_name, it->m_start, it->m_duration, it->m_depth);
+    out += line;
+  }
+
+  // Counters at the end of the timeline
+  double last = 0;
+  for ( auto it = m_events.begin(); it != m_events.end(); ++it )
+    last = std::max(last, it->m_start + it->m_duration);
+  qsnprintf(line, sizeof(line), "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"args\":{", last);
+  out += line;
+  for ( int i = 0; i < LDR_COUNTER_COUNT; ++i )
+  {
+    qsnprintf(line, sizeof(line), "%s\"%s\":%llu", i == 0 ? "" : ",", g_counter_names[i], static_cast<unsigned long long>(m_counters[i]));
+    out += line;
+  }
+  out += "}}\n]}\n";
+
+  bool ok = qfwrite(fp, out.data(), out.size()) == static_cast<ssize_t>(out.size());
+  qfclose(fp);
+  return ok;
+}
+
+ldr_scope::ldr_scope(char const *name)
+{
+  ldr_trace::get().begin(name);
+}
+
+ldr_scope::~ldr_scope()
+{
+  ldr_trace::get().end();
+}
+
+ssize_t ldr_qlread(linput_t *li, void *buf, size_t size)
+{
+  ssize_t n = qlread(li, buf, size);
+  ldr_count(LDR_READS);
+  if ( n > 0 )
+    ldr_count(LDR_READ_BYTES, static_cast<uint64_t>(n));
+  return n;
+}
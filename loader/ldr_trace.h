@@ -0,0 +1,111 @@
+#ifndef __LDR_TRACE_H__
+#define __LDR_TRACE_H__
+
+#include "idaloader.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#define TRACE_ENV         "LDR_TRACE"   // path of a Chrome trace_event file to write
+#define TRACE_MAX_EVENTS  100000        // timeline events kept, phase totals are always kept
+
+enum ldr_counter
+{
+  LDR_READS,            // qlread calls
+  LDR_READ_BYTES,
+  LDR_SEGMENTS,
+  LDR_LOADED_BYTES,     // file2base and mem2base
+  LDR_PATCHES,          // relocation patches, changed ranges when reloading
+  LDR_WRITTEN_BYTES,    // patch_bytes and put_bytes
+  LDR_NAMES,
+  LDR_COMMENTS,
+  LDR_ENTRIES,
+  LDR_INFLATED_BYTES,   // decompressed from Yaz0
+  LDR_FUNCTIONS,        // function starts queued for analysis
+  LDR_OFFSETS,          // offset operands and data pointers, with their xrefs
+  LDR_COUNTER_COUNT,
+};
+
+// Wall time of the loader phases and counts of what they did, shared by
+// both loaders. Phases nest. The summary goes to the output window, the
+// timeline optionally to a Chrome trace_event file for chrome://tracing
+// or Perfetto. Not thread safe, only the main thread records.
+class ldr_trace
+{
+public:
+  static ldr_trace &get();
+
+  void reset();
+
+  void begin(char const *name);
+  void end();
+
+  void count(ldr_counter counter, uint64_t n = 1);
+  void count_type(uint8_t type, uint64_t n, bool supported);
+  void count_module(uint32_t module, uint64_t n);
+
+  // Prints the summary to the output window, writes the timeline to path
+  // unless it is empty, then starts over
+  void report(char const *title, char const *path);
+
+private:
+  ldr_trace();
+
+  typedef std::chrono::steady_clock clock;
+
+  struct phase
+  {
+    std::string m_name;
+    unsigned m_depth;
+    uint64_t m_calls;
+    double m_seconds;
+  };
+
+  struct event
+  {
+    char const *m_name;       // phase names are literals
+    double m_start;           // microseconds since m_origin
+    double m_duration;
+    unsigned m_depth;
+  };
+
+  struct open_phase
+  {
+    char const *m_name;
+    size_t m_phase;           // index into m_phases
+    clock::time_point m_start;
+  };
+
+  bool write_chrome(char const *path) const;
+  double since_origin(clock::time_point const &t) const;
+
+  clock::time_point m_origin;
+  std::vector<open_phase> m_open;
+  std::vector<phase> m_phases;                    // in order of first start
+  std::map<std::pair<unsigned, std::string>, size_t> m_phase_index;
+  std::vector<event> m_events;
+  uint64_t m_counters[LDR_COUNTER_COUNT];
+  uint64_t m_types[256];
+  bool m_unsupported[256];
+  std::map<uint32_t, uint64_t> m_modules;
+};
+
+// Times the enclosing block as a phase
+class ldr_scope
+{
+public:
+  ldr_scope(char const *name);
+  ~ldr_scope();
+};
+
+inline void ldr_count(ldr_counter counter, uint64_t n = 1)
+{
+  ldr_trace::get().count(counter, n);
+}
+
+// qlread, counted
+ssize_t ldr_qlread(linput_t *li, void *buf, size_t size);
+
+#endif // #ifndef __LDR_TRACE_H__
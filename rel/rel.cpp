@@ -6,8 +6,123 @@
 
 #include "rel.h"
 #include "rel_track.h"
+#include "rel_link.h"
+#include "rel_gcm.h"
+#include "../dol/dol_image.h"
+#include "../loader/ldr_trace.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
 
 
+/*-----------------------------------------------------------------
+*
+*   accept_file parses the module once and keeps it around, keyed
+*   by the size and header of the input, so that load_file doesn't
+*   have to parse it a second time.
+*
+*/
+
+struct rel_file_key
+{
+  int64 size;
+  uint8_t header[sizeof(rsohdr)];    // the larger of the two headers
+};
+
+static rel_file_key g_accepted_key;
+static std::unique_ptr<rel_track> g_accepted;
+
+// Reads the identity of the input with a single fixed-size read
+static bool read_file_key(linput_t *fp, rel_file_key &key)
+{
+  key.size = qlsize(fp);
+  qlseek(fp, 0, SEEK_SET);
+  return ldr_qlread(fp, key.header, sizeof(key.header)) == sizeof(key.header);
+}
+
+// Decodes the header of a Yaz0 input into key, reading only the few
+// compressed bytes it takes. The size becomes the decompressed size.
+static bool read_yaz0_key(linput_t *fp, rel_file_key &key)
+{
+  uint32_t size;
+  if (!rel_yaz0_probe(key.header, sizeof(key.header), size))
+    return false;
+
+  // Every 8 bytes of output take at most 9 bytes of literals
+  uint8_t packed[YAZ0_HEADER_SIZE + sizeof(key.header) * 9 / 8 + 8];
+  ssize_t n = static_cast<ssize_t>(std::min<int64>(sizeof(packed), key.size));
+  qlseek(fp, 0, SEEK_SET);
+  if (ldr_qlread(fp, packed, n) != n)
+    return false;
+
+  key.size = size;
+  return rel_yaz0_decode(packed + YAZ0_HEADER_SIZE, n - YAZ0_HEADER_SIZE, key.header, sizeof(key.header)) == sizeof(key.header);
+}
+
+static bool same_file(rel_file_key const &a, rel_file_key const &b)
+{
+  return a.size == b.size && memcmp(a.header, b.header, sizeof(a.header)) == 0;
+}
+
+// Directory of the game accepted for linking
+static std::string g_link_directory;
+
+// Disc image accepted for linking
+static std::string g_link_disc;
+
+
+
+/*-----------------------------------------------------------------
+*
+*   A DOL with modules next to it can also be loaded as a whole
+*   game, the modules linked to it in a single database. The DOL
+*   loader stays the default for the file.
+*
+*/
+
+static int accept_linked_game(qstring *fileformatname, qstring *processor, linput_t *fp, const char *filename)
+{
+  dolhdr dhdr;
+  if (filename == nullptr || dol_read_header(fp, &dhdr) == 0 || dol_check_header(&dhdr, qlsize(fp)) == 0)
+    return 0;
+
+  char dir[260] = {};
+  if (!qdirname(dir, sizeof(dir), filename) || rel_link::count_modules(dir) == 0)
+    return 0;
+
+  g_link_directory = dir;
+  *fileformatname = LINK_FORMAT_NAME;
+  *processor = "PPC";
+  return 0xD07;
+}
+
+/*-----------------------------------------------------------------
+*
+*   A GameCube disc image is linked the same way, main.dol and the
+*   modules being read from the image in place instead of having to
+*   be extracted first.
+*
+*/
+
+static int accept_linked_disc(qstring *fileformatname, qstring *processor, const char *filename)
+{
+  rel_gcm disc;
+  if (filename == nullptr || !disc.open(filename) || rel_link::count_modules(disc) == 0)
+    return 0;
+
+  dolhdr dhdr;
+  linput_t *dol = disc.open_linput(disc.get_main());
+  bool valid = dol != nullptr && dol_read_header(dol, &dhdr) != 0 && dol_check_header(&dhdr, qlsize(dol)) != 0;
+  if (dol != nullptr)
+    close_linput(dol);
+  if (!valid)
+    return 0;
+
+  g_link_disc = filename;
+  *fileformatname = LINK_DISC_FORMAT_NAME;
+  *processor = "PPC";
+  return 0xD07;
+}
 
 /*-----------------------------------------------------------------
 *
@@ -19,16 +134,39 @@
 
 int idaapi accept_file(qstring *fileformatname, qstring *processor, linput_t *fp, const char *filename)
 {
+  ldr_scope trace("accept_file");
   //if (n) return(0);
 
-  rel_track test_valid(fp);
+  // Reject anything that doesn't even have a plausible header. Compressed
+  // modules are checked on their decoded header before inflating them.
+  rel_file_key key;
+  if (!read_file_key(fp, key))
+    return accept_linked_game(fileformatname, processor, fp, filename);
+  if (rel_gcm_probe(key.header, sizeof(key.header)))
+    return accept_linked_disc(fileformatname, processor, filename);
+
+  uint32_t inflated_size;
+  rel_file_key probe = key;
+  if (rel_yaz0_probe(key.header, sizeof(key.header), inflated_size) && !read_yaz0_key(fp, probe))
+    return 0;
+  if (!rel_probe_header(probe.header, sizeof(probe.header), probe.size) && !rso_probe_header(probe.header, sizeof(probe.header), probe.size))
+    return accept_linked_game(fileformatname, processor, fp, filename);
+
+  std::unique_ptr<rel_track> test_valid(new rel_track(fp));
 
   // Check if valid
-  if (!test_valid.is_good())
+  if (!test_valid->is_good())
     return 0;
 
+  // Keep the parsed module for load_file
+  g_accepted_key = key;
+  g_accepted = std::move(test_valid);
+
   // file has passed all sanity checks and might be a rel
-  *fileformatname = "Nintendo REL";
+  if (g_accepted->is_rso())
+    *fileformatname = g_accepted->is_compressed() ? "Nintendo RSO (Yaz0)" : "Nintendo RSO";
+  else
+    *fileformatname = g_accepted->is_compressed() ? "Nintendo REL (Yaz0)" : "Nintendo REL";
   return(ACCEPT_FIRST | 0xD07);
 }
 
@@ -41,7 +179,80 @@ int idaapi accept_file(qstring *fileformatname, qstring *processor, linput_t *fp
 *
 */
 
-void idaapi load_file(linput_t *fp, ushort neflag, const char * /*fileformatname*/)
+// Writes the load plans to REL_PLAN_DUMP if set, returns nullptr otherwise
+static FILE *open_plan_dump(qstring &dump_path)
+{
+  if ( !qgetenv("REL_PLAN_DUMP", &dump_path) || dump_path.empty() )
+    return nullptr;
+
+  FILE *fp = qfopen(dump_path.c_str(), "w");
+  if ( fp == nullptr )
+    err_msg("REL: Unable to write the load plan to %s", dump_path.c_str());
+  return fp;
+}
+
+// Prints where the load spent its time, and writes the timeline to
+// LDR_TRACE if set
+static void report_trace()
+{
+  qstring trace_path;
+  qgetenv(TRACE_ENV, &trace_path);
+  ldr_trace::get().report("REL", trace_path.c_str());
+}
+
+// Links main.dol from fp to the modules in directory, or on disc
+static void load_linked_game(linput_t *fp, std::string const &directory, rel_gcm const *disc, bool dry_run, bool reload)
+{
+  qstring dump_path;
+  FILE *dump = open_plan_dump(dump_path);
+
+  rel_link game(directory, disc);
+  bool loaded = game.load(fp, dry_run, reload, dump);
+  if ( dump != nullptr )
+    qfclose(dump);
+  if ( !loaded )
+    qexit(1);
+  inf.start_ea = inf.start_ip = game.get_entry_point();
+}
+
+static void load_linked_dol(linput_t *fp, bool dry_run, bool reload)
+{
+  // Fall back to the database's directory if accept_file wasn't asked
+  std::string directory = g_link_directory;
+  if ( directory.empty() )
+  {
+    char dir[260] = {};
+    qdirname(dir, sizeof(dir), get_path(PATH_TYPE_IDB));
+    directory = dir;
+  }
+  load_linked_game(fp, directory, nullptr, dry_run, reload);
+}
+
+static void load_linked_disc(bool dry_run, bool reload)
+{
+  // Fall back to the input file if accept_file wasn't asked
+  std::string path = g_link_disc;
+  if ( path.empty() )
+  {
+    char input[260] = {};
+    get_input_file_path(input, sizeof(input));
+    path = input;
+  }
+
+  // The disc is mapped for the whole load, main.dol is read through a
+  // view of it. Maps are looked for next to the image.
+  rel_gcm disc;
+  linput_t *dol = disc.open(path.c_str()) ? disc.open_linput(disc.get_main()) : nullptr;
+  if ( dol == nullptr )
+    qexit(1);
+
+  char dir[260] = {};
+  qdirname(dir, sizeof(dir), path.c_str());
+  load_linked_game(dol, dir, &disc, dry_run, reload);
+  close_linput(dol);
+}
+
+void idaapi load_file(linput_t *fp, ushort neflag, const char *fileformatname)
 {
   // Hello here I am
   msg("---------------------------------------\n");
@@ -54,15 +265,71 @@ void idaapi load_file(linput_t *fp, ushort neflag, const char * /*fileformatname
 
   set_compiler_id(COMP_GNU);
 
-  rel_track track(fp);
-  inf.start_ea = START;
-
   // map selector 1 to 0
   set_selector(1, 0);
 
+  // REL_DRY_RUN only computes the load plan, REL_PLAN_DUMP saves it as text
+  bool dry_run = qgetenv("REL_DRY_RUN");
+
+  // Reloading only writes what changed since the module was loaded
+  bool reload = (neflag & NEF_RELOAD) != 0;
+
+  if ( fileformatname != nullptr && strcmp(fileformatname, LINK_FORMAT_NAME) == 0 )
+  {
+    g_accepted.reset();
+    {
+      ldr_scope trace("load_file");
+      load_linked_dol(fp, dry_run, reload);
+    }
+    report_trace();
+    return;
+  }
+
+  if ( fileformatname != nullptr && strcmp(fileformatname, LINK_DISC_FORMAT_NAME) == 0 )
+  {
+    g_accepted.reset();
+    {
+      ldr_scope trace("load_file");
+      load_linked_disc(dry_run, reload);
+    }
+    report_trace();
+    return;
+  }
+
+  ldr_trace::get().begin("load_file");
+
+  // Reuse the module parsed by accept_file if this is the same file
+  std::unique_ptr<rel_track> parsed;
+  rel_file_key key;
+  if ( g_accepted && read_file_key(fp, key) && same_file(key, g_accepted_key) )
+  {
+    parsed = std::move(g_accepted);
+    parsed->rebind(fp);
+  }
+  else
+  {
+    parsed.reset(new rel_track(fp));
+  }
+  g_accepted.reset();
+
+  rel_track &track = *parsed;
+  inf.start_ea = START;
+
+  // REL_NO_PLAN_CACHE always computes the plan from scratch
+  track.set_plan_cache(!qgetenv("REL_NO_PLAN_CACHE"));
+  track.apply_patches(dry_run, reload);
 
+  qstring dump_path;
+  FILE *dump = open_plan_dump(dump_path);
+  if ( dump != nullptr )
+  {
+    if ( !rel_plan_write_text(track.get_plan(), dump) )
+      err_msg("REL: Unable to write the load plan to %s", dump_path.c_str());
+    qfclose(dump);
+  }
 
-  track.apply_patches();
+  ldr_trace::get().end();
+  report_trace();
 }
 
 /*-----------------------------------------------------------------
@@ -73,7 +340,7 @@ void idaapi load_file(linput_t *fp, ushort neflag, const char * /*fileformatname
 
 extern "C" loader_t LDSC = {
   IDP_INTERFACE_VERSION,
-  0, /* no loader flags */
+  LDRF_RELOAD,  /* reloading writes only what changed */
   accept_file,
   load_file,
   NULL,
@@ -0,0 +1,228 @@
+#include "rel_cache.h"
+#include <cstring>
+
+rel_plan_cache::rel_plan_cache()
+  : m_module_hash(0)
+  , m_extern_end(0)
+{}
+
+// Host order, the cache never leaves the machine that wrote it
+template <typename T>
+static bool read_value(uint8_t const *&p, uint8_t const *end, T &value)
+{
+  if ( static_cast<size_t>(end - p) < sizeof(T) )
+    return false;
+  memcpy(&value, p, sizeof(T));
+  p += sizeof(T);
+  return true;
+}
+
+template <typename T>
+static void write_value(std::vector<uint8_t> &out, T const &value)
+{
+  uint8_t const *p = reinterpret_cast<uint8_t const *>(&value);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+static bool read_string(uint8_t const *&p, uint8_t const *end, std::string &value)
+{
+  uint32_t size = 0;
+  if ( !read_value(p, end, size) || static_cast<size_t>(end - p) < size )
+    return false;
+  value.assign(reinterpret_cast<char const *>(p), size);
+  p += size;
+  return true;
+}
+
+static void write_string(std::vector<uint8_t> &out, std::string const &value)
+{
+  write_value(out, static_cast<uint32_t>(value.size()));
+  out.insert(out.end(), value.begin(), value.end());
+}
+
+// Fixed size records go out as one block
+template <typename T>
+static bool read_array(uint8_t const *&p, uint8_t const *end, std::vector<T> &values)
+{
+  uint32_t count = 0;
+  if ( !read_value(p, end, count) || static_cast<size_t>(end - p) / sizeof(T) < count )
+    return false;
+  values.resize(count);
+  if ( count != 0 )
+    memcpy(values.data(), p, count * sizeof(T));
+  p += count * sizeof(T);
+  return true;
+}
+
+template <typename T>
+static void write_array(std::vector<uint8_t> &out, std::vector<T> const &values)
+{
+  write_value(out, static_cast<uint32_t>(values.size()));
+  uint8_t const *p = reinterpret_cast<uint8_t const *>(values.data());
+  out.insert(out.end(), p, p + values.size() * sizeof(T));
+}
+
+static bool read_comments(uint8_t const *&p, uint8_t const *end, std::vector<rel_plan_comment> &comments)
+{
+  uint32_t count = 0;
+  if ( !read_value(p, end, count) )
+    return false;
+  comments.resize(count);
+  for ( auto it = comments.begin(); it != comments.end(); ++it )
+  {
+    if ( !read_value(p, end, it->m_address) || !read_string(p, end, it->m_text) )
+      return false;
+  }
+  return true;
+}
+
+static void write_comments(std::vector<uint8_t> &out, std::vector<rel_plan_comment> const &comments)
+{
+  write_value(out, static_cast<uint32_t>(comments.size()));
+  for ( auto it = comments.begin(); it != comments.end(); ++it )
+  {
+    write_value(out, it->m_address);
+    write_string(out, it->m_text);
+  }
+}
+
+bool rel_plan_cache::load(char const *path)
+{
+  FILE *fp = qfopen(path, "rb");
+  if ( fp == nullptr )
+    return false;
+
+  std::vector<uint8_t> data;
+  uint8_t chunk[0x10000];
+  ssize_t n;
+  while ( (n = qfread(fp, chunk, sizeof(chunk))) > 0 )
+    data.insert(data.end(), chunk, chunk + n);
+  qfclose(fp);
+
+  uint8_t const *p = data.data();
+  uint8_t const *end = p + data.size();
+
+  uint32_t magic = 0, version = 0, count = 0;
+  if ( !read_value(p, end, magic) || !read_value(p, end, version) ||
+       magic != CACHE_MAGIC || version != CACHE_VERSION )
+    return false;
+
+  if ( !read_value(p, end, m_module_hash) || !read_value(p, end, count) )
+    return false;
+  m_dependencies.resize(count);
+  for ( auto it = m_dependencies.begin(); it != m_dependencies.end(); ++it )
+  {
+    if ( !read_string(p, end, it->m_name) || !read_value(p, end, it->m_hash) )
+      return false;
+  }
+
+  if ( !read_array(p, end, m_section_addresses) || !read_value(p, end, m_extern_end) )
+    return false;
+
+  // The plan: segments, patches and runs, slots, names and comments
+  m_plan.clear();
+  if ( !read_value(p, end, count) )
+    return false;
+  m_plan.m_segments.resize(count);
+  for ( auto it = m_plan.m_segments.begin(); it != m_plan.m_segments.end(); ++it )
+  {
+    if ( !read_value(p, end, it->m_start) || !read_value(p, end, it->m_end) || !read_value(p, end, it->m_file_offset) ||
+         !read_string(p, end, it->m_name) || !read_string(p, end, it->m_class) )
+      return false;
+  }
+
+  if ( !read_array(p, end, m_plan.m_patches) || !read_array(p, end, m_plan.m_runs) )
+    return false;
+
+  if ( !read_value(p, end, count) )
+    return false;
+  m_plan.m_slots.resize(count);
+  for ( auto it = m_plan.m_slots.begin(); it != m_plan.m_slots.end(); ++it )
+  {
+    if ( !read_value(p, end, it->m_address) || !read_value(p, end, it->m_value) ||
+         !read_string(p, end, it->m_name) || !read_string(p, end, it->m_comment) )
+      return false;
+  }
+
+  if ( !read_comments(p, end, m_plan.m_comments) || !read_value(p, end, count) )
+    return false;
+  m_plan.m_program_comments.resize(count);
+  for ( auto it = m_plan.m_program_comments.begin(); it != m_plan.m_program_comments.end(); ++it )
+  {
+    if ( !read_string(p, end, *it) )
+      return false;
+  }
+
+  if ( !read_comments(p, end, m_plan.m_entries) || !read_comments(p, end, m_plan.m_names) )
+    return false;
+  if ( !read_array(p, end, m_plan.m_functions) || !read_array(p, end, m_plan.m_offsets) || !read_value(p, end, m_plan.m_stats) )
+    return false;
+
+  // Patches must stay within the patch list
+  for ( auto it = m_plan.m_runs.begin(); it != m_plan.m_runs.end(); ++it )
+  {
+    if ( it->m_first > m_plan.m_patches.size() || it->m_count > m_plan.m_patches.size() - it->m_first )
+      return false;
+  }
+  return p == end;
+}
+
+bool rel_plan_cache::save(char const *path) const
+{
+  std::vector<uint8_t> out;
+  write_value(out, static_cast<uint32_t>(CACHE_MAGIC));
+  write_value(out, static_cast<uint32_t>(CACHE_VERSION));
+
+  write_value(out, m_module_hash);
+  write_value(out, static_cast<uint32_t>(m_dependencies.size()));
+  for ( auto it = m_dependencies.begin(); it != m_dependencies.end(); ++it )
+  {
+    write_string(out, it->m_name);
+    write_value(out, it->m_hash);
+  }
+
+  write_array(out, m_section_addresses);
+  write_value(out, m_extern_end);
+
+  write_value(out, static_cast<uint32_t>(m_plan.m_segments.size()));
+  for ( auto it = m_plan.m_segments.begin(); it != m_plan.m_segments.end(); ++it )
+  {
+    write_value(out, it->m_start);
+    write_value(out, it->m_end);
+    write_value(out, it->m_file_offset);
+    write_string(out, it->m_name);
+    write_string(out, it->m_class);
+  }
+
+  write_array(out, m_plan.m_patches);
+  write_array(out, m_plan.m_runs);
+
+  write_value(out, static_cast<uint32_t>(m_plan.m_slots.size()));
+  for ( auto it = m_plan.m_slots.begin(); it != m_plan.m_slots.end(); ++it )
+  {
+    write_value(out, it->m_address);
+    write_value(out, it->m_value);
+    write_string(out, it->m_name);
+    write_string(out, it->m_comment);
+  }
+
+  write_comments(out, m_plan.m_comments);
+  write_value(out, static_cast<uint32_t>(m_plan.m_program_comments.size()));
+  for ( auto it = m_plan.m_program_comments.begin(); it != m_plan.m_program_comments.end(); ++it )
+    write_string(out, *it);
+  write_comments(out, m_plan.m_entries);
+  write_comments(out, m_plan.m_names);
+  write_array(out, m_plan.m_functions);
+  write_array(out, m_plan.m_offsets);
+  write_value(out, m_plan.m_stats);
+
+  FILE *fp = qfopen(path, "wb");
+  if ( fp == nullptr )
+    return err_msg("REL: Unable to write the plan cache %s", path);
+
+  bool ok = qfwrite(fp, out.data(), out.size()) == static_cast<ssize_t>(out.size());
+  qfclose(fp);
+  if ( !ok )
+    return err_msg("REL: Failed to write the plan cache %s", path);
+  return true;
+}
@@ -0,0 +1,39 @@
+#ifndef __REL_CACHE_H__
+#define __REL_CACHE_H__
+
+#include "rel.h"
+#include "rel_plan.h"
+#include <string>
+#include <vector>
+
+#define CACHE_FORMAT   "rel_plan_%u.bin"    // by module id, next to the database
+#define CACHE_MAGIC    0x4E4C5052           // "RPLN"
+#define CACHE_VERSION  4
+
+// Something a plan was computed from: a sibling module (by content) or a
+// linker map (by size and modification time)
+struct rel_cache_dependency
+{
+  std::string m_name;
+  uint64_t m_hash;          // 0 if it didn't exist
+};
+
+// The resolved load of a module, saved as a binary sidecar so re-opening
+// the same module against the same siblings skips decoding, relocating
+// and sibling parsing altogether.
+class rel_plan_cache
+{
+public:
+  rel_plan_cache();
+
+  bool load(char const *path);
+  bool save(char const *path) const;
+
+  uint64_t m_module_hash;
+  std::vector<rel_cache_dependency> m_dependencies;
+  std::vector<uint32_t> m_section_addresses;    // by section, SECTION_IMPORTS included
+  uint32_t m_extern_end;
+  rel_load_plan m_plan;
+};
+
+#endif // #ifndef __REL_CACHE_H__
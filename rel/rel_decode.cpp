@@ -0,0 +1,326 @@
+#include "rel_decode.h"
+
+// SSE2 is always there on x64 and with 32-bit builds that ask for it. The
+// AVX2 functions are built alongside and picked when the CPU has AVX2.
+#if defined(__x86_64__) || defined(_M_X64) || \
+    (defined(__i386__) && defined(__SSE2__)) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define REL_DECODE_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+static inline unsigned lowest_bit(unsigned mask)
+{
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<unsigned>(index);
+}
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+static inline unsigned lowest_bit(unsigned mask)
+{
+  return static_cast<unsigned>(__builtin_ctz(mask));
+}
+#endif
+
+#define RECORD_SIZE 8
+
+void rel_stream::clear()
+{
+  m_where.clear();
+  m_addend.clear();
+  m_type.clear();
+  m_section.clear();
+  m_site.clear();
+}
+
+uint32_t rel_patch_width(uint8_t type)
+{
+  switch (type)
+  {
+  case R_PPC_ADDR32:
+  case R_PPC_ADDR24:
+  case R_PPC_ADDR14:
+  case R_PPC_ADDR14_BRTAKEN:
+  case R_PPC_ADDR14_BRNTAKEN:
+  case R_PPC_REL24:
+  case R_PPC_REL14:
+    return 4;
+  case R_PPC_ADDR16:
+  case R_PPC_ADDR16_LO:
+  case R_PPC_ADDR16_HI:
+  case R_PPC_ADDR16_HA:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+#ifdef REL_DECODE_SIMD
+static bool cpu_has_avx2()
+{
+#ifdef _MSC_VER
+  // AVX enabled by the OS (OSXSAVE, and XMM and YMM state in XCR0), then AVX2
+  int info[4];
+  __cpuid(info, 0);
+  if ( info[0] < 7 )
+    return false;
+  __cpuid(info, 1);
+  if ( (info[2] & 0x18000000) != 0x18000000 || (_xgetbv(0) & 6) != 6 )
+    return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & 0x20) != 0;
+#else
+  // Also runs from a static initializer, ahead of libgcc's own
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+static rel_decode_path g_path = cpu_has_avx2() ? REL_DECODE_AVX2 : REL_DECODE_SSE2;
+#else
+static rel_decode_path g_path = REL_DECODE_SCALAR;
+#endif
+
+bool rel_decode_path_supported(rel_decode_path path)
+{
+  switch (path)
+  {
+  case REL_DECODE_SCALAR:
+    return true;
+#ifdef REL_DECODE_SIMD
+  case REL_DECODE_SSE2:
+    return true;
+  case REL_DECODE_AVX2:
+    return cpu_has_avx2();
+#endif
+  default:
+    return false;
+  }
+}
+
+bool rel_decode_set_path(rel_decode_path path)
+{
+  if ( !rel_decode_path_supported(path) )
+    return false;
+  g_path = path;
+  return true;
+}
+
+rel_decode_path rel_decode_get_path()
+{
+  return g_path;
+}
+
+// Index of the first R_DOLPHIN_END record from record i on, or count if
+// none
+static size_t find_terminator_scalar(uint8_t const *data, size_t i, size_t count)
+{
+  for ( ; i < count; ++i )
+  {
+    if ( data[i*RECORD_SIZE + 2] == R_DOLPHIN_END )
+      return i;
+  }
+  return count;
+}
+
+// Byte swaps records [i, count) into heads (offset | type << 16 | section
+// << 24) and addends
+static void swap_records_scalar(uint8_t const *data, size_t i, size_t count, uint32_t *heads, uint32_t *addends)
+{
+  for ( ; i < count; ++i )
+  {
+    uint8_t const *p = data + i*RECORD_SIZE;
+    heads[i]   = read_be16(p) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    addends[i] = read_be32(p + 4);
+  }
+}
+
+#ifdef REL_DECODE_SIMD
+TARGET_AVX2
+static size_t find_terminator_avx2(uint8_t const *data, size_t count)
+{
+  size_t i = 0;
+  __m256i const end = _mm256_set1_epi8(static_cast<char>(R_DOLPHIN_END));
+  for ( ; i + 4 <= count; i += 4 )
+  {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data + i*RECORD_SIZE));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, end))) & 0x04040404u;
+    if ( mask != 0 )
+      return i + lowest_bit(mask) / RECORD_SIZE;
+  }
+  return find_terminator_scalar(data, i, count);
+}
+
+static size_t find_terminator_sse2(uint8_t const *data, size_t count)
+{
+  size_t i = 0;
+  __m128i const end = _mm_set1_epi8(static_cast<char>(R_DOLPHIN_END));
+  for ( ; i + 2 <= count; i += 2 )
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + i*RECORD_SIZE));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, end))) & 0x0404u;
+    if ( mask != 0 )
+      return i + lowest_bit(mask) / RECORD_SIZE;
+  }
+  return find_terminator_scalar(data, i, count);
+}
+
+TARGET_AVX2
+static void swap_records_avx2(uint8_t const *data, size_t count, uint32_t *heads, uint32_t *addends)
+{
+  size_t i = 0;
+  __m256i const shuffle = _mm256_setr_epi8(1, 0, 2, 3, 7, 6, 5, 4, 9, 8, 10, 11, 15, 14, 13, 12,
+                                           1, 0, 2, 3, 7, 6, 5, 4, 9, 8, 10, 11, 15, 14, 13, 12);
+  __m256i const split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  for ( ; i + 4 <= count; i += 4 )
+  {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data + i*RECORD_SIZE));
+    v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuffle), split);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(heads + i), _mm256_castsi256_si128(v));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(addends + i), _mm256_extracti128_si256(v, 1));
+  }
+  swap_records_scalar(data, i, count, heads, addends);
+}
+
+static void swap_records_sse2(uint8_t const *data, size_t count, uint32_t *heads, uint32_t *addends)
+{
+  size_t i = 0;
+  __m128i const keep_swapped  = _mm_setr_epi32(0x0000FFFF, -1, 0x0000FFFF, -1);
+  __m128i const keep_original = _mm_setr_epi32(static_cast<int>(0xFFFF0000), 0, static_cast<int>(0xFFFF0000), 0);
+  for ( ; i + 4 <= count; i += 4 )
+  {
+    __m128i r[2];
+    for ( int k = 0; k < 2; ++k )
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + (i + 2*k)*RECORD_SIZE));
+      // Swap the bytes of every halfword, then the halfwords of the addends
+      __m128i t = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+      t = _mm_shufflehi_epi16(_mm_shufflelo_epi16(t, _MM_SHUFFLE(2, 3, 1, 0)), _MM_SHUFFLE(2, 3, 1, 0));
+      // Type and section are single bytes and keep their original order
+      r[k] = _mm_or_si128(_mm_and_si128(t, keep_swapped), _mm_and_si128(v, keep_original));
+    }
+    __m128 a = _mm_castsi128_ps(r[0]);
+    __m128 b = _mm_castsi128_ps(r[1]);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(heads + i),   _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(addends + i), _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+  }
+  swap_records_scalar(data, i, count, heads, addends);
+}
+#endif
+
+// Returns the index of the first R_DOLPHIN_END record, or count if none
+static size_t find_terminator(uint8_t const *data, size_t count)
+{
+  switch (g_path)
+  {
+#ifdef REL_DECODE_SIMD
+  case REL_DECODE_AVX2:
+    return find_terminator_avx2(data, count);
+  case REL_DECODE_SSE2:
+    return find_terminator_sse2(data, count);
+#endif
+  default:
+    return find_terminator_scalar(data, 0, count);
+  }
+}
+
+// Byte swaps count records into heads (offset | type << 16 | section << 24)
+// and addends
+static void swap_records(uint8_t const *data, size_t count, uint32_t *heads, uint32_t *addends)
+{
+  switch (g_path)
+  {
+#ifdef REL_DECODE_SIMD
+  case REL_DECODE_AVX2:
+    swap_records_avx2(data, count, heads, addends);
+    break;
+  case REL_DECODE_SSE2:
+    swap_records_sse2(data, count, heads, addends);
+    break;
+#endif
+  default:
+    swap_records_scalar(data, 0, count, heads, addends);
+    break;
+  }
+}
+
+rel_decode_result rel_decode_stream(uint8_t const *data, size_t size,
+                                    uint32_t const *section_sizes, size_t num_sections,
+                                    rel_stream &out)
+{
+  rel_decode_result result = { REL_DECODE_OK, 0, 0 };
+
+  size_t available = size / RECORD_SIZE;
+  size_t count = find_terminator(data, available);
+  if ( count == available )
+  {
+    result.m_status = REL_DECODE_UNTERMINATED;
+    result.m_record = static_cast<uint32_t>(count);
+    return result;
+  }
+  result.m_consumed = static_cast<uint32_t>((count + 1) * RECORD_SIZE);
+
+  std::vector<uint32_t> heads(count), addends(count);
+  if ( count != 0 )
+    swap_records(data, count, heads.data(), addends.data());
+
+  // Track the running site and validate it against the section sizes
+  uint8_t current_section = 0;
+  uint32_t current_offset = 0;
+  for ( size_t i = 0; i < count; ++i )
+  {
+    uint32_t head = heads[i];
+    uint8_t type = static_cast<uint8_t>(head >> 16);
+    uint8_t section = static_cast<uint8_t>(head >> 24);
+
+    current_offset += head & 0xFFFF;
+    switch (type)
+    {
+    case R_DOLPHIN_SECTION:
+      if ( section >= num_sections )
+      {
+        result.m_status = REL_DECODE_BAD_SECTION;
+        result.m_record = static_cast<uint32_t>(i);
+        return result;
+      }
+      current_section = section;
+      current_offset  = 0;
+      break;
+    case R_DOLPHIN_NOP:
+      break;
+    default:
+      if ( current_section >= num_sections ||
+           static_cast<uint64_t>(current_offset) + rel_patch_width(type) > section_sizes[current_section] )
+      {
+        result.m_status = REL_DECODE_OUT_OF_BOUNDS;
+        result.m_record = static_cast<uint32_t>(i);
+        return result;
+      }
+      out.m_where.push_back(current_offset);
+      out.m_addend.push_back(addends[i]);
+      out.m_type.push_back(type);
+      out.m_section.push_back(section);
+      out.m_site.push_back(current_section);
+    }
+  }
+  return result;
+}
+
+size_t rel_scan_stream(uint8_t const *data, size_t size, uint32_t &sections)
+{
+  sections = 0;
+  size_t available = size / RECORD_SIZE;
+  size_t count = find_terminator(data, available);
+  if ( count == available )
+    return 0;
+
+  for ( size_t i = 0; i < count; ++i )
+  {
+    if ( data[i*RECORD_SIZE + 2] == R_DOLPHIN_SECTION )
+      sections |= 1u << (data[i*RECORD_SIZE + 3] & 31);
+  }
+  return (count + 1) * RECORD_SIZE;
+}
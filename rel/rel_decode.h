@@ -0,0 +1,71 @@
+#ifndef __REL_DECODE_H__
+#define __REL_DECODE_H__
+
+#include "rel_format.h"
+#include <cstddef>
+#include <vector>
+
+// Relocations decoded into parallel arrays. Section switches, nops and
+// terminators are folded away, so every element is an operation with the
+// absolute offset of its site.
+struct rel_stream
+{
+  std::vector<uint32_t> m_where;    // offset of the site within its section
+  std::vector<uint32_t> m_addend;
+  std::vector<uint8_t>  m_type;
+  std::vector<uint8_t>  m_section;  // section of the target
+  std::vector<uint8_t>  m_site;     // section being patched
+
+  size_t size() const { return m_type.size(); }
+  void clear();
+};
+
+enum rel_decode_status
+{
+  REL_DECODE_OK,
+  REL_DECODE_UNTERMINATED,  // no R_DOLPHIN_END before the end of the data
+  REL_DECODE_BAD_SECTION,   // switched to a section that doesn't exist
+  REL_DECODE_OUT_OF_BOUNDS, // patch site runs past the end of its section
+};
+
+struct rel_decode_result
+{
+  rel_decode_status m_status;
+  uint32_t m_consumed;      // bytes consumed, including the terminator
+  uint32_t m_record;        // index of the offending record on failure
+};
+
+// Implementations of the terminator search and the byte swap of records.
+// The best one the CPU supports is used unless another one is forced.
+enum rel_decode_path
+{
+  REL_DECODE_SCALAR,
+  REL_DECODE_SSE2,
+  REL_DECODE_AVX2,
+};
+
+// True if the path is built in and the CPU supports it
+bool rel_decode_path_supported(rel_decode_path path);
+
+// Forces a path, for comparing them in tests. Keeps the current one and
+// returns false if the path isn't supported. Not thread safe.
+bool rel_decode_set_path(rel_decode_path path);
+rel_decode_path rel_decode_get_path();
+
+// Number of bytes a relocation type patches
+uint32_t rel_patch_width(uint8_t type);
+
+// Decodes the relocation records at data up to the first R_DOLPHIN_END,
+// appending them to out. Sites are checked against section_sizes, the
+// sizes of the sections of the module being patched.
+rel_decode_result rel_decode_stream(uint8_t const *data, size_t size,
+                                    uint32_t const *section_sizes, size_t num_sections,
+                                    rel_stream &out);
+
+// Finds the end of the relocation records at data without decoding them,
+// for telling whether they changed. Bit n of sections is set for every
+// switch to section n (folded into 32). Returns the size of the records
+// including the R_DOLPHIN_END one, 0 if they are not terminated.
+size_t rel_scan_stream(uint8_t const *data, size_t size, uint32_t &sections);
+
+#endif // #ifndef __REL_DECODE_H__
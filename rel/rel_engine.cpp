@@ -0,0 +1,176 @@
+#include "rel_engine.h"
+#include <cstring>
+
+void rel_engine_reset(rel_engine_stats &stats)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+// Replaces the bits of original selected by mask
+static inline uint32_t insert_bits(uint32_t original, uint32_t value, uint32_t mask)
+{
+  return (original & ~mask) | (value & mask);
+}
+
+rel_engine_status rel_compute_patch(uint8_t type, uint32_t where, uint32_t target, uint32_t original, rel_patch &out)
+{
+  out.m_address  = where;
+  out.m_original = original;
+  out.m_width    = static_cast<uint8_t>(rel_patch_width(type));
+
+  switch (type)
+  {
+  case R_PPC_NONE:
+  case R_DOLPHIN_MRKREF:
+    return REL_ENGINE_SKIPPED;
+  case R_PPC_ADDR32:
+    out.m_value = target;
+    break;
+  // Absolute branch targets are sign extended from 26 bits, and from 16
+  // for the conditional forms below
+  case R_PPC_ADDR24:
+    if (((target + 0x02000000) & 0xFC000000) != 0)
+      return REL_ENGINE_OUT_OF_RANGE;
+    out.m_value = insert_bits(original, target, 0x03FFFFFC);
+    break;
+  // A whole address in a halfword, either signed or unsigned
+  case R_PPC_ADDR16:
+    if (target > 0xFFFF && target < 0xFFFF8000)
+      return REL_ENGINE_OUT_OF_RANGE;
+    out.m_value = target & 0xFFFF;
+    break;
+  case R_PPC_ADDR16_LO:
+    out.m_value = target & 0xFFFF;
+    break;
+  case R_PPC_ADDR16_HI:
+    out.m_value = target >> 16;
+    break;
+  case R_PPC_ADDR16_HA:
+    out.m_value = ((target + 0x8000) >> 16) & 0xFFFF;
+    break;
+  // Like OSLink, the branch prediction hint of the BRTAKEN/BRNTAKEN
+  // forms is left as assembled
+  case R_PPC_ADDR14:
+  case R_PPC_ADDR14_BRTAKEN:
+  case R_PPC_ADDR14_BRNTAKEN:
+    if (((target + 0x8000) & 0xFFFF0000) != 0)
+      return REL_ENGINE_OUT_OF_RANGE;
+    out.m_value = insert_bits(original, target, 0x0000FFFC);
+    break;
+  // Displacements are signed, 26 and 16 bits including the low two
+  case R_PPC_REL24:
+    if (((target - where + 0x02000000) & 0xFC000000) != 0)
+      return REL_ENGINE_OUT_OF_RANGE;
+    out.m_value = insert_bits(original, target - where, 0x03FFFFFC);
+    break;
+  case R_PPC_REL14:
+    if (((target - where + 0x8000) & 0xFFFF0000) != 0)
+      return REL_ENGINE_OUT_OF_RANGE;
+    out.m_value = insert_bits(original, target - where, 0x0000FFFC);
+    break;
+  default:
+    return REL_ENGINE_UNSUPPORTED;
+  }
+  return REL_ENGINE_OK;
+}
+
+bool rel_is_reference(uint8_t type)
+{
+  switch (type)
+  {
+  case R_PPC_ADDR32:
+  case R_PPC_ADDR16_LO:
+  case R_PPC_ADDR16_HI:
+  case R_PPC_ADDR16_HA:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool rel_type_supported(uint8_t type)
+{
+  rel_patch patch;
+  return rel_compute_patch(type, 0, 0, 0, patch) != REL_ENGINE_UNSUPPORTED;
+}
+
+bool rel_relocate(rel_stream const &stream,
+                  rel_section_image const *sites, size_t num_sites,
+                  rel_section_image const *targets, size_t num_targets,
+                  uint32_t const *resolved,
+                  std::vector<rel_patch> &out, rel_engine_stats &stats,
+                  std::vector<rel_reference> *references)
+{
+  bool ok = true;
+  out.reserve(out.size() + stream.size());
+
+  for (size_t i = 0; i < stream.size(); ++i)
+  {
+    uint8_t type = stream.m_type[i];
+    uint8_t site = stream.m_site[i];
+    uint32_t offset = stream.m_where[i];
+    uint32_t width = rel_patch_width(type);
+    ++stats.m_per_type[type];
+
+    // Resolve S + A
+    uint32_t target;
+    if (resolved != nullptr)
+    {
+      target = resolved[i];
+    }
+    else
+    {
+      uint8_t section = stream.m_section[i];
+      if (section >= num_targets || targets[section].m_base == 0)
+      {
+        ++stats.m_failed;
+        ok = false;
+        continue;
+      }
+      target = targets[section].m_base + stream.m_addend[i];
+    }
+
+    // Fetch the current contents of the site
+    uint32_t original = 0;
+    if (width != 0)
+    {
+      if (site >= num_sites || sites[site].m_data == nullptr ||
+          static_cast<uint64_t>(offset) + width > sites[site].m_size)
+      {
+        ++stats.m_failed;
+        ok = false;
+        continue;
+      }
+
+      uint8_t const *p = sites[site].m_data + offset;
+      original = width == 4 ? read_be32(p) : read_be16(p);
+    }
+
+    rel_patch patch;
+    uint32_t where = site < num_sites ? sites[site].m_base + offset : offset;
+    switch (rel_compute_patch(type, where, target, original, patch))
+    {
+    case REL_ENGINE_OK:
+      patch.m_offset  = offset;
+      patch.m_section = site;
+      out.push_back(patch);
+      ++stats.m_patches;
+      if (references != nullptr && rel_is_reference(type))
+      {
+        rel_reference reference = { where, target, offset, site, type };
+        references->push_back(reference);
+      }
+      break;
+    case REL_ENGINE_UNSUPPORTED:
+      ++stats.m_unsupported;
+      break;
+    case REL_ENGINE_OUT_OF_RANGE:
+      ++stats.m_failed;
+      ok = false;
+      break;
+    default:
+      break;
+    }
+  }
+  return ok;
+}
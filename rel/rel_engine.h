@@ -0,0 +1,84 @@
+#ifndef __REL_ENGINE_H__
+#define __REL_ENGINE_H__
+
+#include "rel_format.h"
+#include "rel_decode.h"
+#include <vector>
+
+// Relocation math, independent of the IDA SDK. The engine turns decoded
+// relocations into a list of patches; writing them is up to the caller.
+
+// A single write produced by the engine
+struct rel_patch
+{
+  uint32_t m_address;   // virtual address of the site
+  uint32_t m_offset;    // offset of the site within its section
+  uint8_t  m_section;   // section being patched
+  uint8_t  m_width;     // 2 or 4 bytes
+  uint32_t m_value;     // new contents
+  uint32_t m_original;  // contents before relocating
+};
+
+// A relocation building an address (ADDR32 and the ADDR16 halves), for
+// turning its site into an offset
+struct rel_reference
+{
+  uint32_t m_address;   // virtual address of the site
+  uint32_t m_target;    // S + A
+  uint32_t m_offset;    // offset of the site within its section
+  uint8_t  m_section;   // section of the site
+  uint8_t  m_type;
+};
+
+// A loaded section of a module
+struct rel_section_image
+{
+  uint32_t m_base;          // virtual address, 0 if the section isn't loaded
+  uint32_t m_size;
+  uint8_t const *m_data;    // contents before relocating, nullptr for bss
+};
+
+enum rel_engine_status
+{
+  REL_ENGINE_OK,
+  REL_ENGINE_SKIPPED,       // type doesn't patch anything (NONE, MRKREF)
+  REL_ENGINE_UNSUPPORTED,   // unknown type
+  REL_ENGINE_NO_DATA,       // site isn't backed by section data
+  REL_ENGINE_BAD_TARGET,    // target section doesn't exist or isn't loaded
+  REL_ENGINE_OUT_OF_RANGE,  // branch displacement or address doesn't fit its field
+};
+
+struct rel_engine_stats
+{
+  uint32_t m_per_type[256]; // relocations seen, by type
+  uint32_t m_patches;
+  uint32_t m_unsupported;
+  uint32_t m_failed;        // missing site data or target section, or out of range
+};
+
+void rel_engine_reset(rel_engine_stats &stats);
+
+// Checks whether the engine knows how to apply a relocation type
+bool rel_type_supported(uint8_t type);
+
+// Checks whether a relocation type builds an address rel_relocate reports
+bool rel_is_reference(uint8_t type);
+
+// Computes the patch of a single relocation. where is the address of the
+// site, target the resolved S + A and original the current contents of
+// the site (the low halfword for 16-bit types).
+rel_engine_status rel_compute_patch(uint8_t type, uint32_t where, uint32_t target, uint32_t original, rel_patch &out);
+
+// Relocates a decoded stream. sites describes the sections of the module
+// being patched. The target of entry i is resolved[i] if resolved is
+// given (imports), otherwise the base of targets[section] plus the addend
+// (self relocations). Patches are appended to out, and the relocations
+// building addresses to references if given.
+bool rel_relocate(rel_stream const &stream,
+                  rel_section_image const *sites, size_t num_sites,
+                  rel_section_image const *targets, size_t num_targets,
+                  uint32_t const *resolved,
+                  std::vector<rel_patch> &out, rel_engine_stats &stats,
+                  std::vector<rel_reference> *references = nullptr);
+
+#endif // #ifndef __REL_ENGINE_H__
@@ -0,0 +1,261 @@
+/*
+*  IDA Nintendo GameCube RSO Loader Module
+*  (C) Copyright 2010 Stephen Simpson
+*
+*  On-disk structures of the module formats. This header is independent
+*  of the IDA SDK.
+*
+*/
+
+#ifndef __REL_FORMAT_H__
+#define __REL_FORMAT_H__
+
+#include <cstddef>
+#include <cstdint>
+
+
+typedef struct {
+  void * head;
+  void * tail;
+} queue_t;
+
+typedef struct {
+  void * next;
+  void * prev;
+} link_t;
+
+typedef struct {
+  uint32_t align;
+  uint32_t bssAlign;
+} module_v2;
+
+typedef struct {
+  uint32_t fixSize;
+} module_v3;
+
+typedef struct {
+  uint32_t id;          // only in .rel
+
+  // in .rso or .rel or .sel
+  uint32_t prev;
+  uint32_t next;
+  uint32_t num_sections;
+  uint32_t section_offset;    // points to section_entry*
+  uint32_t name_offset;
+  uint32_t name_size;
+  uint32_t version;
+} relhdr_info;
+
+typedef struct {
+  relhdr_info info;
+
+  // version 1
+  uint32_t bss_size;
+  uint32_t rel_offset;
+  uint32_t import_offset;
+  uint32_t import_size;         // size in bytes
+
+  // Section ids containing functions
+  uint8_t prolog_section;
+  uint8_t epilog_section;
+  uint8_t unresolved_section;
+  uint8_t bss_section;
+
+  uint32_t prolog_offset;
+  uint32_t epilog_offset;
+  uint32_t unresolved_offset;
+
+  // version 2
+  uint32_t align;
+  uint32_t bss_align;
+
+  // version 3
+  uint32_t fix_size;
+} relhdr;
+
+
+typedef struct {
+  uint32_t file_offset;
+  uint32_t size;
+} section_entry;
+
+typedef struct {
+  uint32_t id;      // module id, maps to id in relhdr_info, 0 = base application
+  uint32_t offset;
+} import_entry;
+
+#define SECTION_EXEC 0x1
+#define SECTION_OFF(off) (off&~1)
+
+typedef struct {
+  uint16_t offset; // byte offset from previous entry
+  uint8_t  type;
+  uint8_t  section;
+  uint32_t addend;
+} rel_entry;
+
+
+// Modules of the Wii dynamic linker: .rso modules and the .sel of the
+// main program. The header starts like relhdr_info without the id and
+// is followed by ELF style relocation and symbol tables. Relocation sites
+// are offsets from the start of the module, which is loaded as a whole.
+typedef struct {
+  uint32_t next;
+  uint32_t prev;
+  uint32_t num_sections;
+  uint32_t section_offset;    // points to section_entry*
+  uint32_t name_offset;
+  uint32_t name_size;
+  uint32_t version;
+  uint32_t bss_size;
+
+  uint8_t prolog_section;
+  uint8_t epilog_section;
+  uint8_t unresolved_section;
+  uint8_t bss_section;
+
+  uint32_t prolog_offset;
+  uint32_t epilog_offset;
+  uint32_t unresolved_offset;
+
+  uint32_t internal_offset;   // rso_relocation*, against the module itself
+  uint32_t internal_size;     // size in bytes
+  uint32_t external_offset;   // rso_relocation*, against imports
+  uint32_t external_size;
+
+  uint32_t export_offset;     // rso_export*
+  uint32_t export_size;
+  uint32_t export_names;      // string table of the exports
+  uint32_t import_offset;     // rso_import*
+  uint32_t import_size;
+  uint32_t import_names;
+} rsohdr;
+
+typedef struct {
+  uint32_t offset;      // of the site from the start of the module
+  uint32_t info;        // symbol << 8 | type
+  uint32_t addend;
+} rso_relocation;
+
+#define RSO_SYMBOL(info) ((info) >> 8)    // section, or import for externals
+#define RSO_TYPE(info)   (static_cast<uint8_t>(info))
+
+typedef struct {
+  uint32_t name_offset; // in the export string table
+  uint32_t offset;      // within the section, the address in a .sel
+  uint32_t section;
+  uint32_t hash;        // ELF hash of the name
+} rso_export;
+
+typedef struct {
+  uint32_t name_offset; // in the import string table
+  uint32_t offset;      // filled in by the linker
+  uint32_t relocation;  // offset of its first external relocation
+} rso_import;
+
+#define RSO_MAX_SECTIONS 64
+
+#define R_PPC_NONE            0
+#define R_PPC_ADDR32          1     /* S + A */
+#define R_PPC_ADDR24          2     /* (S + A) >> 2 */
+#define R_PPC_ADDR16          3     /* S + A */
+#define R_PPC_ADDR16_LO       4
+#define R_PPC_ADDR16_HI       5
+#define R_PPC_ADDR16_HA       6
+#define R_PPC_ADDR14          7
+#define R_PPC_ADDR14_BRTAKEN  8
+#define R_PPC_ADDR14_BRNTAKEN 9
+#define R_PPC_REL24           10   /* (S + A - P) >> 2 */
+#define R_PPC_REL14           11
+
+#define R_DOLPHIN_NOP     201 // C9h current offset += rel.offset
+#define R_DOLPHIN_SECTION 202 // CAh current offset = rel.section
+#define R_DOLPHIN_END     203 // CBh
+#define R_DOLPHIN_MRKREF  204 // CCh
+
+
+// Big endian accessors for records walked in place
+inline uint16_t read_be16(uint8_t const *p)
+{
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline uint32_t read_be32(uint8_t const *p)
+{
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8)  |  static_cast<uint32_t>(p[3]);
+}
+
+inline void write_be16(uint8_t *p, uint16_t value)
+{
+  p[0] = static_cast<uint8_t>(value >> 8);
+  p[1] = static_cast<uint8_t>(value);
+}
+
+inline void write_be32(uint8_t *p, uint32_t value)
+{
+  p[0] = static_cast<uint8_t>(value >> 24);
+  p[1] = static_cast<uint8_t>(value >> 16);
+  p[2] = static_cast<uint8_t>(value >> 8);
+  p[3] = static_cast<uint8_t>(value);
+}
+
+// Cheap sanity check of a module header, needing nothing but the header
+// bytes and the size of the file. Mirrors rel_track::validate_header.
+inline bool rel_probe_header(uint8_t const *data, size_t size, uint64_t filesize)
+{
+  if ( size < sizeof(relhdr) )
+    return false;
+
+  uint32_t num_sections   = read_be32(data + offsetof(relhdr_info, num_sections));
+  uint32_t section_offset = read_be32(data + offsetof(relhdr_info, section_offset));
+  uint32_t version        = read_be32(data + offsetof(relhdr_info, version));
+
+  // Check for absurd amount of sections
+  if ( num_sections > 32 || num_sections <= 1 )
+    return false;
+
+  // Check section table boundary
+  if ( section_offset < sizeof(relhdr) ||
+       static_cast<uint64_t>(section_offset) + num_sections*sizeof(section_entry) > filesize )
+    return false;
+
+  // Check version
+  return version >= 1 && version <= 3;
+}
+
+// Same for the header of an RSO or SEL. Tables have to lie within the
+// file and hold whole entries.
+inline bool rso_probe_table(uint8_t const *data, size_t field, size_t entry, uint64_t filesize)
+{
+  uint32_t offset = read_be32(data + field);
+  uint32_t size   = read_be32(data + field + 4);
+  return size % entry == 0 && (size == 0 || (offset >= sizeof(rsohdr) && static_cast<uint64_t>(offset) + size <= filesize));
+}
+
+inline bool rso_probe_header(uint8_t const *data, size_t size, uint64_t filesize)
+{
+  if ( size < sizeof(rsohdr) )
+    return false;
+
+  uint32_t num_sections   = read_be32(data + offsetof(rsohdr, num_sections));
+  uint32_t section_offset = read_be32(data + offsetof(rsohdr, section_offset));
+  uint32_t name_offset    = read_be32(data + offsetof(rsohdr, name_offset));
+  uint32_t name_size      = read_be32(data + offsetof(rsohdr, name_size));
+  uint32_t version        = read_be32(data + offsetof(rsohdr, version));
+
+  if ( num_sections > RSO_MAX_SECTIONS || num_sections <= 1 || version != 1 )
+    return false;
+  if ( section_offset < sizeof(rsohdr) ||
+       static_cast<uint64_t>(section_offset) + num_sections*sizeof(section_entry) > filesize )
+    return false;
+  if ( static_cast<uint64_t>(name_offset) + name_size > filesize )
+    return false;
+
+  return rso_probe_table(data, offsetof(rsohdr, internal_offset), sizeof(rso_relocation), filesize) &&
+         rso_probe_table(data, offsetof(rsohdr, external_offset), sizeof(rso_relocation), filesize) &&
+         rso_probe_table(data, offsetof(rsohdr, export_offset), sizeof(rso_export), filesize) &&
+         rso_probe_table(data, offsetof(rsohdr, import_offset), sizeof(rso_import), filesize);
+}
+
+#endif // #ifndef __REL_FORMAT_H__
@@ -0,0 +1,171 @@
+#include "rel_gcm.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <utility>
+
+#define DOL_HEADER_SIZE   0x100
+#define DOL_NUM_SECTIONS  18      // 7 text and 11 data
+#define DOL_SIZES         0x90    // offsets are at the start of the header
+
+bool rel_gcm_probe(uint8_t const *header, size_t size)
+{
+  return size >= GCM_MAGIC_OFFSET + 4 && read_be32(header + GCM_MAGIC_OFFSET) == GCM_MAGIC;
+}
+
+rel_gcm::rel_gcm()
+{
+  m_main.m_path   = GCM_DOL_PATH;
+  m_main.m_offset = 0;
+  m_main.m_size   = 0;
+}
+
+bool rel_gcm::open(char const *path)
+{
+  m_files.clear();
+  m_main.m_offset = m_main.m_size = 0;
+
+  // Only the header and the FST are read, files stay where they are
+  if ( !m_image.open(path) )
+    return err_msg("GCM: Unable to open %s", path);
+
+  uint8_t const *header = m_image.data(0, GCM_HEADER_SIZE);
+  if ( header == nullptr || !rel_gcm_probe(header, GCM_HEADER_SIZE) )
+    return err_msg("GCM: %s is not a GameCube disc image", path);
+
+  if ( !this->read_main(read_be32(header + GCM_DOL_OFFSET)) )
+    return err_msg("GCM: main.dol of %s is out of the image", path);
+  if ( !this->read_fst(read_be32(header + GCM_FST_OFFSET), read_be32(header + GCM_FST_SIZE)) )
+    return err_msg("GCM: The file system table of %s is damaged", path);
+  return true;
+}
+
+bool rel_gcm::read_main(uint32_t offset)
+{
+  // The disc only knows where main.dol starts, its end is that of the
+  // last section
+  uint8_t const *header = m_image.data(offset, DOL_HEADER_SIZE);
+  if ( header == nullptr )
+    return false;
+
+  uint64_t size = DOL_HEADER_SIZE;
+  for ( uint32_t i = 0; i < DOL_NUM_SECTIONS; ++i )
+  {
+    uint32_t section_offset = read_be32(header + i*4);
+    uint32_t section_size   = read_be32(header + DOL_SIZES + i*4);
+    if ( section_offset != 0 )
+      size = std::max<uint64_t>(size, static_cast<uint64_t>(section_offset) + section_size);
+  }
+  if ( size > 0xFFFFFFFF || !m_image.contains(offset, static_cast<uint32_t>(size)) )
+    return false;
+
+  m_main.m_offset = offset;
+  m_main.m_size   = static_cast<uint32_t>(size);
+  return true;
+}
+
+bool rel_gcm::read_fst(uint32_t offset, uint32_t size)
+{
+  uint8_t const *fst = m_image.data(offset, size);
+  if ( fst == nullptr || size < GCM_FST_ENTRY_SIZE )
+    return false;
+
+  // The root's size is the number of entries, names follow them
+  uint32_t count = read_be32(fst + 8);
+  if ( count == 0 || count > size / GCM_FST_ENTRY_SIZE )
+    return false;
+  char const *names = reinterpret_cast<char const *>(fst) + count * GCM_FST_ENTRY_SIZE;
+  uint32_t names_size = size - count * GCM_FST_ENTRY_SIZE;
+
+  // Directories being walked, with the index after their last entry
+  std::vector<std::pair<uint32_t, std::string> > parents(1, std::make_pair(count, std::string()));
+  for ( uint32_t i = 1; i < count; ++i )
+  {
+    while ( parents.size() > 1 && i >= parents.back().first )
+      parents.pop_back();
+
+    uint8_t const *entry = fst + i * GCM_FST_ENTRY_SIZE;
+    uint32_t name = read_be32(entry) & 0x00FFFFFF;
+    if ( name >= names_size )
+      return false;
+    char const *end = static_cast<char const *>(memchr(names + name, 0, names_size - name));
+    if ( end == nullptr )
+      return false;
+    std::string path = parents.back().second + "/" + std::string(names + name, end);
+
+    if ( entry[0] & GCM_FST_DIRECTORY )
+    {
+      uint32_t next = read_be32(entry + 8);
+      if ( next <= i || next > parents.back().first )
+        return false;
+      parents.push_back(std::make_pair(next, path));
+      continue;
+    }
+
+    rel_gcm_file file;
+    file.m_path   = path;
+    file.m_offset = read_be32(entry + 4);
+    file.m_size   = read_be32(entry + 8);
+    if ( !m_image.contains(file.m_offset, file.m_size) )
+      return false;
+    m_files.push_back(file);
+  }
+
+  std::sort(m_files.begin(), m_files.end(), [](rel_gcm_file const &a, rel_gcm_file const &b)
+  {
+    return a.m_path < b.m_path;
+  });
+  return true;
+}
+
+static bool ends_with(std::string const &path, char const *suffix)
+{
+  size_t size = strlen(suffix);
+  if ( path.size() < size )
+    return false;
+  for ( size_t i = 0; i < size; ++i )
+  {
+    if ( tolower(static_cast<unsigned char>(path[path.size() - size + i])) != tolower(static_cast<unsigned char>(suffix[i])) )
+      return false;
+  }
+  return true;
+}
+
+std::vector<rel_gcm_file const *> rel_gcm::list(char const *suffix) const
+{
+  std::vector<rel_gcm_file const *> files;
+  for ( auto it = m_files.begin(); it != m_files.end(); ++it )
+  {
+    if ( ends_with(it->m_path, suffix) )
+      files.push_back(&*it);
+  }
+  return files;
+}
+
+rel_gcm_file const *rel_gcm::find(std::string const &path) const
+{
+  if ( path == m_main.m_path )
+    return &m_main;
+
+  auto it = std::lower_bound(m_files.begin(), m_files.end(), path, [](rel_gcm_file const &file, std::string const &key)
+  {
+    return file.m_path < key;
+  });
+  return it != m_files.end() && it->m_path == path ? &*it : nullptr;
+}
+
+rel_gcm_file const &rel_gcm::get_main() const
+{
+  return m_main;
+}
+
+uint8_t const *rel_gcm::data(rel_gcm_file const &file) const
+{
+  return m_image.data(file.m_offset, file.m_size);
+}
+
+linput_t *rel_gcm::open_linput(rel_gcm_file const &file) const
+{
+  uint8_t const *p = this->data(file);
+  return p != nullptr ? create_memory_linput(p, file.m_size) : nullptr;
+}
@@ -0,0 +1,58 @@
+#ifndef __REL_GCM_H__
+#define __REL_GCM_H__
+
+#include "rel_input.h"
+#include "../loader/gcm.h"
+#include <string>
+#include <vector>
+
+#define GCM_DOL_PATH "/main.dol"    // where main.dol is listed, it isn't in the FST
+
+// A file of a disc image
+struct rel_gcm_file
+{
+  std::string m_path;   // from the root, "/rels/d_a_npc.rel"
+  uint32_t m_offset;
+  uint32_t m_size;
+};
+
+// Checks the header of a GameCube disc image
+bool rel_gcm_probe(uint8_t const *header, size_t size);
+
+// A GameCube disc image, mapped into memory. The FST is walked once into
+// a path index, the files are then served straight from the mapping.
+class rel_gcm
+{
+public:
+  rel_gcm();
+
+  bool open(char const *path);
+
+  // Files whose names end in suffix (ignoring case), in path order
+  std::vector<rel_gcm_file const *> list(char const *suffix) const;
+
+  // File at a path from the root, nullptr if there is none
+  rel_gcm_file const *find(std::string const &path) const;
+
+  // main.dol, sized from its header
+  rel_gcm_file const &get_main() const;
+
+  // Contents of a file, within the mapping
+  uint8_t const *data(rel_gcm_file const &file) const;
+
+  // Input reading a file from the mapping, for code that needs one
+  linput_t *open_linput(rel_gcm_file const &file) const;
+
+private:
+  rel_gcm(rel_gcm const &);
+  rel_gcm &operator=(rel_gcm const &);
+
+  bool read_main(uint32_t offset);
+  bool read_fst(uint32_t offset, uint32_t size);
+
+  rel_input m_image;
+  rel_gcm_file m_main;
+  std::vector<rel_gcm_file> m_files;    // sorted by path
+};
+
+#endif // #ifndef __REL_GCM_H__
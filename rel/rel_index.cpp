@@ -0,0 +1,274 @@
+#include "rel_index.h"
+#include "rel_input.h"
+#include "rel_reload.h"
+#include "rel_yaz0.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+rel_index::rel_index(std::string const &directory)
+  : m_path(directory + "/" INDEX_FILENAME)
+  , m_dirty(false)
+{}
+
+template <typename T>
+static bool read_value(uint8_t const *&p, uint8_t const *end, T &value)
+{
+  if ( static_cast<size_t>(end - p) < sizeof(T) )
+    return false;
+  memcpy(&value, p, sizeof(T));
+  p += sizeof(T);
+  return true;
+}
+
+template <typename T>
+static void write_value(std::vector<uint8_t> &out, T const &value)
+{
+  uint8_t const *p = reinterpret_cast<uint8_t const *>(&value);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+bool rel_index::load()
+{
+  m_entries.clear();
+
+  FILE *fp = qfopen(m_path.c_str(), "rb");
+  if ( fp == nullptr )
+    return false;
+
+  // Pull the whole index in with a single read
+  std::vector<uint8_t> data;
+  uint8_t chunk[0x4000];
+  ssize_t n;
+  while ( (n = qfread(fp, chunk, sizeof(chunk))) > 0 )
+    data.insert(data.end(), chunk, chunk + n);
+  qfclose(fp);
+
+  uint8_t const *p = data.data();
+  uint8_t const *end = p + data.size();
+
+  uint32_t magic = 0, version = 0, count = 0;
+  if ( !read_value(p, end, magic) || !read_value(p, end, version) || !read_value(p, end, count) )
+    return false;
+  if ( magic != INDEX_MAGIC || version != INDEX_VERSION )
+    return err_msg("REL: Ignoring outdated module index %s", m_path.c_str());
+
+  for ( uint32_t i = 0; i < count; ++i )
+  {
+    uint16_t name_size = 0;
+    uint8_t valid = 0;
+    uint32_t num_sections = 0;
+    rel_index_entry entry;
+
+    if ( !read_value(p, end, name_size) || static_cast<size_t>(end - p) < name_size )
+      break;
+    std::string name(reinterpret_cast<char const *>(p), name_size);
+    p += name_size;
+
+    if ( !read_value(p, end, entry.m_size) || !read_value(p, end, entry.m_mtime) ||
+         !read_value(p, end, valid) || !read_value(p, end, entry.m_id) ||
+         !read_value(p, end, entry.m_hash) ||
+         !read_value(p, end, num_sections) ||
+         static_cast<size_t>(end - p) / sizeof(section_entry) < num_sections )
+      break;
+
+    entry.m_valid = valid != 0;
+    entry.m_sections.resize(num_sections);
+    if ( num_sections != 0 )
+      memcpy(entry.m_sections.data(), p, num_sections * sizeof(section_entry));
+    p += num_sections * sizeof(section_entry);
+
+    m_entries[name] = std::move(entry);
+  }
+
+  if ( m_entries.size() != count )
+  {
+    m_entries.clear();
+    return err_msg("REL: Module index %s is truncated", m_path.c_str());
+  }
+  return true;
+}
+
+bool rel_index::save()
+{
+  // Forget about files that have disappeared since the last load
+  for ( auto it = m_entries.begin(); it != m_entries.end(); )
+  {
+    if ( m_seen.find(it->first) == m_seen.end() )
+    {
+      it = m_entries.erase(it);
+      m_dirty = true;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  if ( !m_dirty )
+    return true;
+
+  std::vector<uint8_t> out;
+  write_value(out, static_cast<uint32_t>(INDEX_MAGIC));
+  write_value(out, static_cast<uint32_t>(INDEX_VERSION));
+  write_value(out, static_cast<uint32_t>(m_entries.size()));
+  for ( auto it = m_entries.begin(); it != m_entries.end(); ++it )
+  {
+    rel_index_entry const &entry = it->second;
+    write_value(out, static_cast<uint16_t>(it->first.size()));
+    out.insert(out.end(), it->first.begin(), it->first.end());
+    write_value(out, entry.m_size);
+    write_value(out, entry.m_mtime);
+    write_value(out, static_cast<uint8_t>(entry.m_valid));
+    write_value(out, entry.m_id);
+    write_value(out, entry.m_hash);
+    write_value(out, static_cast<uint32_t>(entry.m_sections.size()));
+    for ( auto s = entry.m_sections.begin(); s != entry.m_sections.end(); ++s )
+      write_value(out, *s);
+  }
+
+  FILE *fp = qfopen(m_path.c_str(), "wb");
+  if ( fp == nullptr )
+    return err_msg("REL: Unable to write module index %s", m_path.c_str());
+
+  bool ok = qfwrite(fp, out.data(), out.size()) == static_cast<ssize_t>(out.size());
+  qfclose(fp);
+  if ( !ok )
+    return err_msg("REL: Failed to write module index %s", m_path.c_str());
+
+  m_dirty = false;
+  return true;
+}
+
+void rel_index::refresh(std::vector<std::string> const &files)
+{
+  // Find the files that changed since they were indexed
+  std::vector<std::string const *> stale_files;
+  std::vector<rel_index_entry> stale_entries;
+  for ( auto it = files.begin(); it != files.end(); ++it )
+  {
+    uint64_t size;
+    int64_t mtime;
+    if ( !get_stamp(it->c_str(), size, mtime) )
+      continue;
+
+    std::string name(qbasename(it->c_str()));
+    m_seen.insert(name);
+
+    auto cached = m_entries.find(name);
+    if ( cached != m_entries.end() && cached->second.m_size == size && cached->second.m_mtime == mtime )
+      continue;
+
+    rel_index_entry entry;
+    entry.m_size  = size;
+    entry.m_mtime = mtime;
+    entry.m_valid = false;
+    entry.m_id    = 0;
+    entry.m_hash  = 0;
+    stale_files.push_back(&*it);
+    stale_entries.push_back(std::move(entry));
+  }
+
+  if ( stale_files.empty() )
+    return;
+
+  // Parse them on a pool of workers, each pulling the next file
+  std::atomic<size_t> next(0);
+  auto worker = [&]()
+  {
+    for ( size_t i = next++; i < stale_files.size(); i = next++ )
+      stale_entries[i].m_valid = parse_module(stale_files[i]->c_str(), stale_entries[i]);
+  };
+
+  size_t num_threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), stale_files.size());
+  std::vector<std::thread> threads;
+  for ( size_t i = 1; i < num_threads; ++i )
+    threads.emplace_back(worker);
+  worker();
+  for ( auto it = threads.begin(); it != threads.end(); ++it )
+    it->join();
+
+  // Merge the results in file order
+  for ( size_t i = 0; i < stale_files.size(); ++i )
+    m_entries[qbasename(stale_files[i]->c_str())] = std::move(stale_entries[i]);
+  m_dirty = true;
+}
+
+rel_index_entry const *rel_index::find(std::string const &file) const
+{
+  auto it = m_entries.find(qbasename(file.c_str()));
+  if ( it == m_entries.end() || m_seen.find(it->first) == m_seen.end() )
+    return nullptr;
+  return &it->second;
+}
+
+bool rel_index::get_stamp(char const *file, uint64_t &size, int64_t &mtime)
+{
+  struct stat st;
+  if ( stat(file, &st) != 0 )
+    return false;
+
+  size  = static_cast<uint64_t>(st.st_size);
+  mtime = static_cast<int64_t>(st.st_mtime);
+  return true;
+}
+
+bool rel_index::parse_module(char const *file, rel_index_entry &entry)
+{
+  entry.m_id = 0;
+  entry.m_hash = 0;
+  entry.m_sections.clear();
+
+  rel_input input;
+  if ( !input.open(file) )
+    return false;
+
+  // Plan caches are keyed by the contents of the modules they resolved against
+  uint32_t filesize = input.get_size();
+  entry.m_hash = rel_hash(input.data(0, filesize), filesize);
+
+  // Only the header and the section table of compressed modules are
+  // decoded, which usually sit in the first few hundred bytes
+  bool compressed = input.is_yaz0();
+  if ( compressed && !input.inflate(INDEX_YAZ0_PEEK) )
+    return false;
+  filesize = input.get_size();
+
+  // Same checks as rel_track, without reporting anything
+  uint8_t const *header = input.data(0, sizeof(relhdr));
+  if ( header == nullptr || !rel_probe_header(header, sizeof(relhdr), filesize) )
+    return false;
+
+  uint32_t num_sections   = read_be32(header + offsetof(relhdr_info, num_sections));
+  uint32_t section_offset = read_be32(header + offsetof(relhdr_info, section_offset));
+  uint32_t bss_size       = read_be32(header + offsetof(relhdr, bss_size));
+
+  uint32_t table_size = num_sections * sizeof(section_entry);
+  if ( compressed && !input.contains(section_offset, table_size) && !input.inflate(section_offset + table_size) )
+    return false;
+
+  uint8_t const *table = input.data(section_offset, table_size);
+  if ( table == nullptr )
+    return false;
+
+  entry.m_sections.resize(num_sections);
+  for ( uint32_t i = 0; i < num_sections; ++i )
+  {
+    section_entry &section = entry.m_sections[i];
+    section.file_offset = read_be32(table + i*sizeof(section_entry));
+    section.size        = read_be32(table + i*sizeof(section_entry) + 4);
+
+    uint32_t offset = SECTION_OFF(section.file_offset);
+    if ( section.file_offset == 0 && section.size != 0 && section.size != bss_size )
+      return false;
+    if ( offset != 0 && section.size != 0 &&
+         (offset < sizeof(relhdr) || static_cast<uint64_t>(offset) + section.size > filesize) )
+      return false;
+  }
+
+  entry.m_id = read_be32(header + offsetof(relhdr_info, id));
+  return true;
+}
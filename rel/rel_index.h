@@ -0,0 +1,56 @@
+#ifndef __REL_INDEX_H__
+#define __REL_INDEX_H__
+
+#include "rel.h"
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+
+#define INDEX_FILENAME "rel_modules.idx"
+#define INDEX_MAGIC    0x58444952   // "RIDX"
+#define INDEX_VERSION  2
+#define INDEX_YAZ0_PEEK 0x200       // bytes of a compressed module decoded up front
+
+// Cached header information of a module that sits next to the database
+struct rel_index_entry
+{
+  uint64_t m_size;    // file size at the time of parsing
+  int64_t  m_mtime;   // modification time at the time of parsing
+  bool     m_valid;   // false if the file did not parse as a REL
+  uint32_t m_id;
+  uint64_t m_hash;    // of the file contents, compressed or not
+  std::vector<section_entry> m_sections;
+};
+
+// Persistent index of sibling modules, stored as a small binary file in
+// the database directory. Entries are only re-parsed when the size or
+// modification time of their file changes.
+class rel_index
+{
+public:
+  rel_index(std::string const &directory);
+
+  bool load();
+  bool save();
+
+  // Re-parses the files whose stamp changed, spread over worker threads
+  void refresh(std::vector<std::string> const &files);
+
+  // Retrieves the entry of a file seen by the last refresh
+  rel_index_entry const *find(std::string const &file) const;
+
+  // Size and modification time of a file
+  static bool get_stamp(char const *file, uint64_t &size, int64_t &mtime);
+
+private:
+  // Thread safe, must not call into IDA
+  static bool parse_module(char const *file, rel_index_entry &entry);
+
+  std::string m_path;
+  std::map<std::string, rel_index_entry> m_entries;   // keyed by file name
+  std::set<std::string> m_seen;
+  bool m_dirty;
+};
+
+#endif // #ifndef __REL_INDEX_H__
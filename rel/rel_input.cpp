@@ -0,0 +1,273 @@
+#ifdef __NT__
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "rel_input.h"
+#include "rel_yaz0.h"
+#include "../loader/ldr_trace.h"
+#include <algorithm>
+
+rel_input::rel_input()
+  : m_data(nullptr)
+  , m_begin(0)
+  , m_end(0)
+  , m_filesize(0)
+  , m_source(nullptr)
+  , m_source_size(0)
+  , m_map(nullptr)
+  , m_map_size(0)
+#ifdef __NT__
+  , m_file_handle(INVALID_HANDLE_VALUE)
+  , m_map_handle(nullptr)
+#endif
+{}
+
+rel_input::~rel_input()
+{
+  this->close();
+}
+
+bool rel_input::open(char const *path)
+{
+  this->close();
+  if ( this->map_file(path) )
+    return true;
+
+  // Mapping failed (empty file, network share, ...), read it instead.
+  // Plain file functions keep this usable from worker threads.
+  FILE *fp = qfopen(path, "rb");
+  if ( fp == nullptr )
+    return false;
+
+  uint8_t chunk[0x4000];
+  ssize_t n;
+  while ( (n = qfread(fp, chunk, sizeof(chunk))) > 0 && m_buffer.size() + n <= 0xFFFFFFFF )
+    m_buffer.insert(m_buffer.end(), chunk, chunk + n);
+  qfclose(fp);
+
+  m_data  = m_buffer.data();
+  m_begin = 0;
+  m_end   = m_filesize = static_cast<uint32_t>(m_buffer.size());
+  return true;
+}
+
+bool rel_input::view(uint8_t const *data, uint32_t size)
+{
+  this->close();
+  if ( data == nullptr )
+    return false;
+
+  m_data  = data;
+  m_begin = 0;
+  m_end   = m_filesize = size;
+  return true;
+}
+
+bool rel_input::read(linput_t *p_input, uint32_t begin, uint32_t end)
+{
+  this->close();
+
+  int64 size = qlsize(p_input);
+  if ( size < 0 || size > 0xFFFFFFFF )
+    return false;
+  m_filesize = static_cast<uint32_t>(size);
+
+  if ( begin > end || end > m_filesize )
+    return false;
+
+  m_buffer.resize(end - begin);
+  qlseek(p_input, begin, SEEK_SET);
+  if ( !m_buffer.empty() && ldr_qlread(p_input, m_buffer.data(), m_buffer.size()) != static_cast<ssize_t>(m_buffer.size()) )
+  {
+    m_buffer.clear();
+    return false;
+  }
+
+  m_data  = m_buffer.data();
+  m_begin = begin;
+  m_end   = end;
+  return true;
+}
+
+void rel_input::close()
+{
+  this->unmap_file();
+  m_buffer.clear();
+  m_inflated.clear();
+  m_data = nullptr;
+  m_source = nullptr;
+  m_begin = m_end = m_filesize = m_source_size = 0;
+}
+
+bool rel_input::is_yaz0() const
+{
+  uint32_t size;
+  return m_source == nullptr && m_begin == 0 && m_end == m_filesize && rel_yaz0_probe(m_data, m_end, size);
+}
+
+bool rel_input::inflate(uint32_t limit)
+{
+  if ( m_source == nullptr )
+  {
+    if ( !this->is_yaz0() )
+      return false;
+    m_source = m_data;
+    m_source_size = m_end;
+  }
+
+  // A group of 25 bytes expands to at most 8 runs of 273, anything
+  // claiming more is not Yaz0 data
+  uint32_t size;
+  rel_yaz0_probe(m_source, m_source_size, size);
+  if ( size / 88 > m_source_size )
+  {
+    this->close();
+    return false;
+  }
+  uint32_t wanted = std::min(limit, size);
+
+  // Decode straight into the buffer the view is served from
+  m_inflated.resize(wanted);
+  size_t produced = rel_yaz0_decode(m_source + YAZ0_HEADER_SIZE, m_source_size - YAZ0_HEADER_SIZE, m_inflated.data(), wanted);
+  if ( produced != wanted )
+  {
+    this->close();
+    return false;
+  }
+
+  m_data     = m_inflated.data();
+  m_begin    = 0;
+  m_end      = wanted;
+  m_filesize = size;
+
+  // Nothing more to decode, drop the compressed file
+  if ( wanted == size )
+  {
+    this->unmap_file();
+    std::vector<uint8_t>().swap(m_buffer);
+    m_source = nullptr;
+    m_source_size = 0;
+  }
+  return true;
+}
+
+uint32_t rel_input::get_size() const
+{
+  return m_filesize;
+}
+
+bool rel_input::contains(uint32_t offset, uint32_t size) const
+{
+  return offset >= m_begin && offset <= m_end && size <= m_end - offset;
+}
+
+uint8_t const *rel_input::data(uint32_t offset, uint32_t size) const
+{
+  if ( !this->contains(offset, size) )
+    return nullptr;
+  return m_data + (offset - m_begin);
+}
+
+#ifdef __NT__
+
+bool rel_input::map_file(char const *path)
+{
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if ( file == INVALID_HANDLE_VALUE )
+    return false;
+
+  LARGE_INTEGER size;
+  if ( !GetFileSizeEx(file, &size) || size.QuadPart == 0 || size.QuadPart > 0xFFFFFFFF )
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if ( mapping == nullptr )
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if ( view == nullptr )
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  m_file_handle = file;
+  m_map_handle  = mapping;
+  m_map         = view;
+  m_map_size    = static_cast<size_t>(size.QuadPart);
+
+  m_data     = static_cast<uint8_t const *>(m_map);
+  m_begin    = 0;
+  m_end      = m_filesize = static_cast<uint32_t>(m_map_size);
+  return true;
+}
+
+void rel_input::unmap_file()
+{
+  if ( m_map != nullptr )
+    UnmapViewOfFile(m_map);
+  if ( m_map_handle != nullptr )
+    CloseHandle(m_map_handle);
+  if ( m_file_handle != INVALID_HANDLE_VALUE )
+    CloseHandle(m_file_handle);
+
+  m_map = nullptr;
+  m_map_size = 0;
+  m_map_handle = nullptr;
+  m_file_handle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool rel_input::map_file(char const *path)
+{
+  int fd = ::open(path, O_RDONLY);
+  if ( fd < 0 )
+    return false;
+
+  struct stat st;
+  if ( fstat(fd, &st) != 0 || st.st_size == 0 || st.st_size > 0xFFFFFFFF )
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if ( view == MAP_FAILED )
+    return false;
+
+  m_map      = view;
+  m_map_size = static_cast<size_t>(st.st_size);
+
+  m_data     = static_cast<uint8_t const *>(m_map);
+  m_begin    = 0;
+  m_end      = m_filesize = static_cast<uint32_t>(m_map_size);
+  return true;
+}
+
+void rel_input::unmap_file()
+{
+  if ( m_map != nullptr )
+    munmap(m_map, m_map_size);
+
+  m_map = nullptr;
+  m_map_size = 0;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef __REL_INPUT_H__
+#define __REL_INPUT_H__
+
+#include "rel.h"
+#include <vector>
+
+// Contiguous view of a module's bytes. The view is either the whole file
+// mapped into memory, or a single window of an IDA input pulled in with
+// one read so that records can be parsed without further I/O calls.
+// Yaz0 compressed files are viewed through their decompressed contents.
+class rel_input
+{
+public:
+  rel_input();
+  ~rel_input();
+
+  // Maps a file on disk, falling back to reading it whole
+  bool open(char const *path);
+
+  // Views memory that outlives the view, such as a file of a mapped disc
+  // image, as a whole file
+  bool view(uint8_t const *data, uint32_t size);
+
+  // Reads the window [begin, end) of an IDA input with a single read
+  bool read(linput_t *p_input, uint32_t begin, uint32_t end);
+
+  void close();
+
+  // True if the whole file is in view and starts with a Yaz0 header
+  bool is_yaz0() const;
+
+  // Replaces the view of a Yaz0 file by its decompressed contents, only
+  // decoding the first limit bytes. get_size becomes the decompressed
+  // size. A partial view can be widened by inflating again with a larger
+  // limit, the whole file releases the compressed data.
+  bool inflate(uint32_t limit = 0xFFFFFFFF);
+
+  // Size of the underlying file
+  uint32_t get_size() const;
+
+  // Checks that [offset, offset + size) lies within the current view
+  bool contains(uint32_t offset, uint32_t size) const;
+
+  // Pointer to a file offset, nullptr if the range isn't in view
+  uint8_t const *data(uint32_t offset, uint32_t size) const;
+
+private:
+  rel_input(rel_input const &);
+  rel_input &operator=(rel_input const &);
+
+  bool map_file(char const *path);
+  void unmap_file();
+
+  uint8_t const *m_data;    // first byte of the view
+  uint32_t m_begin;         // file offset of the view
+  uint32_t m_end;
+  uint32_t m_filesize;
+
+  std::vector<uint8_t> m_buffer;
+  std::vector<uint8_t> m_inflated;
+
+  uint8_t const *m_source;  // compressed file behind a partial inflate
+  uint32_t m_source_size;
+
+  void *m_map;              // start of the mapped file
+  size_t m_map_size;
+#ifdef __NT__
+  void *m_file_handle;
+  void *m_map_handle;
+#endif
+};
+
+#endif // #ifndef __REL_INPUT_H__
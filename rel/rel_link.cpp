@@ -0,0 +1,217 @@
+#include "rel_link.h"
+#include "rel_track.h"
+#include "rel_map.h"
+#include "rel_gcm.h"
+#include "../dol/dol_image.h"
+#include "../loader/ldr_trace.h"
+#include <algorithm>
+
+rel_link::rel_link(std::string const &directory, rel_gcm const *disc)
+  : m_directory(directory)
+  , m_disc(disc)
+  , m_entry_point(0)
+{}
+
+std::string const &rel_link::get_directory() const
+{
+  return m_directory;
+}
+
+uint32_t rel_link::get_entry_point() const
+{
+  return m_entry_point;
+}
+
+std::vector<rel_link_module> const &rel_link::get_modules() const
+{
+  return m_modules;
+}
+
+rel_link_module const *rel_link::find(uint32_t id) const
+{
+  auto it = m_by_id.find(id);
+  return it != m_by_id.end() ? &m_modules[it->second] : nullptr;
+}
+
+static int idaapi list_modules_cb(char const * file, void * ud)
+{
+  static_cast<std::vector<std::string> *>(ud)->push_back(file);
+  return 0;
+}
+
+std::vector<std::string> rel_link::list_modules(std::string const &directory)
+{
+  std::vector<std::string> files;
+  enumerate_files(nullptr, 0, directory.c_str(), "*.rel", &list_modules_cb, &files);
+  enumerate_files(nullptr, 0, directory.c_str(), YAZ0_PATTERN, &list_modules_cb, &files);
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+// One walk of the path index, wherever the modules are on the disc
+std::vector<std::string> rel_link::list_modules(rel_gcm const &disc)
+{
+  std::vector<std::string> files;
+  std::vector<rel_gcm_file const *> rels = disc.list(".rel");
+  std::vector<rel_gcm_file const *> szs = disc.list(YAZ0_EXTENSION);
+  for ( auto it = rels.begin(); it != rels.end(); ++it )
+    files.push_back((*it)->m_path);
+  for ( auto it = szs.begin(); it != szs.end(); ++it )
+    files.push_back((*it)->m_path);
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+size_t rel_link::count_modules(std::string const &directory)
+{
+  return list_modules(directory).size();
+}
+
+size_t rel_link::count_modules(rel_gcm const &disc)
+{
+  return list_modules(disc).size();
+}
+
+// Alignments are powers of two, anything else falls back to the default
+static uint32_t align_up(uint32_t value, uint32_t align)
+{
+  if ( align < LINK_ALIGN || (align & (align - 1)) != 0 )
+    align = LINK_ALIGN;
+  return (value + align - 1) & ~(align - 1);
+}
+
+void rel_link::layout(uint32_t start, std::vector<std::unique_ptr<rel_track> > &tracks)
+{
+  m_modules.clear();
+  m_by_id.clear();
+  tracks.clear();
+
+  uint32_t next = align_up(start, LINK_ALIGN);
+  std::vector<std::string> files = m_disc != nullptr ? list_modules(*m_disc) : list_modules(m_directory);
+  for ( auto it = files.begin(); it != files.end(); ++it )
+  {
+    // Modules on a disc are parsed in place in its mapping
+    std::unique_ptr<rel_track> track;
+    if ( m_disc != nullptr )
+    {
+      rel_gcm_file const *file = m_disc->find(*it);
+      track.reset(new rel_track(m_disc->data(*file), file->m_size));
+    }
+    else
+    {
+      track.reset(new rel_track(it->c_str()));
+    }
+    if ( !track->is_good() )
+    {
+      msg("REL: Skipping %s, it isn't a valid module\n", it->c_str());
+      continue;
+    }
+
+    // Ids are how modules refer to each other, 0 is the main program
+    uint32_t id = track->get_id();
+    if ( id == 0 || m_by_id.count(id) != 0 )
+    {
+      msg("REL: Skipping %s, module id %u is already taken\n", it->c_str(), id);
+      continue;
+    }
+
+    // The file image goes first, its sections stay where they are in the
+    // file. The bss follows the image.
+    rel_link_module module;
+    module.m_name = rel_module_basename(it->c_str());
+    module.m_path = *it;
+    module.m_id   = id;
+    module.m_base = align_up(next, track->get_align());
+
+    std::vector<section_entry> const &sections = track->get_sections();
+    module.m_sections.assign(sections.size(), 0);
+    uint32_t bss = align_up(module.m_base + track->get_file_size(), track->get_bss_align());
+    uint32_t bss_size = 0;
+    for ( size_t i = 0; i < sections.size(); ++i )
+    {
+      if ( SECTION_OFF(sections[i].file_offset) != 0 )
+      {
+        module.m_sections[i] = module.m_base + SECTION_OFF(sections[i].file_offset);
+      }
+      else if ( sections[i].size != 0 )
+      {
+        module.m_sections[i] = bss;
+        bss_size = sections[i].size;
+      }
+    }
+    module.m_end = bss + bss_size;
+    next = module.m_end;
+
+    m_by_id[id] = m_modules.size();
+    m_modules.emplace_back(std::move(module));
+    tracks.emplace_back(std::move(track));
+  }
+}
+
+void rel_link::name_main_program() const
+{
+  rel_map map;
+  std::string path = m_directory + "/" + BASE_MAP_NAME + MAP_EXTENSION;
+  if ( !map.load(path.c_str(), true) )
+    return;
+
+  msg("REL: %u symbols from %s\n", static_cast<unsigned>(map.size()), path.c_str());
+  for ( size_t i = 0; i < map.size(); ++i )
+  {
+    rel_map_symbol const & symbol = map.get_symbol(i);
+    force_name(symbol.m_offset, map.get_name(symbol), 0);
+  }
+  ldr_count(LDR_NAMES, map.size());
+}
+
+bool rel_link::load(linput_t *fp, bool dry_run, bool reload, FILE *dump)
+{
+  dolhdr dhdr;
+  if ( dol_read_header(fp, &dhdr) == 0 || dol_check_header(&dhdr, qlsize(fp)) == 0 )
+    return err_msg("REL: %s is not a valid DOL", LINK_DOL_NAME);
+  m_entry_point = dhdr.entrypoint;
+
+  if ( !dry_run && reload )
+  {
+    // The main program keeps its segments, only what changed is written
+    ldr_scope trace("reload_dol");
+    dol_contents contents;
+    if ( dol_reload_segments(fp, &dhdr, &contents) == 0 )
+      return err_msg("REL: The segments of %s changed, the database must be recreated", LINK_DOL_NAME);
+  }
+  else if ( !dry_run )
+  {
+    ldr_scope trace("load_dol");
+    dol_contents contents;
+    if ( dol_load_segments(fp, &dhdr, &contents) == 0 )
+      return err_msg("REL: Failed to create the segments of %s", LINK_DOL_NAME);
+    dol_seed_functions(&dhdr, &contents);
+    this->name_main_program();
+  }
+
+  std::vector<std::unique_ptr<rel_track> > tracks;
+  this->layout(dol_end_address(&dhdr), tracks);
+
+  // One module at a time, each is released once it is in the database
+  unsigned linked = 0;
+  for ( size_t i = 0; i < tracks.size(); ++i )
+  {
+    rel_link_module const & module = m_modules[i];
+    msg("REL: Linking %s (id %u) at %08X-%08X\n", module.m_name.c_str(), module.m_id, module.m_base, module.m_end);
+
+    if ( tracks[i]->link(*this) && tracks[i]->apply_patches(dry_run, reload) )
+    {
+      ++linked;
+      if ( dump != nullptr && !rel_plan_write_text(tracks[i]->get_plan(), dump) )
+        err_msg("REL: Unable to write the load plan of %s", module.m_name.c_str());
+    }
+    else
+    {
+      err_msg("REL: Failed to link %s", module.m_name.c_str());
+    }
+    tracks[i].reset();
+  }
+
+  msg("REL: Linked %u of %u modules after %s\n", linked, static_cast<unsigned>(m_modules.size()), LINK_DOL_NAME);
+  return true;
+}
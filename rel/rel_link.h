@@ -0,0 +1,80 @@
+#ifndef __REL_LINK_H__
+#define __REL_LINK_H__
+
+#include "rel.h"
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define LINK_FORMAT_NAME  "Nintendo DOL with RELs (linked)"
+#define LINK_DISC_FORMAT_NAME "Nintendo GameCube disc with RELs (linked)"
+#define LINK_DOL_NAME     "main.dol"
+#define LINK_ALIGN        32      // alignment of modules without v2 fields
+
+class rel_track;
+class rel_gcm;
+
+// Where a module of a linked game is loaded
+struct rel_link_module
+{
+  std::string m_name;
+  std::string m_path;
+  uint32_t m_id;
+  uint32_t m_base;                    // address of the file image
+  uint32_t m_end;                     // end of the image and its bss
+  std::vector<uint32_t> m_sections;   // address of each section, 0 if not loaded
+};
+
+// Loads main.dol and every module next to it into one database. The
+// modules are placed after the main program without overlapping, the
+// way the OS links them at runtime, so imports can be bound directly to
+// their targets instead of going through import slots.
+class rel_link
+{
+public:
+  // Modules are read from disc if one is given, from directory otherwise.
+  // Maps and caches are always looked for in directory.
+  rel_link(std::string const &directory, rel_gcm const *disc = nullptr);
+
+  // Loads the main program from fp and links the modules to it. Unless
+  // dry_run is set the result is committed to the database, dump gets
+  // the load plan of each module. With reload set the game is already in
+  // the database and only changes to the modules are written.
+  bool load(linput_t *fp, bool dry_run, bool reload, FILE *dump);
+
+  std::string const &get_directory() const;
+
+  // Module with the given id, nullptr if it isn't part of the game
+  rel_link_module const *find(uint32_t id) const;
+
+  std::vector<rel_link_module> const &get_modules() const;
+
+  // Entry point of the main program, once loaded
+  uint32_t get_entry_point() const;
+
+  // Number of modules in a directory or on a disc
+  static size_t count_modules(std::string const &directory);
+  static size_t count_modules(rel_gcm const &disc);
+
+private:
+  // Paths of the modules in name order, on the disc if there is one
+  static std::vector<std::string> list_modules(std::string const &directory);
+  static std::vector<std::string> list_modules(rel_gcm const &disc);
+
+  // Places the modules in file name order from start on, keeping the
+  // parsed ones in tracks
+  void layout(uint32_t start, std::vector<std::unique_ptr<rel_track> > &tracks);
+
+  // Names the main program's symbols from its map
+  void name_main_program() const;
+
+  std::string m_directory;
+  rel_gcm const *m_disc;
+  uint32_t m_entry_point;
+  std::vector<rel_link_module> m_modules;
+  std::map<uint32_t, size_t> m_by_id;
+};
+
+#endif // #ifndef __REL_LINK_H__
@@ -0,0 +1,275 @@
+#include "rel_map.h"
+#include "rel_input.h"
+#include <algorithm>
+#include <cstring>
+
+// Kinds of sections, told apart by name in maps and by flags in modules
+enum section_kind
+{
+  SECTION_KIND_CODE,
+  SECTION_KIND_DATA,
+  SECTION_KIND_BSS,
+};
+
+static section_kind map_section_kind(std::string const &name)
+{
+  if ( name == ".init" || name == ".text" )
+    return SECTION_KIND_CODE;
+  if ( name == ".bss" || name == ".sbss" || name == ".sbss2" )
+    return SECTION_KIND_BSS;
+  return SECTION_KIND_DATA;
+}
+
+static section_kind module_section_kind(section_entry const &entry)
+{
+  if ( entry.file_offset & SECTION_EXEC )
+    return SECTION_KIND_CODE;
+  return SECTION_OFF(entry.file_offset) == 0 ? SECTION_KIND_BSS : SECTION_KIND_DATA;
+}
+
+rel_map::rel_map()
+{}
+
+void rel_map::clear()
+{
+  m_symbols.clear();
+  m_names.clear();
+  m_sections.clear();
+}
+
+size_t rel_map::size() const
+{
+  return m_symbols.size();
+}
+
+rel_map_symbol const &rel_map::get_symbol(size_t i) const
+{
+  return m_symbols[i];
+}
+
+char const *rel_map::get_name(rel_map_symbol const &symbol) const
+{
+  return &m_names[symbol.m_name];
+}
+
+std::vector<rel_map_section> const &rel_map::get_sections() const
+{
+  return m_sections;
+}
+
+bool rel_map::match_sections(std::vector<section_entry> const &sections, std::string &mismatch)
+{
+  // Layouts without entries don't take up a section, the others take the
+  // next one of their kind that is big enough
+  size_t next = 1;
+  for ( auto it = m_sections.begin(); it != m_sections.end(); ++it )
+  {
+    it->m_index = 0;
+    if ( it->m_size == 0 )
+      continue;
+
+    section_kind kind = map_section_kind(it->m_name);
+    while ( next < sections.size() &&
+            (sections[next].size == 0 || module_section_kind(sections[next]) != kind || sections[next].size < it->m_size) )
+      ++next;
+    if ( next >= sections.size() || next > 0xFF )
+    {
+      mismatch = it->m_name;
+      return false;
+    }
+    it->m_index = static_cast<uint8_t>(next++);
+  }
+
+  // Indices grow with the layouts, so the symbols stay sorted
+  for ( auto it = m_symbols.begin(); it != m_symbols.end(); ++it )
+    it->m_section = m_sections[it->m_section - 1].m_index;
+  auto last = std::remove_if(m_symbols.begin(), m_symbols.end(), [](rel_map_symbol const &symbol)
+  {
+    return symbol.m_section == 0;
+  });
+  m_symbols.erase(last, m_symbols.end());
+  return true;
+}
+
+bool rel_map::load(char const *path, bool absolute)
+{
+  this->clear();
+
+  // Maps run into tens of megabytes, scan them in place
+  rel_input input;
+  if ( !input.open(path) )
+    return false;
+
+  char const *data = reinterpret_cast<char const *>(input.data(0, input.get_size()));
+  if ( data == nullptr )
+    return false;
+  this->parse(data, data + input.get_size(), absolute);
+
+  // Sort by position, preferring real names over compiler labels (@123)
+  // when several symbols start at the same place
+  std::vector<char> const &names = m_names;
+  std::stable_sort(m_symbols.begin(), m_symbols.end(), [&names](rel_map_symbol const &a, rel_map_symbol const &b)
+  {
+    if ( a.m_section != b.m_section )
+      return a.m_section < b.m_section;
+    if ( a.m_offset != b.m_offset )
+      return a.m_offset < b.m_offset;
+    return names[a.m_name] != '@' && names[b.m_name] == '@';
+  });
+  auto last = std::unique(m_symbols.begin(), m_symbols.end(), [](rel_map_symbol const &a, rel_map_symbol const &b)
+  {
+    return a.m_section == b.m_section && a.m_offset == b.m_offset;
+  });
+  m_symbols.erase(last, m_symbols.end());
+  return !m_symbols.empty();
+}
+
+char const *rel_map::find(uint8_t section, uint32_t offset) const
+{
+  rel_map_symbol key = { section, offset, 0, 0 };
+  auto it = std::lower_bound(m_symbols.begin(), m_symbols.end(), key, [](rel_map_symbol const &a, rel_map_symbol const &b)
+  {
+    return a.m_section != b.m_section ? a.m_section < b.m_section : a.m_offset < b.m_offset;
+  });
+  if ( it == m_symbols.end() || it->m_section != section || it->m_offset != offset )
+    return nullptr;
+  return this->get_name(*it);
+}
+
+void rel_map::add_symbol(uint8_t section, uint32_t offset, uint32_t size, char const *name, size_t name_size)
+{
+  rel_map_symbol symbol;
+  symbol.m_section = section;
+  symbol.m_offset  = offset;
+  symbol.m_size    = size;
+  symbol.m_name    = static_cast<uint32_t>(m_names.size());
+  m_symbols.push_back(symbol);
+
+  m_names.insert(m_names.end(), name, name + name_size);
+  m_names.push_back('\0');
+}
+
+static inline bool is_space(char c)
+{
+  return c == ' ' || c == '\t';
+}
+
+static inline bool is_end(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline int hex_digit(char c)
+{
+  if ( c >= '0' && c <= '9' )
+    return c - '0';
+  c |= 0x20;
+  if ( c >= 'a' && c <= 'f' )
+    return c - 'a' + 10;
+  return -1;
+}
+
+static char const *skip_spaces(char const *p, char const *end)
+{
+  while ( p < end && is_space(*p) )
+    ++p;
+  return p;
+}
+
+// Reads a hex number ending in whitespace, returning the number of digits
+// or 0 if the token isn't one
+static size_t read_hex(char const *&p, char const *end, uint32_t &value)
+{
+  char const *start = p;
+  value = 0;
+  int digit;
+  while ( p < end && (digit = hex_digit(*p)) >= 0 )
+  {
+    value = (value << 4) | static_cast<uint32_t>(digit);
+    ++p;
+  }
+  if ( p == start || (p < end && !is_end(*p)) )
+  {
+    p = start;
+    return 0;
+  }
+  return static_cast<size_t>(p - start);
+}
+
+// Symbol lines of the section layouts look like
+//   00000000 000078 80004000  4 __start 	__start.c
+// with an extra file offset column after the address in newer linkers
+void rel_map::parse(char const *p, char const *end, bool absolute)
+{
+  static char const layout[] = " section layout";
+  size_t const layout_size = sizeof(layout) - 1;
+  uint8_t section = 0;
+  bool in_layout = false;
+
+  while ( p < end )
+  {
+    char const *eol = static_cast<char const *>(memchr(p, '\n', end - p));
+    if ( eol == nullptr )
+      eol = end;
+    char const *line = skip_spaces(p, eol);
+    p = eol + 1;
+
+    // Section headers: ".text section layout"
+    char const *token = line;
+    while ( token < eol && !is_end(*token) )
+      ++token;
+    if ( static_cast<size_t>(eol - token) >= layout_size && memcmp(token, layout, layout_size) == 0 )
+    {
+      // Layouts past the 255th can't be told apart, their symbols are dropped
+      in_layout = true;
+      section = 0;
+      if ( !absolute && m_sections.size() < 0xFF )
+      {
+        rel_map_section layout_section = { std::string(line, token), 0, 0 };
+        m_sections.push_back(layout_section);
+        section = static_cast<uint8_t>(m_sections.size());
+      }
+      continue;
+    }
+    if ( !in_layout || (!absolute && section == 0) )
+      continue;
+
+    // Starting offset, size and virtual address
+    uint32_t start, size, address, column;
+    char const *q = line;
+    if ( read_hex(q, eol, start) != 8 )
+      continue;
+    q = skip_spaces(q, eol);
+    if ( read_hex(q, eol, size) == 0 )
+      continue;
+    q = skip_spaces(q, eol);
+    if ( read_hex(q, eol, address) != 8 )
+      continue;
+    q = skip_spaces(q, eol);
+    if ( !absolute && start + size > m_sections.back().m_size )
+      m_sections.back().m_size = start + size;
+
+    // Optional file offset, then an optional decimal alignment
+    char const *mark = q;
+    if ( read_hex(q, eol, column) == 8 )
+      q = skip_spaces(q, eol);
+    else
+      q = mark;
+    mark = q;
+    while ( q < eol && *q >= '0' && *q <= '9' )
+      ++q;
+    if ( q < eol && is_space(*q) && q != mark )
+      q = skip_spaces(q, eol);
+    else
+      q = mark;
+
+    // Symbol name, skipping section and object entries
+    char const *name = q;
+    while ( q < eol && !is_end(*q) )
+      ++q;
+    if ( q == name || *name == '.' || *name == '(' )
+      continue;
+
+    this->add_symbol(section, absolute ? address : start, size, name, q - name);
+  }
+}
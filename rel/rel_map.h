@@ -0,0 +1,65 @@
+#ifndef __REL_MAP_H__
+#define __REL_MAP_H__
+
+#include "rel.h"
+#include <string>
+#include <vector>
+
+#define MAP_EXTENSION ".map"
+#define BASE_MAP_NAME "main"    // map of the main program, module 0
+
+// A symbol of a linker map. Names live in the arena of their map.
+struct rel_map_symbol
+{
+  uint8_t  m_section;   // section index, 0 for absolute addresses
+  uint32_t m_offset;    // offset within the section, or address
+  uint32_t m_size;
+  uint32_t m_name;      // offset of the name in the arena
+};
+
+// A section layout of a linker map, in the order the map lists them
+struct rel_map_section
+{
+  std::string m_name;
+  uint32_t m_size;      // end of the furthest entry of the layout
+  uint8_t  m_index;     // section of the module, 0 if not matched
+};
+
+// Symbols of a CodeWarrior linker map, sorted by (section, offset)
+class rel_map
+{
+public:
+  rel_map();
+
+  // Parses a map. Relocatable modules key symbols by the position of
+  // their section layout in the map (1 for the first) and offset until
+  // match_sections is called, absolute ones (the main program) by address
+  // with section 0.
+  bool load(char const *path, bool absolute);
+  void clear();
+
+  // Renumbers the symbols of a relocatable map with the sections of the
+  // module it was built with. The layouts are matched in order to the
+  // sections of the same kind (code, data or bss) they fit in. Returns
+  // false with the layout that didn't fit in mismatch if the map belongs
+  // to another build or layout.
+  bool match_sections(std::vector<section_entry> const &sections, std::string &mismatch);
+
+  // Name of the symbol starting at (section, offset), nullptr if none
+  char const *find(uint8_t section, uint32_t offset) const;
+
+  size_t size() const;
+  rel_map_symbol const &get_symbol(size_t i) const;
+  char const *get_name(rel_map_symbol const &symbol) const;
+  std::vector<rel_map_section> const &get_sections() const;
+
+private:
+  void parse(char const *p, char const *end, bool absolute);
+  void add_symbol(uint8_t section, uint32_t offset, uint32_t size, char const *name, size_t name_size);
+
+  std::vector<rel_map_symbol> m_symbols;
+  std::vector<char> m_names;
+  std::vector<rel_map_section> m_sections;
+};
+
+#endif // #ifndef __REL_MAP_H__
@@ -0,0 +1,58 @@
+#include "rel_plan.h"
+
+rel_load_plan::rel_load_plan()
+{
+  this->clear();
+}
+
+void rel_load_plan::clear()
+{
+  m_segments.clear();
+  m_patches.clear();
+  m_runs.clear();
+  m_slots.clear();
+  m_comments.clear();
+  m_program_comments.clear();
+  m_entries.clear();
+  m_names.clear();
+  m_functions.clear();
+  m_offsets.clear();
+  rel_engine_reset(m_stats);
+  for (int i = 0; i < REL_PHASE_COUNT; ++i)
+    m_seconds[i] = 0;
+}
+
+bool rel_plan_write_text(rel_load_plan const &plan, FILE *fp)
+{
+  for (auto it = plan.m_segments.begin(); it != plan.m_segments.end(); ++it)
+    fprintf(fp, "segment %08X-%08X %s %s file:%08X\n", it->m_start, it->m_end, it->m_name.c_str(), it->m_class.c_str(), it->m_file_offset);
+
+  for (auto it = plan.m_patches.begin(); it != plan.m_patches.end(); ++it)
+    fprintf(fp, "patch %08X %u %08X (was %08X)\n", it->m_address, static_cast<unsigned>(it->m_width), it->m_value, it->m_original);
+
+  for (auto it = plan.m_runs.begin(); it != plan.m_runs.end(); ++it)
+    fprintf(fp, "run %u %u patches from %u\n", it->m_module, static_cast<unsigned>(it->m_count), static_cast<unsigned>(it->m_first));
+
+  for (auto it = plan.m_slots.begin(); it != plan.m_slots.end(); ++it)
+    fprintf(fp, "slot %08X %08X %s ; %s\n", it->m_address, it->m_value, it->m_name.c_str(), it->m_comment.c_str());
+
+  for (auto it = plan.m_comments.begin(); it != plan.m_comments.end(); ++it)
+    fprintf(fp, "comment %08X %s\n", it->m_address, it->m_text.c_str());
+
+  for (auto it = plan.m_program_comments.begin(); it != plan.m_program_comments.end(); ++it)
+    fprintf(fp, "program %s\n", it->c_str());
+
+  for (auto it = plan.m_entries.begin(); it != plan.m_entries.end(); ++it)
+    fprintf(fp, "entry %08X %s\n", it->m_address, it->m_text.c_str());
+
+  for (auto it = plan.m_names.begin(); it != plan.m_names.end(); ++it)
+    fprintf(fp, "name %08X %s\n", it->m_address, it->m_text.c_str());
+
+  for (auto it = plan.m_functions.begin(); it != plan.m_functions.end(); ++it)
+    fprintf(fp, "function %08X\n", *it);
+
+  for (auto it = plan.m_offsets.begin(); it != plan.m_offsets.end(); ++it)
+    fprintf(fp, "offset %08X %u -> %08X type %u\n", it->m_address, static_cast<unsigned>(it->m_operand), it->m_target, static_cast<unsigned>(it->m_type));
+
+  return ferror(fp) == 0;
+}
@@ -0,0 +1,88 @@
+#ifndef __REL_PLAN_H__
+#define __REL_PLAN_H__
+
+#include "rel_engine.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Everything loading a module does to the database, computed without
+// touching it. Committing the plan is the only step with side effects.
+
+struct rel_plan_segment
+{
+  uint32_t m_start;
+  uint32_t m_end;
+  uint32_t m_file_offset;   // 0 if the segment has no file data
+  std::string m_name;
+  std::string m_class;
+};
+
+// An import slot in the XTRN segment
+struct rel_plan_slot
+{
+  uint32_t m_address;
+  uint32_t m_value;         // addend of the import
+  std::string m_name;
+  std::string m_comment;
+};
+
+// Patches of one import table entry, m_count of them from m_first on
+struct rel_plan_run
+{
+  uint32_t m_module;        // id the entry imports from
+  size_t m_first;
+  size_t m_count;
+};
+
+// An operand or data word holding an address. Instructions are addressed
+// at their start, type is the relocation building the address.
+struct rel_plan_offset
+{
+  uint32_t m_address;
+  uint32_t m_target;
+  uint8_t  m_type;
+  uint8_t  m_operand;       // REL_NO_OPERAND if only the xref is known
+};
+
+#define REL_NO_OPERAND 0xFF
+
+struct rel_plan_comment
+{
+  uint32_t m_address;
+  std::string m_text;
+};
+
+enum rel_plan_phase
+{
+  REL_PHASE_SECTIONS,
+  REL_PHASE_RELOCATIONS,
+  REL_PHASE_NAMES,
+  REL_PHASE_COMMIT,
+  REL_PHASE_COUNT,
+};
+
+struct rel_load_plan
+{
+  std::vector<rel_plan_segment> m_segments;
+  std::vector<rel_patch> m_patches;
+  std::vector<rel_plan_run> m_runs;
+  std::vector<rel_plan_slot> m_slots;
+  std::vector<rel_plan_comment> m_comments;     // anterior comments
+  std::vector<std::string> m_program_comments;
+  std::vector<rel_plan_comment> m_entries;      // exported entry points
+  std::vector<rel_plan_comment> m_names;        // symbols from linker maps
+  std::vector<uint32_t> m_functions;            // function starts, sorted and distinct
+  std::vector<rel_plan_offset> m_offsets;       // by address
+
+  rel_engine_stats m_stats;
+  double m_seconds[REL_PHASE_COUNT];
+
+  rel_load_plan();
+  void clear();
+};
+
+// Writes a plan as text, one line per item, for diffing between loads
+bool rel_plan_write_text(rel_load_plan const &plan, FILE *fp);
+
+#endif // #ifndef __REL_PLAN_H__
@@ -0,0 +1,341 @@
+#include "rel_reload.h"
+#include "rel_format.h"
+#include <algorithm>
+#include <map>
+
+rel_reload_state::rel_reload_state()
+{
+  this->clear();
+}
+
+void rel_reload_state::clear()
+{
+  m_sections.clear();
+  m_runs.clear();
+  m_slots.clear();
+  m_extern_start = 0;
+  m_extern_end = 0;
+  m_resolvers = 0;
+  m_names = 0;
+  m_comments = 0;
+  m_named.clear();
+  m_commented.clear();
+}
+
+uint64_t rel_hash(void const *data, size_t size, uint64_t seed)
+{
+  uint8_t const *p = static_cast<uint8_t const *>(data);
+  uint64_t h = seed;
+  for (size_t i = 0; i < size; ++i)
+    h = (h ^ p[i]) * 1099511628211ull;
+  return h;
+}
+
+uint64_t rel_hash_u32(uint32_t value, uint64_t seed)
+{
+  uint8_t bytes[4];
+  write_be32(bytes, value);
+  return rel_hash(bytes, sizeof(bytes), seed);
+}
+
+static uint64_t hash_text(std::string const &text, uint64_t seed)
+{
+  // Include the terminator so "ab"+"c" and "a"+"bc" differ
+  return rel_hash(text.c_str(), text.size() + 1, seed);
+}
+
+static uint64_t hash_comments(std::vector<rel_plan_comment> const &comments, uint64_t seed)
+{
+  for (auto it = comments.begin(); it != comments.end(); ++it)
+    seed = hash_text(it->m_text, rel_hash_u32(it->m_address, seed));
+  return seed;
+}
+
+void rel_reload_blocks(uint8_t const *data, size_t size, std::vector<uint64_t> &blocks)
+{
+  blocks.resize((size + RELOAD_BLOCK_SIZE - 1) / RELOAD_BLOCK_SIZE);
+  for (size_t k = 0; k < blocks.size(); ++k)
+    blocks[k] = rel_hash(data + k * RELOAD_BLOCK_SIZE, std::min<size_t>(RELOAD_BLOCK_SIZE, size - k * RELOAD_BLOCK_SIZE));
+}
+
+// Sorted and without duplicates
+static void add_addresses(std::vector<rel_plan_comment> const &comments, std::vector<uint32_t> &addresses)
+{
+  for (auto it = comments.begin(); it != comments.end(); ++it)
+    addresses.push_back(it->m_address);
+  std::sort(addresses.begin(), addresses.end());
+  addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+}
+
+void rel_reload_describe(rel_load_plan const &plan, rel_reload_state &state)
+{
+  state.m_slots.clear();
+  state.m_slots.reserve(plan.m_slots.size());
+  for (auto it = plan.m_slots.begin(); it != plan.m_slots.end(); ++it)
+  {
+    uint64_t h = rel_hash_u32(it->m_value, rel_hash_u32(it->m_address, rel_hash(nullptr, 0)));
+    state.m_slots.push_back(hash_text(it->m_comment, hash_text(it->m_name, h)));
+  }
+
+  state.m_names = hash_comments(plan.m_names, hash_comments(plan.m_entries, rel_hash(nullptr, 0)));
+  state.m_named.clear();
+  add_addresses(plan.m_names, state.m_named);
+  add_addresses(plan.m_entries, state.m_named);
+
+  // Program comments are only ever added, they don't count
+  state.m_comments = hash_comments(plan.m_comments, rel_hash(nullptr, 0));
+  state.m_commented.clear();
+  add_addresses(plan.m_comments, state.m_commented);
+}
+
+void rel_reload_describe_runs(rel_load_plan const &plan, rel_reload_state &state)
+{
+  state.m_runs.clear();
+  for (auto it = plan.m_runs.begin(); it != plan.m_runs.end(); ++it)
+  {
+    rel_reload_run run = { it->m_module, 0, rel_hash(nullptr, 0) };
+    for (size_t i = it->m_first; i < it->m_first + it->m_count; ++i)
+    {
+      rel_patch const &patch = plan.m_patches[i];
+      run.m_sections |= 1u << (patch.m_section & 31);
+      run.m_hash = rel_hash_u32(patch.m_value, rel_hash_u32(patch.m_address, run.m_hash));
+    }
+    state.m_runs.push_back(run);
+  }
+}
+
+bool rel_reload_same_layout(rel_reload_state const &previous, rel_reload_state const &current)
+{
+  if (previous.m_sections.size() != current.m_sections.size())
+    return false;
+  for (size_t i = 0; i < current.m_sections.size(); ++i)
+  {
+    if (previous.m_sections[i].m_start != current.m_sections[i].m_start ||
+        previous.m_sections[i].m_size != current.m_sections[i].m_size)
+      return false;
+  }
+  return previous.m_extern_start == current.m_extern_start;
+}
+
+void rel_reload_compare(rel_reload_state const &previous, rel_reload_state const &current,
+                        uint32_t self, bool linked, rel_reload_changes &changes)
+{
+  changes.m_sections = 0;
+  changes.m_runs.clear();
+  changes.m_externals = false;
+  changes.m_slots = !linked && previous.m_resolvers != current.m_resolvers;
+  changes.m_extern_size = previous.m_extern_end - previous.m_extern_start;
+
+  // Masks fold the sections past 31 onto the first ones
+  for (size_t i = 0; i < current.m_sections.size(); ++i)
+  {
+    if (i >= previous.m_sections.size() || previous.m_sections[i].m_hash != current.m_sections[i].m_hash)
+      changes.m_sections |= 1u << (i & 31);
+  }
+
+  // Runs are matched by the module they import from
+  std::map<uint32_t, rel_reload_run const *> old_runs;
+  for (auto it = previous.m_runs.begin(); it != previous.m_runs.end(); ++it)
+    old_runs[it->m_module] = &*it;
+
+  for (auto it = current.m_runs.begin(); it != current.m_runs.end(); ++it)
+  {
+    auto old = old_runs.find(it->m_module);
+    if (old != old_runs.end() && old->second->m_hash == it->m_hash)
+    {
+      old_runs.erase(old);
+      continue;
+    }
+    changes.m_sections |= it->m_sections;
+    changes.m_runs.insert(it->m_module);
+    changes.m_slots = changes.m_slots || (!linked && it->m_module != self);
+    if (old != old_runs.end())
+    {
+      changes.m_sections |= old->second->m_sections;
+      old_runs.erase(old);
+    }
+  }
+
+  // Runs that went away leave their old sites to restore
+  for (auto it = old_runs.begin(); it != old_runs.end(); ++it)
+  {
+    changes.m_sections |= it->second->m_sections;
+    changes.m_slots = changes.m_slots || (!linked && it->first != self);
+  }
+
+  // New slots move the targets of every import
+  if (changes.m_slots)
+  {
+    for (auto it = previous.m_runs.begin(); it != previous.m_runs.end(); ++it)
+    {
+      if (it->m_module != self)
+        changes.m_sections |= it->m_sections;
+    }
+    for (auto it = current.m_runs.begin(); it != current.m_runs.end(); ++it)
+    {
+      if (it->m_module != self)
+        changes.m_sections |= it->m_sections;
+    }
+  }
+
+  // Sections are rewritten whole, so every run patching them is applied again
+  for (auto it = current.m_runs.begin(); it != current.m_runs.end(); ++it)
+  {
+    if ((it->m_sections & changes.m_sections) != 0)
+      changes.m_runs.insert(it->m_module);
+  }
+  for (auto it = changes.m_runs.begin(); it != changes.m_runs.end(); ++it)
+    changes.m_externals = changes.m_externals || *it != self;
+}
+
+// Serialized as big endian words: version, counts, then the records
+static void put32(std::vector<uint8_t> &out, uint32_t value)
+{
+  size_t at = out.size();
+  out.resize(at + 4);
+  write_be32(&out[at], value);
+}
+
+static void put64(std::vector<uint8_t> &out, uint64_t value)
+{
+  put32(out, static_cast<uint32_t>(value >> 32));
+  put32(out, static_cast<uint32_t>(value));
+}
+
+std::vector<uint8_t> rel_reload_state::serialize() const
+{
+  std::vector<uint8_t> out;
+  put32(out, RELOAD_VERSION);
+  put32(out, static_cast<uint32_t>(m_sections.size()));
+  put32(out, static_cast<uint32_t>(m_runs.size()));
+  put32(out, static_cast<uint32_t>(m_slots.size()));
+  put32(out, static_cast<uint32_t>(m_named.size()));
+  put32(out, static_cast<uint32_t>(m_commented.size()));
+  put32(out, m_extern_start);
+  put32(out, m_extern_end);
+  put64(out, m_resolvers);
+  put64(out, m_names);
+  put64(out, m_comments);
+
+  for (auto it = m_sections.begin(); it != m_sections.end(); ++it)
+  {
+    put32(out, it->m_start);
+    put32(out, it->m_size);
+    put64(out, it->m_hash);
+    put32(out, static_cast<uint32_t>(it->m_blocks.size()));
+    for (auto block = it->m_blocks.begin(); block != it->m_blocks.end(); ++block)
+      put64(out, *block);
+  }
+  for (auto it = m_runs.begin(); it != m_runs.end(); ++it)
+  {
+    put32(out, it->m_module);
+    put32(out, it->m_sections);
+    put64(out, it->m_hash);
+  }
+  for (auto it = m_slots.begin(); it != m_slots.end(); ++it)
+    put64(out, *it);
+  for (auto it = m_named.begin(); it != m_named.end(); ++it)
+    put32(out, *it);
+  for (auto it = m_commented.begin(); it != m_commented.end(); ++it)
+    put32(out, *it);
+  return out;
+}
+
+// Reads the words back, failing instead of running past the end
+class reload_reader
+{
+public:
+  reload_reader(uint8_t const *data, size_t size) : m_p(data), m_end(data + size), m_ok(data != nullptr) {}
+
+  uint32_t get32()
+  {
+    if (!m_ok || m_end - m_p < 4)
+    {
+      m_ok = false;
+      return 0;
+    }
+    uint32_t value = read_be32(m_p);
+    m_p += 4;
+    return value;
+  }
+
+  uint64_t get64()
+  {
+    uint64_t high = this->get32();
+    return (high << 32) | this->get32();
+  }
+
+  // True if count records of size bytes can follow
+  bool fits(uint32_t count, size_t size) const { return m_ok && static_cast<uint64_t>(count) * size <= static_cast<uint64_t>(m_end - m_p); }
+  bool done() const { return m_ok && m_p == m_end; }
+
+private:
+  uint8_t const *m_p;
+  uint8_t const *m_end;
+  bool m_ok;
+};
+
+bool rel_reload_state::deserialize(uint8_t const *data, size_t size)
+{
+  this->clear();
+
+  reload_reader in(data, size);
+  if (in.get32() != RELOAD_VERSION)
+    return false;
+
+  uint32_t num_sections  = in.get32();
+  uint32_t num_runs      = in.get32();
+  uint32_t num_slots     = in.get32();
+  uint32_t num_named     = in.get32();
+  uint32_t num_commented = in.get32();
+  m_extern_start = in.get32();
+  m_extern_end   = in.get32();
+  m_resolvers    = in.get64();
+  m_names        = in.get64();
+  m_comments     = in.get64();
+
+  if (!in.fits(num_sections, 20))
+    return false;
+  m_sections.resize(num_sections);
+  for (auto it = m_sections.begin(); it != m_sections.end(); ++it)
+  {
+    it->m_start = in.get32();
+    it->m_size  = in.get32();
+    it->m_hash  = in.get64();
+    uint32_t num_blocks = in.get32();
+    if (!in.fits(num_blocks, 8))
+      return false;
+    it->m_blocks.resize(num_blocks);
+    for (auto block = it->m_blocks.begin(); block != it->m_blocks.end(); ++block)
+      *block = in.get64();
+  }
+
+  if (!in.fits(num_runs, 16))
+    return false;
+  m_runs.resize(num_runs);
+  for (auto it = m_runs.begin(); it != m_runs.end(); ++it)
+  {
+    it->m_module   = in.get32();
+    it->m_sections = in.get32();
+    it->m_hash     = in.get64();
+  }
+
+  if (!in.fits(num_slots, 8))
+    return false;
+  m_slots.resize(num_slots);
+  for (auto it = m_slots.begin(); it != m_slots.end(); ++it)
+    *it = in.get64();
+
+  if (!in.fits(num_named, 4))
+    return false;
+  m_named.resize(num_named);
+  for (auto it = m_named.begin(); it != m_named.end(); ++it)
+    *it = in.get32();
+
+  if (!in.fits(num_commented, 4))
+    return false;
+  m_commented.resize(num_commented);
+  for (auto it = m_commented.begin(); it != m_commented.end(); ++it)
+    *it = in.get32();
+  return in.done();
+}
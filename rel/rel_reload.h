@@ -0,0 +1,94 @@
+#ifndef __REL_RELOAD_H__
+#define __REL_RELOAD_H__
+
+#include "rel_plan.h"
+#include <cstdint>
+#include <set>
+#include <vector>
+
+// What a load wrote to the database, in hashes. It is kept with the
+// database so that reloading a rebuilt module can tell which sections,
+// relocation runs and import slots changed and only write those.
+// Independent of the IDA SDK.
+
+#define RELOAD_VERSION 2
+
+// Sections are rewritten in blocks of this size, only those that changed
+#define RELOAD_BLOCK_SIZE 0x1000
+
+struct rel_reload_section
+{
+  uint32_t m_start;
+  uint32_t m_size;
+  uint64_t m_hash;                  // file contents, before relocating
+  std::vector<uint64_t> m_blocks;   // relocated contents, per block
+};
+
+// Relocations against one module, from all of its import table entries
+struct rel_reload_run
+{
+  uint32_t m_module;        // id they import from
+  uint32_t m_sections;      // mask of the sections they patch
+  uint64_t m_hash;          // over their records as in the file, or the
+                            // patches of an RSO
+};
+
+struct rel_reload_state
+{
+  std::vector<rel_reload_section> m_sections;
+  std::vector<rel_reload_run> m_runs;
+  std::vector<uint64_t> m_slots;      // address, value, name and comment of each slot
+  uint32_t m_extern_start;
+  uint32_t m_extern_end;
+  uint64_t m_resolvers;               // siblings and maps the slots are named from
+  uint64_t m_names;                   // entries and map symbols
+  uint64_t m_comments;                // anterior comments
+  std::vector<uint32_t> m_named;      // addresses of the entries and map symbols
+  std::vector<uint32_t> m_commented;  // addresses of the anterior comments
+
+  rel_reload_state();
+  void clear();
+
+  std::vector<uint8_t> serialize() const;
+  bool deserialize(uint8_t const *data, size_t size);
+};
+
+// What a reload redoes
+struct rel_reload_changes
+{
+  uint32_t m_sections;            // mask of the sections to rewrite
+  std::set<uint32_t> m_runs;      // modules whose relocations are applied again
+  bool m_externals;               // some of them are not the module itself
+  bool m_slots;                   // import slots are planned and named again
+  uint32_t m_extern_size;         // of the XTRN segment, if they are not
+};
+
+// FNV-1a, chained through seed
+uint64_t rel_hash(void const *data, size_t size, uint64_t seed = 14695981039346656037ull);
+uint64_t rel_hash_u32(uint32_t value, uint64_t seed);
+
+// Hashes size bytes of relocated contents into blocks
+void rel_reload_blocks(uint8_t const *data, size_t size, std::vector<uint64_t> &blocks);
+
+// Fills the slot, name and comment hashes and addresses from a plan
+void rel_reload_describe(rel_load_plan const &plan, rel_reload_state &state);
+
+// Fills the runs from the patches of a plan, for RSOs which have no
+// records to hash
+void rel_reload_describe_runs(rel_load_plan const &plan, rel_reload_state &state);
+
+// True if every section and the XTRN segment still start at the same
+// address, so the database can be updated in place. The XTRN segment
+// may grow or shrink.
+bool rel_reload_same_layout(rel_reload_state const &previous, rel_reload_state const &current);
+
+// Works out what to redo from the sections and runs of both loads. The
+// sections whose contents changed are rewritten, as are those patched by a
+// run that changed, appeared or disappeared; every run patching one of
+// them is applied again. A change to the imports of another module, or to
+// what they resolve against, plans the slots again. self is the id of
+// the module, linked modules have no slots.
+void rel_reload_compare(rel_reload_state const &previous, rel_reload_state const &current,
+                        uint32_t self, bool linked, rel_reload_changes &changes);
+
+#endif // #ifndef __REL_RELOAD_H__
@@ -0,0 +1,209 @@
+#include "rel_rso.h"
+#include <cstring>
+
+#define NO_SYMBOL 0xFFFFFFFF
+
+void rel_rso_read_tables(uint8_t const *header, rel_rso_tables &out)
+{
+  out.m_name_offset     = read_be32(header + offsetof(rsohdr, name_offset));
+  out.m_name_size       = read_be32(header + offsetof(rsohdr, name_size));
+  out.m_internal_offset = read_be32(header + offsetof(rsohdr, internal_offset));
+  out.m_internal_size   = read_be32(header + offsetof(rsohdr, internal_size));
+  out.m_external_offset = read_be32(header + offsetof(rsohdr, external_offset));
+  out.m_external_size   = read_be32(header + offsetof(rsohdr, external_size));
+  out.m_export_offset   = read_be32(header + offsetof(rsohdr, export_offset));
+  out.m_export_size     = read_be32(header + offsetof(rsohdr, export_size));
+  out.m_export_names    = read_be32(header + offsetof(rsohdr, export_names));
+  out.m_import_offset   = read_be32(header + offsetof(rsohdr, import_offset));
+  out.m_import_size     = read_be32(header + offsetof(rsohdr, import_size));
+  out.m_import_names    = read_be32(header + offsetof(rsohdr, import_names));
+}
+
+std::string rel_rso_module_name(uint8_t const *data, size_t size, rel_rso_tables const &tables)
+{
+  if ( tables.m_name_size == 0 || static_cast<uint64_t>(tables.m_name_offset) + tables.m_name_size > size )
+    return std::string();
+
+  char const *name = reinterpret_cast<char const *>(data + tables.m_name_offset);
+  std::string out(name, strnlen(name, tables.m_name_size));
+  out = out.substr(out.find_last_of("/\\") + 1);
+  return out.substr(0, out.find_last_of('.'));
+}
+
+char const *rel_rso_string(uint8_t const *data, size_t size, uint32_t names, uint32_t offset)
+{
+  uint64_t start = static_cast<uint64_t>(names) + offset;
+  if ( start >= size )
+    return nullptr;
+
+  char const *name = reinterpret_cast<char const *>(data + start);
+  return memchr(name, '\0', size - static_cast<size_t>(start)) != nullptr ? name : nullptr;
+}
+
+uint32_t rel_elf_hash(char const *name)
+{
+  uint32_t h = 0;
+  for ( uint8_t const *p = reinterpret_cast<uint8_t const *>(name); *p != 0; ++p )
+  {
+    h = (h << 4) + *p;
+    uint32_t g = h & 0xF0000000;
+    if ( g != 0 )
+      h ^= g >> 24;
+    h &= ~g;
+  }
+  return h;
+}
+
+rel_decode_result rel_decode_rso(uint8_t const *data, uint32_t count,
+                                 section_entry const *sections, size_t num_sections,
+                                 bool internal, rel_stream &out, std::vector<uint32_t> &symbols)
+{
+  rel_decode_result result = { REL_DECODE_OK, 0, 0 };
+  out.m_where.reserve(out.size() + count);
+  out.m_addend.reserve(out.size() + count);
+  out.m_type.reserve(out.size() + count);
+  out.m_section.reserve(out.size() + count);
+  out.m_site.reserve(out.size() + count);
+  symbols.reserve(symbols.size() + count);
+
+  // Sites come mostly in order, the section of the last one is tried first
+  size_t site = 0;
+  for ( uint32_t i = 0; i < count; ++i )
+  {
+    uint8_t const *p = data + i*sizeof(rso_relocation);
+    uint32_t offset = read_be32(p);
+    uint32_t info   = read_be32(p + 4);
+    uint32_t addend = read_be32(p + 8);
+    uint8_t type    = RSO_TYPE(info);
+    uint32_t symbol = RSO_SYMBOL(info);
+    result.m_consumed += sizeof(rso_relocation);
+    if ( type == R_PPC_NONE )
+      continue;
+
+    uint32_t width = rel_patch_width(type);
+    uint32_t start = SECTION_OFF(sections[site].file_offset);
+    if ( start == 0 || offset < start || offset - start + width > sections[site].size )
+    {
+      for ( site = 0; site < num_sections; ++site )
+      {
+        start = SECTION_OFF(sections[site].file_offset);
+        if ( start != 0 && offset >= start && offset - start + width <= sections[site].size )
+          break;
+      }
+      if ( site == num_sections )
+      {
+        site = 0;
+        result.m_status = REL_DECODE_OUT_OF_BOUNDS;
+        result.m_record = i;
+        return result;
+      }
+    }
+
+    if ( internal && symbol >= num_sections )
+    {
+      result.m_status = REL_DECODE_BAD_SECTION;
+      result.m_record = i;
+      return result;
+    }
+
+    out.m_where.push_back(offset - start);
+    out.m_addend.push_back(addend);
+    out.m_type.push_back(type);
+    out.m_section.push_back(internal ? static_cast<uint8_t>(symbol) : 0);
+    out.m_site.push_back(static_cast<uint8_t>(site));
+    symbols.push_back(symbol);
+  }
+  return result;
+}
+
+rel_export_index::rel_export_index()
+{}
+
+void rel_export_index::clear()
+{
+  m_symbols.clear();
+  m_buckets.clear();
+  m_arena.clear();
+}
+
+size_t rel_export_index::size() const
+{
+  return m_symbols.size();
+}
+
+bool rel_export_index::add_module(uint32_t module, uint8_t const *data, size_t size, rel_rso_tables const &tables,
+                                  uint32_t const *bases, size_t num_bases)
+{
+  uint32_t count = tables.m_export_size / sizeof(rso_export);
+  if ( count == 0 )
+    return true;
+  if ( static_cast<uint64_t>(tables.m_export_offset) + count*sizeof(rso_export) > size )
+    return false;
+
+  // Tables written by other tools may hash differently, the first export
+  // tells whether the stored hashes can be trusted
+  uint8_t const *table = data + tables.m_export_offset;
+  char const *first = rel_rso_string(data, size, tables.m_export_names, read_be32(table));
+  bool trusted = first != nullptr && rel_elf_hash(first) == read_be32(table + offsetof(rso_export, hash));
+
+  m_symbols.reserve(m_symbols.size() + count);
+  for ( uint32_t i = 0; i < count; ++i )
+  {
+    uint8_t const *p = table + i*sizeof(rso_export);
+    char const *name = rel_rso_string(data, size, tables.m_export_names, read_be32(p));
+    if ( name == nullptr )
+      continue;
+
+    uint32_t offset  = read_be32(p + offsetof(rso_export, offset));
+    uint32_t section = read_be32(p + offsetof(rso_export, section));
+
+    symbol s;
+    s.m_hash = trusted ? read_be32(p + offsetof(rso_export, hash)) : rel_elf_hash(name);
+    s.m_name = static_cast<uint32_t>(m_arena.size());
+    s.m_next = NO_SYMBOL;
+    s.m_export.m_module  = module;
+    if ( bases == nullptr )
+      s.m_export.m_address = offset;
+    else
+      s.m_export.m_address = section < num_bases && bases[section] != 0 ? bases[section] + offset : 0;
+    m_symbols.push_back(s);
+
+    m_arena.insert(m_arena.end(), name, name + strlen(name) + 1);
+  }
+  return true;
+}
+
+void rel_export_index::build()
+{
+  // A power of two of at least one bucket per symbol keeps chains short
+  size_t count = 1;
+  while ( count < m_symbols.size() )
+    count <<= 1;
+  m_buckets.assign(count, NO_SYMBOL);
+
+  // Chained in reverse so that the first module exporting a name wins
+  for ( size_t i = m_symbols.size(); i-- > 0; )
+  {
+    uint32_t &bucket = m_buckets[m_symbols[i].m_hash & (count - 1)];
+    m_symbols[i].m_next = bucket;
+    bucket = static_cast<uint32_t>(i);
+  }
+}
+
+bool rel_export_index::find(char const *name, rel_export &out) const
+{
+  if ( m_buckets.empty() )
+    return false;
+
+  uint32_t hash = rel_elf_hash(name);
+  for ( uint32_t i = m_buckets[hash & (m_buckets.size() - 1)]; i != NO_SYMBOL; i = m_symbols[i].m_next )
+  {
+    symbol const &s = m_symbols[i];
+    if ( s.m_hash == hash && strcmp(&m_arena[s.m_name], name) == 0 )
+    {
+      out = s.m_export;
+      return true;
+    }
+  }
+  return false;
+}
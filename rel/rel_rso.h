@@ -0,0 +1,95 @@
+#ifndef __REL_RSO_H__
+#define __REL_RSO_H__
+
+#include "rel_format.h"
+#include "rel_decode.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#define RSO_PATTERN "*.rso"
+#define SEL_PATTERN "*.sel"
+#define RSO_UNRESOLVED 0xFFFFFFFF   // module of imports nothing exports
+
+// Tables of an RSO or SEL header, in host order
+struct rel_rso_tables
+{
+  uint32_t m_name_offset;
+  uint32_t m_name_size;
+  uint32_t m_internal_offset;
+  uint32_t m_internal_size;
+  uint32_t m_external_offset;
+  uint32_t m_external_size;
+  uint32_t m_export_offset;
+  uint32_t m_export_size;
+  uint32_t m_export_names;
+  uint32_t m_import_offset;
+  uint32_t m_import_size;
+  uint32_t m_import_names;
+};
+
+// Reads the tables of a header that passed rso_probe_header
+void rel_rso_read_tables(uint8_t const *header, rel_rso_tables &out);
+
+// Module name stored in the file, without its extension. Empty if none.
+std::string rel_rso_module_name(uint8_t const *data, size_t size, rel_rso_tables const &tables);
+
+// Name at offset in the string table at names, nullptr if it doesn't end
+// within the file
+char const *rel_rso_string(uint8_t const *data, size_t size, uint32_t names, uint32_t offset);
+
+// ELF hash of a symbol name, as stored in the export tables
+uint32_t rel_elf_hash(char const *name);
+
+// Decodes count ELF style relocations into out. Sites are found among the
+// sections of the module being patched. Internal relocations target the
+// section named by their symbol, symbols receives the symbol of each
+// relocation (the import for external ones).
+rel_decode_result rel_decode_rso(uint8_t const *data, uint32_t count,
+                                 section_entry const *sections, size_t num_sections,
+                                 bool internal, rel_stream &out, std::vector<uint32_t> &symbols);
+
+// Where an imported name resolved to
+struct rel_export
+{
+  uint32_t m_module;
+  uint32_t m_address;   // 0 if the symbol has no address (bss)
+};
+
+// Exports of many modules in one chained hash table. Buckets are keyed by
+// the ELF hashes the export tables already store, so adding a module
+// hashes nothing and resolving an import hashes its name once and looks
+// at a single bucket, instead of comparing it against every export.
+class rel_export_index
+{
+public:
+  rel_export_index();
+
+  // Adds the exports of an RSO or SEL image of size bytes. bases holds the
+  // address of each section of an RSO, a SEL (bases is nullptr) exports
+  // absolute addresses.
+  bool add_module(uint32_t module, uint8_t const *data, size_t size, rel_rso_tables const &tables,
+                  uint32_t const *bases, size_t num_bases);
+
+  // Lays out the buckets, needed after adding modules
+  void build();
+  void clear();
+
+  bool find(char const *name, rel_export &out) const;
+  size_t size() const;
+
+private:
+  struct symbol
+  {
+    uint32_t m_hash;
+    uint32_t m_name;      // offset into m_arena
+    uint32_t m_next;      // next symbol of the bucket
+    rel_export m_export;
+  };
+
+  std::vector<symbol> m_symbols;
+  std::vector<uint32_t> m_buckets;    // first symbol of each bucket
+  std::vector<char> m_arena;
+};
+
+#endif // #ifndef __REL_RSO_H__
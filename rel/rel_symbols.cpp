@@ -0,0 +1,96 @@
+#include "rel_symbols.h"
+#include <cstring>
+
+#define TREES_PER_MODULE 256
+
+rel_symbol_index::rel_symbol_index()
+{}
+
+void rel_symbol_index::clear()
+{
+  m_starts.clear();
+  m_sizes.clear();
+  m_names.clear();
+  m_arena.clear();
+  m_trees.clear();
+}
+
+size_t rel_symbol_index::size() const
+{
+  return m_starts.size();
+}
+
+size_t rel_symbol_index::fill(rel_map const &map, size_t base, size_t i, size_t k, tree const &t)
+{
+  if ( k > t.m_count )
+    return i;
+
+  // In-order walk of the implicit tree hands out the sorted symbols
+  i = this->fill(map, base, i, 2 * k, t);
+
+  rel_map_symbol const &symbol = map.get_symbol(base + i);
+  char const *name = map.get_name(symbol);
+  size_t slot = t.m_first + k - 1;
+  m_starts[slot] = symbol.m_offset;
+  m_sizes[slot]  = symbol.m_size;
+  m_names[slot]  = static_cast<uint32_t>(m_arena.size());
+  m_arena.insert(m_arena.end(), name, name + strlen(name) + 1);
+  ++i;
+
+  return this->fill(map, base, i, 2 * k + 1, t);
+}
+
+void rel_symbol_index::add_module(uint32_t module, rel_map const &map)
+{
+  if ( m_trees.size() < (module + 1) * TREES_PER_MODULE )
+  {
+    tree empty = { 0, 0 };
+    m_trees.resize((module + 1) * TREES_PER_MODULE, empty);
+  }
+
+  // The map is sorted by section, each run of a section becomes a tree
+  size_t count = map.size();
+  for ( size_t a = 0, b = 0; a < count; a = b )
+  {
+    uint8_t section = map.get_symbol(a).m_section;
+    for ( b = a; b < count && map.get_symbol(b).m_section == section; ++b )
+      ;
+
+    tree &t = m_trees[module * TREES_PER_MODULE + section];
+    t.m_first = static_cast<uint32_t>(m_starts.size());
+    t.m_count = static_cast<uint32_t>(b - a);
+    m_starts.resize(m_starts.size() + t.m_count);
+    m_sizes.resize(m_sizes.size() + t.m_count);
+    m_names.resize(m_names.size() + t.m_count);
+    this->fill(map, a, 0, 1, t);
+  }
+}
+
+char const *rel_symbol_index::find(uint32_t module, uint8_t section, uint32_t offset, uint32_t &delta) const
+{
+  size_t index = static_cast<size_t>(module) * TREES_PER_MODULE + section;
+  if ( index >= m_trees.size() )
+    return nullptr;
+
+  tree const &t = m_trees[index];
+  uint32_t const *starts = m_starts.data() + t.m_first;
+
+  // Descend, remembering the last node that is at or below offset. That
+  // node is the predecessor.
+  size_t k = 1;
+  size_t best = 0;
+  while ( k <= t.m_count )
+  {
+    size_t right = starts[k - 1] <= offset;
+    best = right ? k : best;
+    k = 2 * k + right;
+  }
+  if ( best == 0 )
+    return nullptr;
+
+  size_t slot = t.m_first + best - 1;
+  delta = offset - m_starts[slot];
+  if ( m_sizes[slot] != 0 && delta >= m_sizes[slot] )
+    return nullptr;
+  return &m_arena[m_names[slot]];
+}
@@ -0,0 +1,46 @@
+#ifndef __REL_SYMBOLS_H__
+#define __REL_SYMBOLS_H__
+
+#include "rel_map.h"
+#include <vector>
+
+// Read-only "nearest symbol at or below" lookup over the maps of many
+// modules. The symbol starts of each (module, section) are stored in
+// Eytzinger (breadth first) order, so a search walks the top of the tree
+// in the same few cache lines and needs no branches. Names of all modules
+// share one string arena.
+class rel_symbol_index
+{
+public:
+  rel_symbol_index();
+
+  // Adds the symbols of a module, module being a dense id
+  void add_module(uint32_t module, rel_map const &map);
+  void clear();
+
+  // Finds the symbol starting at or below offset that also covers it (or
+  // has no size). Returns its name and sets delta to offset - start, or
+  // returns nullptr if there is none.
+  char const *find(uint32_t module, uint8_t section, uint32_t offset, uint32_t &delta) const;
+
+  size_t size() const;
+
+private:
+  // Symbols of one section, at [m_first, m_first + m_count) of the arrays
+  struct tree
+  {
+    uint32_t m_first;
+    uint32_t m_count;
+  };
+
+  // Lays out the sorted symbols of map from index base in Eytzinger order
+  size_t fill(rel_map const &map, size_t base, size_t i, size_t k, tree const &t);
+
+  std::vector<uint32_t> m_starts;     // Eytzinger order within each tree
+  std::vector<uint32_t> m_sizes;
+  std::vector<uint32_t> m_names;      // offsets into m_arena
+  std::vector<char> m_arena;
+  std::vector<tree> m_trees;          // module * 256 + section
+};
+
+#endif // #ifndef __REL_SYMBOLS_H__
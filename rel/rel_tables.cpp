@@ -0,0 +1,129 @@
+#include "rel_tables.h"
+
+#define EMPTY_KEY    0xFFFFFFFFFFFFFFFFull
+#define INITIAL_BITS 8
+
+uint32_t rel_name_table::intern(std::string const &name)
+{
+  auto it = m_ids.find(name);
+  if ( it != m_ids.end() )
+    return it->second;
+
+  uint32_t id = static_cast<uint32_t>(m_names.size());
+  m_names.push_back(name);
+  m_ids.insert(std::make_pair(name, id));
+  return id;
+}
+
+uint32_t rel_name_table::find(std::string const &name) const
+{
+  auto it = m_ids.find(name);
+  return it == m_ids.end() ? REL_NO_NAME : it->second;
+}
+
+std::string const &rel_name_table::get_name(uint32_t id) const
+{
+  return m_names[id];
+}
+
+size_t rel_name_table::size() const
+{
+  return m_names.size();
+}
+
+void rel_name_table::clear()
+{
+  m_names.clear();
+  m_ids.clear();
+}
+
+rel_slot_table::rel_slot_table()
+{
+  this->clear();
+}
+
+uint64_t rel_slot_table::make_key(uint32_t module, uint32_t packed)
+{
+  return (static_cast<uint64_t>(module) << 32) | packed;
+}
+
+size_t rel_slot_table::slot_of(uint64_t key) const
+{
+  // Fibonacci hashing, the top bits are the best mixed
+  return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> m_shift);
+}
+
+uint32_t rel_slot_table::insert(uint32_t module, uint32_t packed, uint32_t value, bool &inserted)
+{
+  // Keep the load factor at or below one half
+  if ( (m_size + 1) * 2 > m_keys.size() )
+    this->grow();
+
+  uint64_t key = make_key(module, packed);
+  size_t mask = m_keys.size() - 1;
+  for ( size_t i = this->slot_of(key); ; i = (i + 1) & mask )
+  {
+    if ( m_keys[i] == key )
+    {
+      inserted = false;
+      return m_values[i];
+    }
+    if ( m_keys[i] == EMPTY_KEY )
+    {
+      m_keys[i] = key;
+      m_values[i] = value;
+      ++m_size;
+      inserted = true;
+      return value;
+    }
+  }
+}
+
+uint32_t rel_slot_table::find(uint32_t module, uint32_t packed) const
+{
+  uint64_t key = make_key(module, packed);
+  size_t mask = m_keys.size() - 1;
+  for ( size_t i = this->slot_of(key); ; i = (i + 1) & mask )
+  {
+    if ( m_keys[i] == key )
+      return m_values[i];
+    if ( m_keys[i] == EMPTY_KEY )
+      return 0;
+  }
+}
+
+size_t rel_slot_table::size() const
+{
+  return m_size;
+}
+
+void rel_slot_table::clear()
+{
+  m_keys.assign(size_t(1) << INITIAL_BITS, EMPTY_KEY);
+  m_values.assign(size_t(1) << INITIAL_BITS, 0);
+  m_size = 0;
+  m_shift = 64 - INITIAL_BITS;
+}
+
+void rel_slot_table::grow()
+{
+  std::vector<uint64_t> keys(m_keys.size() * 2, EMPTY_KEY);
+  std::vector<uint32_t> values(m_values.size() * 2, 0);
+  keys.swap(m_keys);
+  values.swap(m_values);
+  --m_shift;
+
+  // Reinsert everything into the larger arrays
+  size_t mask = m_keys.size() - 1;
+  for ( size_t k = 0; k < keys.size(); ++k )
+  {
+    if ( keys[k] == EMPTY_KEY )
+      continue;
+
+    size_t i = this->slot_of(keys[k]);
+    while ( m_keys[i] != EMPTY_KEY )
+      i = (i + 1) & mask;
+    m_keys[i] = keys[k];
+    m_values[i] = values[k];
+  }
+}
@@ -0,0 +1,57 @@
+#ifndef __REL_TABLES_H__
+#define __REL_TABLES_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define REL_NO_NAME 0xFFFFFFFF
+
+// Interns strings into dense ids, so that hot loops can index arrays
+// instead of hashing or comparing names
+class rel_name_table
+{
+public:
+  uint32_t intern(std::string const &name);
+  uint32_t find(std::string const &name) const;   // REL_NO_NAME if unknown
+
+  std::string const &get_name(uint32_t id) const;
+  size_t size() const;
+  void clear();
+
+private:
+  std::vector<std::string> m_names;
+  std::unordered_map<std::string, uint32_t> m_ids;
+};
+
+// Open addressing hash table from (module id, packed section/offset) to
+// an import slot address, with linear probing over flat arrays
+class rel_slot_table
+{
+public:
+  rel_slot_table();
+
+  // Inserts the key if it's new. Returns the value stored for the key,
+  // inserted tells whether value was used.
+  uint32_t insert(uint32_t module, uint32_t packed, uint32_t value, bool &inserted);
+
+  // Returns the value of the key, or 0 if it's not present
+  uint32_t find(uint32_t module, uint32_t packed) const;
+
+  size_t size() const;
+  void clear();
+
+private:
+  static uint64_t make_key(uint32_t module, uint32_t packed);
+  size_t slot_of(uint64_t key) const;
+  void grow();
+
+  std::vector<uint64_t> m_keys;
+  std::vector<uint32_t> m_values;
+  size_t m_size;
+  unsigned m_shift;   // 64 - log2(capacity)
+};
+
+#endif // #ifndef __REL_TABLES_H__
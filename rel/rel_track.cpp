@@ -1,20 +1,107 @@
 #include "rel_track.h"
+#include "rel_index.h"
+#include "rel_link.h"
+#include "rel_cache.h"
+#include "../loader/ldr_trace.h"
+#include <cstdlib>
+#include <cstring>
 #include <string>
-#include <sstream>
 #include <iomanip>
 #include <fstream>
 #include <utility>
 #include <algorithm>
+#include <iterator>
 #include <set>
+#include <chrono>
 
 rel_track::rel_track()
-  : m_valid(false)
+  : m_align(0)
+  , m_bss_align(0)
+  , m_valid(false)
+  , m_rso(false)
+  , m_compressed(false)
+  , m_header_size(sizeof(relhdr))
+  , m_partial(false)
+  , m_section_addresses()
+  , m_link(nullptr)
+  , m_link_module(nullptr)
+  , m_use_cache(false)
+  , m_module_hash(0)
 {}
 
 rel_track::rel_track(linput_t *p_input)
- : m_valid(false)
- , m_max_filesize( qlsize(p_input) )
+ : m_align(0)
+ , m_bss_align(0)
+ , m_valid(false)
+ , m_rso(false)
+ , m_compressed(false)
+ , m_header_size(sizeof(relhdr))
+ , m_max_filesize( static_cast<uint32_t>(qlsize(p_input)) )
  , m_input_file(p_input)
+ , m_partial(false)
+ , m_section_addresses()
+ , m_link(nullptr)
+ , m_link_module(nullptr)
+ , m_use_cache(false)
+ , m_module_hash(0)
+{
+  this->parse();
+}
+
+rel_track::rel_track(char const *path)
+ : m_align(0)
+ , m_bss_align(0)
+ , m_valid(false)
+ , m_rso(false)
+ , m_compressed(false)
+ , m_header_size(sizeof(relhdr))
+ , m_max_filesize(0)
+ , m_input_file(nullptr)
+ , m_partial(false)
+ , m_section_addresses()
+ , m_link(nullptr)
+ , m_link_module(nullptr)
+ , m_use_cache(false)
+ , m_module_hash(0)
+{
+  // Map the whole file, all later reads are served from memory
+  if (!m_input.open(path))
+  {
+    err_msg("REL: Unable to open %s", path);
+    return;
+  }
+  m_max_filesize = m_input.get_size();
+
+  this->parse();
+}
+
+rel_track::rel_track(uint8_t const *data, uint32_t size)
+ : m_align(0)
+ , m_bss_align(0)
+ , m_valid(false)
+ , m_rso(false)
+ , m_compressed(false)
+ , m_header_size(sizeof(relhdr))
+ , m_max_filesize(size)
+ , m_input_file(nullptr)
+ , m_partial(false)
+ , m_section_addresses()
+ , m_link(nullptr)
+ , m_link_module(nullptr)
+ , m_use_cache(false)
+ , m_module_hash(0)
+{
+  // Served from the caller's memory like a mapped file
+  if (!m_input.view(data, size))
+  {
+    err_msg("REL: Module is out of the image");
+    return;
+  }
+
+  this->parse();
+}
+
+void rel_track::parse()
 {
   // Read full header
   if (!this->read_header())
@@ -40,13 +127,46 @@ rel_track::rel_track(linput_t *p_input)
   m_valid = true;
 }
 
+bool rel_track::load_window(uint32_t begin, uint32_t end)
+{
+  // Mapped files are always fully in view
+  if (m_input_file == nullptr)
+    return begin <= end && m_input.contains(begin, end - begin);
+
+  return m_input.read(m_input_file, begin, end);
+}
+
+bool rel_track::inflate_input()
+{
+  ldr_scope trace("inflate");
+
+  // The whole module is decompressed into memory and served from there
+  if (!this->load_window(0, m_max_filesize) || !m_input.inflate())
+    return err_msg("REL: Unable to decompress the Yaz0 data");
+
+  ldr_count(LDR_INFLATED_BYTES, m_input.get_size());
+  m_compressed   = true;
+  m_input_file   = nullptr;
+  m_max_filesize = m_input.get_size();
+  return true;
+}
+
 bool rel_track::read_header()
 {
-  // Read header data from input
-  relhdr base_header;
-  qlseek(m_input_file, 0, SEEK_SET);
-  if (qlread(m_input_file, &base_header, sizeof(base_header)) != sizeof(base_header))
+  if (m_max_filesize >= YAZ0_HEADER_SIZE && this->load_window(0, YAZ0_HEADER_SIZE) &&
+      read_be32(m_input.data(0, YAZ0_HEADER_SIZE)) == YAZ0_MAGIC && !this->inflate_input())
+    return false;
+
+  // Read header data from input, enough for either format. RSO and REL
+  // headers can't be mistaken for one another.
+  uint32_t peek = std::min<uint32_t>(sizeof(rsohdr), m_max_filesize);
+  if (peek < sizeof(relhdr) || !this->load_window(0, peek))
     return err_msg("REL: header is too short or inaccessible");
+  if (rso_probe_header(m_input.data(0, peek), peek, m_max_filesize))
+    return this->read_rso_header(m_input.data(0, peek));
+
+  relhdr base_header;
+  memcpy(&base_header, m_input.data(0, sizeof(base_header)), sizeof(base_header));
 
   // Convert all members from big endian to little endian
   m_id             = swap32(base_header.info.id);
@@ -76,9 +196,11 @@ bool rel_track::read_header()
   m_unresolved_prep.m_offset      = swap32(base_header.unresolved_offset);
   m_unresolved_prep.m_section_id  = base_header.unresolved_section;
 
-  // TODO: v2 check
-  //m_base_header.align               = swap32(base_header.align);
-  //m_base_header.bss_align           = swap32(base_header.bss_align);
+  if (m_version >= 2)
+  {
+    m_align     = swap32(base_header.align);
+    m_bss_align = swap32(base_header.bss_align);
+  }
   
   // TODO: v3 check
   //m_base_header.fix_size            = swap32(base_header.fix_size);
@@ -86,20 +208,57 @@ bool rel_track::read_header()
   return true;
 }
 
+bool rel_track::read_rso_header(uint8_t const *header)
+{
+  // RSOs have no id, init_exports numbers them
+  m_rso = true;
+  m_header_size    = sizeof(rsohdr);
+  m_id             = 0;
+  m_num_sections   = read_be32(header + offsetof(rsohdr, num_sections));
+  m_section_offset = read_be32(header + offsetof(rsohdr, section_offset));
+  m_version        = read_be32(header + offsetof(rsohdr, version));
+  m_bss_size       = read_be32(header + offsetof(rsohdr, bss_size));
+  m_bss_section_ign = header[offsetof(rsohdr, bss_section)];
+
+  m_prolog_prep.m_offset         = read_be32(header + offsetof(rsohdr, prolog_offset));
+  m_prolog_prep.m_section_id     = header[offsetof(rsohdr, prolog_section)];
+  m_epilog_prep.m_offset         = read_be32(header + offsetof(rsohdr, epilog_offset));
+  m_epilog_prep.m_section_id     = header[offsetof(rsohdr, epilog_section)];
+  m_unresolved_prep.m_offset     = read_be32(header + offsetof(rsohdr, unresolved_offset));
+  m_unresolved_prep.m_section_id = header[offsetof(rsohdr, unresolved_section)];
+
+  // The REL import table and relocations have no counterpart
+  m_rel_offset    = 0;
+  m_import_offset = 0;
+  m_import_size   = 0;
+
+  rel_rso_read_tables(header, m_rso_tables);
+
+  // The name is usually right after the header
+  uint32_t name_end = m_rso_tables.m_name_offset + m_rso_tables.m_name_size;
+  if (m_rso_tables.m_name_size != 0 && this->load_window(0, std::max<uint32_t>(name_end, sizeof(rsohdr))))
+    m_rso_name = rel_rso_module_name(m_input.data(0, name_end), name_end, m_rso_tables);
+  if (m_rso_name.empty())
+    m_rso_name = "module";
+  return true;
+}
+
 bool rel_track::read_sections()
 {
+  // Pull in the whole section table at once
+  uint32_t table_size = m_num_sections * sizeof(section_entry);
+  if (!this->load_window(m_section_offset, m_section_offset + table_size))
+    return err_msg("REL: Failed to read the section table");
+  uint8_t const *table = m_input.data(m_section_offset, table_size);
+
   // Read each section
-  qlseek(m_input_file, m_section_offset, SEEK_SET);
+  m_sections.reserve(m_num_sections);
   for (unsigned i = 0; i < m_num_sections; ++i)
   {
     // read an entry
     section_entry entry;
-    if (qlread(m_input_file, &entry, sizeof(entry)) != sizeof(entry))
-      return err_msg("REL: Failed to read section %u", i);
-
-    // Swap endianness
-    entry.file_offset  = swap32(entry.file_offset);
-    entry.size    = swap32(entry.size);
+    entry.file_offset  = read_be32(table + i*sizeof(section_entry));
+    entry.size         = read_be32(table + i*sizeof(section_entry) + 4);
 
     if (entry.file_offset == 0 && entry.size != 0)   // bss
     {
@@ -114,13 +273,17 @@ bool rel_track::read_sections()
     }
     m_sections.emplace_back(entry);
   }
+
+  // A .sel only describes the main program, its sections are in the DOL
+  if (m_rso && std::none_of(m_sections.begin(), m_sections.end(), [](section_entry const &e) { return SECTION_OFF(e.file_offset) != 0; }))
+    return err_msg("RSO: The module has no section data, a .sel only describes main.dol");
   return true;
 }
 
 bool rel_track::validate_header() const
 {
   // Check for absurd amount of sections
-  if (m_num_sections > 32 || m_num_sections <= 1)
+  if (m_num_sections > (m_rso ? RSO_MAX_SECTIONS : 32) || m_num_sections <= 1)
     return err_msg("REL: Unlikely number of sections (%u)", m_num_sections);
 
   // Check section boundary
@@ -128,16 +291,41 @@ bool rel_track::validate_header() const
     return err_msg("REL: Section has overlapping or out of bounds offset (%u entries)", m_num_sections);
 
   // Check version
-  if (m_version <= 0 || m_version > 3)
+  if (m_version <= 0 || m_version > (m_rso ? 1u : 3u))
     return err_msg("REL: Unknown version (%u)", m_version);
 
   return true;
 }
 
+bool rel_track::decode_relocations(import_entry const &entry, rel_stream &out) const
+{
+  uint8_t const *data = entry.offset <= m_max_filesize ? m_input.data(entry.offset, m_max_filesize - entry.offset) : nullptr;
+  if (data == nullptr)
+    return err_msg("REL: Relocations for module %u are out of bounds @0x%08X", entry.id, entry.offset);
+
+  std::vector<uint32_t> sizes(m_sections.size());
+  for (size_t i = 0; i < m_sections.size(); ++i)
+    sizes[i] = m_sections[i].size;
+
+  rel_decode_result result = rel_decode_stream(data, m_max_filesize - entry.offset, sizes.data(), sizes.size(), out);
+  uint32_t where = entry.offset + result.m_record * sizeof(rel_entry);
+  switch (result.m_status)
+  {
+  case REL_DECODE_UNTERMINATED:
+    return err_msg("REL: Relocations for module %u are not terminated @0x%08X", entry.id, entry.offset);
+  case REL_DECODE_BAD_SECTION:
+    return err_msg("REL: Relocation @0x%08X switches to an invalid section", where);
+  case REL_DECODE_OUT_OF_BOUNDS:
+    return err_msg("REL: Relocation @0x%08X patches outside of its section", where);
+  default:
+    return true;
+  }
+}
+
 bool rel_track::verify_section(uint32_t offset, uint32_t size) const
 {
   offset = SECTION_OFF(offset);
-  return sizeof(relhdr) <= offset && (offset + size) <= m_max_filesize;
+  return m_header_size <= offset && (offset + size) <= m_max_filesize;
 }
 
 bool rel_track::is_good() const
@@ -145,6 +333,68 @@ bool rel_track::is_good() const
   return m_valid;
 }
 
+bool rel_track::is_rso() const
+{
+  return m_rso;
+}
+
+bool rel_track::is_compressed() const
+{
+  return m_compressed;
+}
+
+void rel_track::rebind(linput_t *p_input)
+{
+  // Decompressed modules have no file behind them
+  if (m_compressed)
+    return;
+
+  m_input_file = p_input;
+  m_input.close();
+}
+
+uint32_t rel_track::get_id() const
+{
+  return m_id;
+}
+
+std::vector<section_entry> const &rel_track::get_sections() const
+{
+  return m_sections;
+}
+
+uint32_t rel_track::get_align() const
+{
+  return m_align;
+}
+
+uint32_t rel_track::get_bss_align() const
+{
+  return m_bss_align;
+}
+
+uint32_t rel_track::get_file_size() const
+{
+  return m_max_filesize;
+}
+
+bool rel_track::link(rel_link const &game)
+{
+  rel_link_module const *module = game.find(m_id);
+  if (module == nullptr || module->m_sections.size() != m_sections.size())
+    return err_msg("REL: Module %u has no place in the linked game", m_id);
+
+  m_link = &game;
+  m_link_module = module;
+
+  // Own symbols still come from the module's map
+  m_directory = game.get_directory();
+  m_maps.clear();
+  m_module_names.clear();
+  m_module_names[m_id] = module->m_name;
+  return true;
+}
+
 /*section_entry const * rel_track::get_section(uint entry_id) const
 {
   if (entry_id < m_sections.size())
@@ -157,35 +407,160 @@ bool rel_track::is_good() const
 
 ea_t rel_track::section_address(uint8_t section, uint32_t offset) const
 {
-  auto it = m_segment_address_map.find(section);
-  if ( it == m_segment_address_map.end() )
+  uint32_t base = m_section_addresses[section];
+  if ( base == 0 )
     return BADADDR;
-  return it->second + offset;
+  return base + offset;
 }
 
-bool rel_track::apply_patches(bool dry_run)
+// Seconds elapsed since start
+static double elapsed(std::chrono::steady_clock::time_point const &start)
 {
-  if ( !this->create_sections(dry_run) )
-    return err_msg("Creating sections failed");
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string strfmt(char const *format, ...)
+{
+  char buf[MAXSTR];
+  va_list va;
+  va_start(va, format);
+  qvsnprintf(buf, sizeof(buf), format, va);
+  va_end(va);
+  return buf;
+}
+
+bool rel_track::apply_patches(bool dry_run, bool reload)
+{
+  ldr_scope trace("apply_patches");
+  m_plan.clear();
+  m_references.clear();
+  m_section_buffers.clear();
+  m_partial = false;
+
+  // A REL reloaded into the database only plans the runs that changed
+  // since its last load, an RSO is planned whole and compared after
+  bool incremental = reload && !dry_run && !m_rso;
+  rel_reload_state previous;
+  rel_reload_state current;
+
+  // Siblings are only listed here, a matching plan cache saves the rest
+  auto start = std::chrono::steady_clock::now();
+  bool cached = false;
+  if ( m_rso )
+  {
+    // RSOs have no ids to key the plan cache with
+    this->init_exports();
+  }
+  else if ( m_link == nullptr )
+  {
+    this->init_resolvers(!dry_run); // initialize user-names
+    ldr_scope trace_cache("load_plan_cache");
+    cached = m_use_cache && !incremental && this->load_plan_cache();
+  }
+
+  if ( !cached )
+  {
+    {
+      ldr_scope trace_sections("create_sections");
+      if ( !this->create_sections() )
+        return err_msg("Creating sections failed");
+    }
+    m_plan.m_seconds[REL_PHASE_SECTIONS] = elapsed(start);
+
+    start = std::chrono::steady_clock::now();
+    if ( incremental )
+    {
+      ldr_scope trace_reload("plan_reload");
+      if ( !this->plan_reload(previous, current) )
+        return false;
+    }
+    {
+      ldr_scope trace_relocations("apply_relocations");
+      bool applied;
+      if ( m_rso )
+        applied = this->apply_rso_relocations();
+      else if ( m_link != nullptr )
+        applied = this->apply_linked_relocations();
+      else
+        applied = this->apply_relocations();
+      if ( !applied )
+        return err_msg("Relocations failed");
+      this->plan_offsets();
+    }
+    m_plan.m_seconds[REL_PHASE_RELOCATIONS] = elapsed(start);
 
-  if ( !this->apply_relocations(dry_run) )
-    return err_msg("Relocations failed");
+    // TODO: Create Imports
 
-  // TODO: Create Imports
+    // TODO: Assign function names
+    start = std::chrono::steady_clock::now();
+    {
+      ldr_scope trace_names("apply_names");
+      if ( !this->apply_names() )
+        return err_msg("Naming failed");
+    }
+    m_plan.m_seconds[REL_PHASE_NAMES] = elapsed(start);
+
+    // Partial plans aren't worth keeping, and dry runs leave no files
+    if ( !dry_run && m_use_cache && m_link == nullptr && !m_rso && !m_partial )
+    {
+      ldr_scope trace_cache("save_plan_cache");
+      this->save_plan_cache();
+    }
+  }
+  else
+  {
+    m_plan.m_seconds[REL_PHASE_SECTIONS] = elapsed(start);
+  }
+  this->trace_plan();
 
-  // TODO: Assign function names
-  if ( !this->apply_names(dry_run) )
-    return err_msg("Naming failed");
+  // Only now touch the database
+  if ( !dry_run )
+  {
+    ldr_scope trace_commit(reload ? "commit_changes" : "commit_plan");
+    start = std::chrono::steady_clock::now();
+    if ( !(reload ? this->commit_changes(previous, current) : this->commit_plan()) )
+      return err_msg("Writing to the database failed");
+    m_plan.m_seconds[REL_PHASE_COMMIT] = elapsed(start);
+  }
 
+  msg("REL: %s%s%u segments, %u patches, %u import slots, %u comments, %u functions, %u offsets (%.3fs sections, %.3fs relocations, %.3fs names, %.3fs commit)\n",
+      dry_run ? "Dry run: " : "", cached ? "Cached: " : "",
+      static_cast<unsigned>(m_plan.m_segments.size()),
+      static_cast<unsigned>(m_plan.m_patches.size()),
+      static_cast<unsigned>(m_plan.m_slots.size()),
+      static_cast<unsigned>(m_plan.m_comments.size() + m_plan.m_program_comments.size()),
+      static_cast<unsigned>(m_plan.m_functions.size()),
+      static_cast<unsigned>(m_plan.m_offsets.size()),
+      m_plan.m_seconds[REL_PHASE_SECTIONS], m_plan.m_seconds[REL_PHASE_RELOCATIONS],
+      m_plan.m_seconds[REL_PHASE_NAMES], m_plan.m_seconds[REL_PHASE_COMMIT]);
   return true;
 }
 
+rel_load_plan const &rel_track::get_plan() const
+{
+  return m_plan;
+}
+
+// Relocations by type and patches by the module they resolve against
+void rel_track::trace_plan() const
+{
+  ldr_trace &trace = ldr_trace::get();
+  for (unsigned type = 0; type < 256; ++type)
+  {
+    if (m_plan.m_stats.m_per_type[type] != 0)
+      trace.count_type(static_cast<uint8_t>(type), m_plan.m_stats.m_per_type[type], rel_type_supported(static_cast<uint8_t>(type)));
+  }
+  for (auto it = m_plan.m_runs.begin(); it != m_plan.m_runs.end(); ++it)
+    trace.count_module(it->m_module, it->m_count);
+}
+
 
-bool rel_track::create_sections(bool dry_run)
+bool rel_track::create_sections()
 {
   m_next_seg_offset = START;
+  memset(m_section_addresses, 0, sizeof(m_section_addresses));
 
-  // Create sections
+  // Plan sections
   for (size_t i = 0; i < m_sections.size(); ++i)
   {
     auto & entry = m_sections[i];
@@ -194,412 +569,1661 @@ bool rel_track::create_sections(bool dry_run)
     if ( entry.file_offset == 0 && entry.size == 0 )
       continue;
 
-    std::string type = (entry.file_offset & SECTION_EXEC) ? CLASS_CODE : CLASS_DATA;
-    std::string name = (entry.file_offset & SECTION_EXEC) ? NAME_CODE : NAME_DATA;
-    name += std::to_string(static_cast<unsigned long long>(i));
+    // Linked modules have their place in the game, others are stacked from START
+    uint32_t start = m_link_module != nullptr ? m_link_module->m_sections[i] : m_next_seg_offset;
 
-    m_segment_address_map[i] = m_next_seg_offset;   // record the loaded segment address
-    uint32_t foffset = SECTION_OFF(entry.file_offset);
-
-    // Create the segment
-    if ( foffset != 0 )  // known segment
-    {
-      //if ( foffset < m_next_seg_offset )
-        //return err_msg("Segments are not linear (seg #%u)", i);
+    rel_plan_segment segment;
+    segment.m_start = start;
+    segment.m_end   = start + entry.size;
+    segment.m_file_offset = SECTION_OFF(entry.file_offset);
 
-      if (!add_segm(1, m_next_seg_offset, m_next_seg_offset + entry.size, name.c_str(), type.c_str()))
-        return err_msg("Failed to create segment #%u", i);
+    m_section_addresses[i] = start;   // record the loaded segment address
 
-      if (!file2base(m_input_file, foffset, m_next_seg_offset, m_next_seg_offset + entry.size, FILEREG_PATCHABLE))
-        return err_msg("Failed to pull data from file (segment #%u)", i);
+    if ( segment.m_file_offset != 0 )  // known segment
+    {
+      segment.m_class = (entry.file_offset & SECTION_EXEC) ? CLASS_CODE : CLASS_DATA;
+      segment.m_name  = (entry.file_offset & SECTION_EXEC) ? NAME_CODE : NAME_DATA;
+      segment.m_name += std::to_string(static_cast<unsigned long long>(i));
     }
     else  // .bss section
     {
       m_internal_bss_section = i;
-
-      if (!add_segm(1, m_next_seg_offset, m_next_seg_offset + entry.size, NAME_BSS, CLASS_BSS))
-        return err_msg("Failed to create BSS segment #%u", i);
+      segment.m_class = CLASS_BSS;
+      segment.m_name  = NAME_BSS;
     }
 
-    set_segm_addressing(getseg(m_next_seg_offset), 1);
+    // Segments of a linked game are told apart by their module
+    if ( m_link_module != nullptr )
+      segment.m_name = m_link_module->m_name + segment.m_name;
+
+    m_plan.m_segments.emplace_back(std::move(segment));
     m_next_seg_offset += entry.size;
   }
   return true;
 }
-bool rel_track::apply_relocations(bool dry_run)
+
+bool rel_track::commit_plan()
 {
-  this->init_resolvers(); // initialize user-names
+  // Remember what is written, for reloading the module later
+  rel_reload_state state;
+  if (!this->describe_load(state))
+    return false;
 
-  // Apply relocations
-  if (m_import_offset > 0)
+  // Create the segments
+  for (size_t i = 0; i < m_plan.m_segments.size(); ++i)
   {
-    uint32_t count = m_import_size / sizeof(import_entry);
-    uint32_t desired_import_size = 0;
-    std::map< std::string, std::map<uint32_t, ea_t> > imports_map;
-    std::map< std::string, ea_t > imports_module_starts;
-    std::set<ea_t> described;
+    rel_plan_segment const &segment = m_plan.m_segments[i];
+    if (!add_segm(1, segment.m_start, segment.m_end, segment.m_name.c_str(), segment.m_class.c_str()))
+      return err_msg("Failed to create segment %s", segment.m_name.c_str());
+    ldr_count(LDR_SEGMENTS);
 
-    for (unsigned i = 0; i < count; ++i)
+    if (segment.m_file_offset != 0 && segment.m_end > segment.m_start)
     {
-      qlseek(m_input_file, m_import_offset + i*sizeof(import_entry), SEEK_SET);
+      // Mapped inputs have no handle for IDA to read from
+      bool loaded;
+      if (m_input_file != nullptr)
+        loaded = file2base(m_input_file, segment.m_file_offset, segment.m_start, segment.m_end, FILEREG_PATCHABLE) != 0;
+      else
+        loaded = mem2base(m_input.data(segment.m_file_offset, segment.m_end - segment.m_start), segment.m_start, segment.m_end, segment.m_file_offset) != 0;
+      if (!loaded)
+        return err_msg("Failed to pull data from file (segment %s)", segment.m_name.c_str());
+      ldr_count(LDR_LOADED_BYTES, segment.m_end - segment.m_start);
+    }
 
-      // Get the entry
-      import_entry entry;
-      if (qlread(m_input_file, &entry, sizeof(entry)) != sizeof(entry))
-        return err_msg("REL: Failed to read relocation data %u", i);
-      // Endianness
-      entry.offset = swap32(entry.offset);
-      entry.id = swap32(entry.id);
-
-      // Seek to relocations
-      qlseek(m_input_file, entry.offset, SEEK_SET);
-      uint32_t current_section = 0;
-      uint32_t current_offset = 0;
-      uint32_t value = 0, where = 0, orig = 0;
+    set_segm_addressing(getseg(segment.m_start), 1);
+  }
 
-      // Self-relocations
-      if ( entry.id == m_id )
+  // Relocated section contents, one write per section
+  if (!this->commit_section_buffers())
+    return false;
+  ldr_count(LDR_PATCHES, m_plan.m_patches.size());
+
+  // Import slots, filled with a single write
+  if (!m_plan.m_slots.empty())
+  {
+    uint32_t first = m_plan.m_slots.front().m_address;
+    uint32_t last  = m_plan.m_slots.front().m_address;
+    for (auto it = m_plan.m_slots.begin(); it != m_plan.m_slots.end(); ++it)
+    {
+      first = std::min(first, it->m_address);
+      last  = std::max(last, it->m_address);
+    }
+
+    std::vector<uint8_t> slots(last - first + 4);
+    for (auto it = m_plan.m_slots.begin(); it != m_plan.m_slots.end(); ++it)
+      write_be32(&slots[it->m_address - first], it->m_value);
+    put_bytes(first, slots.data(), slots.size());
+    ldr_count(LDR_WRITTEN_BYTES, slots.size());
+
+    for (auto it = m_plan.m_slots.begin(); it != m_plan.m_slots.end(); ++it)
+    {
+      force_name(it->m_address, it->m_name.c_str(), 0);
+      if (!it->m_comment.empty())
       {
-        for (;;)
-        {
-          // Read operation
-          rel_entry rel;
-          if (qlread(m_input_file, &rel, sizeof(rel)) != (sizeof(rel)))
-            return err_msg("REL: Failed to read relocation operation @0x%08X - error code: %d", qltell(m_input_file), get_qerrno());
+        add_extra_line(it->m_address, true, "%s", it->m_comment.c_str());
+        ldr_count(LDR_COMMENTS);
+      }
+    }
+    ldr_count(LDR_NAMES, m_plan.m_slots.size());
+  }
 
-          // endianness
-          rel.addend = swap32(rel.addend);
-          rel.offset = swap16(rel.offset);
+  for (auto it = m_plan.m_names.begin(); it != m_plan.m_names.end(); ++it)
+    force_name(it->m_address, it->m_text.c_str(), 0);
+  ldr_count(LDR_NAMES, m_plan.m_names.size());
 
-          // Kill if it's the end
-          if (rel.type == R_DOLPHIN_END)
-            break;
+  for (auto it = m_plan.m_comments.begin(); it != m_plan.m_comments.end(); ++it)
+    add_extra_cmt(it->m_address, true, "\n%s\n", it->m_text.c_str());
 
-          current_offset += rel.offset;
-          switch (rel.type)
-          {
-          case R_DOLPHIN_SECTION:
-            current_section = rel.section;
-            current_offset  = 0;
-            break;
-          case R_DOLPHIN_NOP:
-            break;
-          case R_PPC_ADDR32:
-            patch_dword( this->section_address(current_section, current_offset), this->section_address(rel.section, rel.addend) );
-            break;
-          case R_PPC_ADDR16_LO:
-            patch_word(this->section_address(current_section, current_offset), this->section_address(rel.section, rel.addend) & 0xFFFF);
-            break;
-          case R_PPC_ADDR16_HA:
-            value = this->section_address(rel.section, rel.addend);
-            if ((value & 0x8000) == 0x8000)
-              value += 0x00010000;
-
-            patch_word(this->section_address(current_section, current_offset), (value >> 16) & 0xFFFF);
-            break;
-          case R_PPC_REL24:
-            where = this->section_address(current_section, current_offset);
-            value = this->section_address(rel.section, rel.addend);
-            value -= where;
-            orig = static_cast<uint32_t>(get_original_dword(where));
-            orig &= 0xFC000003;
-            orig |= value & 0x03FFFFFC;
-            patch_dword(where, orig);
-            break;
-          default:
-            msg("REL: RELOC TYPE %u UNSUPPORTED\n", rel.type);
-          }
+  for (auto it = m_plan.m_program_comments.begin(); it != m_plan.m_program_comments.end(); ++it)
+    add_pgm_cmt("%s", it->c_str());
+  ldr_count(LDR_COMMENTS, m_plan.m_comments.size() + m_plan.m_program_comments.size());
 
-        }
-      }
-      else // EXTERNALS
-      {
-        // Retrieve the module name
-        std::string imp_module_name;
-        auto it_modname = m_module_names.find(entry.id);
-        if ( it_modname != m_module_names.end() )
-          imp_module_name = it_modname->second;
-        else if ( entry.id == 0 )
-          imp_module_name = BASENAME;
-        else
-          imp_module_name = std::string("module") + std::to_string(static_cast<unsigned long long>(entry.id));
+  // Make function exports
+  for (auto it = m_plan.m_entries.begin(); it != m_plan.m_entries.end(); ++it)
+    add_entry(it->m_address, it->m_address, it->m_text.c_str(), true);
+  ldr_count(LDR_ENTRIES, m_plan.m_entries.size());
 
-        // Read all imports to get the desired size
-        for (;;)
-        {
-          // Read operation
-          rel_entry rel;
-          if ( qlread(m_input_file, &rel, sizeof(rel)) != (sizeof(rel)))
-            return err_msg("REL: Failed to read relocation operation @0x%08X, id %u", qltell(m_input_file), entry.id);
+  // Make library functions (emphasis)
+  for (auto it = m_plan.m_entries.begin(); it != m_plan.m_entries.end(); ++it)
+    set_libitem(it->m_address);
 
-          // endianness
-          rel.addend = swap32(rel.addend);
-          rel.offset = swap16(rel.offset);
+  this->commit_offsets();
+  this->queue_functions();
 
-          // Kill if it's the end
-          if (rel.type == R_DOLPHIN_END)
-            break;
+  this->save_reload_state(state);
+  return true;
+}
 
-          if ( rel.type != R_DOLPHIN_SECTION && rel.type != R_DOLPHIN_NOP )
-          {
-            // Retrieve target offset for import itself
-            ea_t target_offset = m_next_seg_offset + desired_import_size;
-
-            // Also try to get a unique address for the module offset
-            uint32_t offs = this->get_external_offset(imp_module_name, rel.addend, rel.section);
-            if ( offs == 0 || offs == 1 )
-              offs = rel.addend + 0x1000000 * rel.section;
-
-            // If the address doesn't exist, then add it and get the next import location
-            if ( imports_map[imp_module_name].insert( std::make_pair(offs, target_offset) ).second )
-            {
-              imports_module_starts.insert( std::make_pair(imp_module_name, target_offset) );
-              desired_import_size += 4;
-            }
-          }
+bool rel_track::commit_changes(rel_reload_state &previous, rel_reload_state &current)
+{
+  // A module planned whole is only compared with its last load now, and
+  // all of its slots are there to compare
+  if (!m_partial)
+  {
+    if (!this->describe_input(current))
+      return false;
+    ea_t extern_start = this->section_address(SECTION_IMPORTS);
+    current.m_extern_start = extern_start == BADADDR ? 0 : static_cast<uint32_t>(extern_start);
+    if (!this->load_previous(previous, current))
+      return false;
+    rel_reload_compare(previous, current, m_id, m_link != nullptr, m_changes);
+    m_changes.m_slots = true;
+  }
 
-          m_imports[imp_module_name].emplace_back(rel);
-        }
-      }
-    } // for each module
-    
-    // Now create the import/externals section
-    uint32_t imp_offset = m_next_seg_offset;
-    m_segment_address_map[SECTION_IMPORTS] = imp_offset;
-    //section_entry import_section = { m_next_section_offset, desired_import_size };
-    m_next_seg_offset += desired_import_size;
-    
-    if (!add_segm(1, imp_offset, imp_offset + desired_import_size, NAME_EXTERN, CLASS_EXTERN))
-      return err_msg("Failed to create XTRN segment");
-    set_segm_addressing(getseg(imp_offset), 1);
-    
-    m_import_section = static_cast<uint8_t>(m_sections.size());
-    //m_sections.emplace_back(import_section);
+  // Names always come from the plan, slots and their comments only if
+  // they were planned again
+  rel_reload_state planned;
+  rel_reload_describe(m_plan, planned);
+  current.m_names = planned.m_names;
+  current.m_named.swap(planned.m_named);
+  if (m_changes.m_slots)
+  {
+    current.m_slots.swap(planned.m_slots);
+    current.m_comments = planned.m_comments;
+    current.m_commented.swap(planned.m_commented);
+  }
+  else
+  {
+    current.m_slots = previous.m_slots;
+    current.m_comments = previous.m_comments;
+    current.m_commented = previous.m_commented;
+  }
+  current.m_extern_end = current.m_extern_start != 0 ? m_next_seg_offset : 0;
 
-    // Add and parse imports
-    //ea_t targ_offset = this->section_address(m_import_section);
-    for ( auto it = m_imports.begin(); it != m_imports.end(); ++it )
+  // Sections whose contents or relocations changed, rewriting only the
+  // blocks that differ from the last load
+  unsigned sections = 0;
+  size_t written = 0;
+  for (size_t i = 0; i < m_sections.size(); ++i)
+  {
+    rel_reload_section &section = current.m_sections[i];
+    std::vector<uint64_t> const *old = i < previous.m_sections.size() ? &previous.m_sections[i].m_blocks : nullptr;
+    bool dirty = (m_changes.m_sections & (1u << (i & 31))) != 0;
+    if (!dirty || i >= m_section_buffers.size() || m_section_buffers[i].m_data.empty())
     {
-      // Add comment for module
-      ea_t target_module_start = imports_module_starts[it->first];
-      if ( target_module_start == 0 )
-        return err_msg("Failed to locate start of module imports.");
-      add_extra_cmt( target_module_start, true, "\nImports from %s\n", it->first.c_str() );
+      if (old != nullptr)
+        section.m_blocks = *old;
+      continue;
+    }
+
+    rel_section_buffer const &buffer = m_section_buffers[i];
+    rel_reload_blocks(buffer.m_data.data(), buffer.m_data.size(), section.m_blocks);
+    size_t count = section.m_blocks.size();
+    auto same = [&](size_t k) { return old != nullptr && k < old->size() && (*old)[k] == section.m_blocks[k]; };
 
-      // Iterate relocation opcodes
-      uint32_t current_offset = 0, current_section = 0;
-      for ( auto e = it->second.begin(); e != it->second.end(); ++e )
+    bool changed = false;
+    for (size_t k = 0; k < count; )
+    {
+      if (same(k))
       {
-        ea_t targ_offset; // this must be initialized for anything that isn't DOLPHIN_SECTION or DOLPHIN_NOP
-        
-        // If something is actually going to be done with the target
-        if ( e->type != R_DOLPHIN_SECTION && e->type != R_DOLPHIN_NOP )
-        {
-          // Retrieve the address that was used to map to the target import
-          uint32_t offs = this->get_external_offset(it->first, e->addend, e->section);
-          if ( offs == 0 || offs == 1 )
-            offs = e->addend + 0x1000000 * e->section;
+        ++k;
+        continue;
+      }
+      size_t end = k + 1;
+      while (end < count && !same(end))
+        ++end;
+      size_t from = k * RELOAD_BLOCK_SIZE;
+      size_t to = std::min<size_t>(end * RELOAD_BLOCK_SIZE, buffer.m_data.size());
+      put_bytes(buffer.m_start + from, &buffer.m_data[from], to - from);
+      ldr_count(LDR_PATCHES);
+      written += to - from;
+      changed = true;
+      k = end;
+    }
+    if (changed)
+      ++sections;
+  }
+  m_section_buffers.clear();
+  ldr_count(LDR_WRITTEN_BYTES, written);
 
-          // Retrieve the target offset for the import
-          targ_offset = imports_map[it->first][offs];
-          if ( targ_offset == 0 )
-            return err_msg("Import was not mapped correctly. %s %08X", it->first.c_str(), e->addend);
+  unsigned slots = 0;
+  std::vector<uint32_t> anterior;     // addresses whose anterior comments are rewritten
+  if (m_changes.m_slots)
+  {
+    // Slots past the new end went away, before the segment shrinks
+    for (size_t k = m_plan.m_slots.size(); k < previous.m_slots.size(); ++k)
+    {
+      uint32_t address = previous.m_extern_start + static_cast<uint32_t>(k * 4);
+      set_name(address, "", SN_NOWARN);
+      anterior.push_back(address);
+      ++slots;
+    }
 
-          // Name the import
-          std::ostringstream ss;
-          ss << it->first;
+    // The XTRN segment is last, it follows the number of slots
+    if (current.m_extern_end != previous.m_extern_end && current.m_extern_start != 0)
+      set_segm_end(current.m_extern_start, current.m_extern_end, SEGMOD_KEEP);
 
-          offs = this->get_external_offset(it->first, e->addend, e->section, true);   // re-obtain offs without the unique address generation
-          if ( offs == 0 )
-          {
-            if ( it->first != BASENAME )
-              ss << "_s" << static_cast<unsigned>(e->section) << '_';
-            ss << reinterpret_cast<void*>(e->addend);
-            if ( described.insert(targ_offset).second )
-              add_extra_line(targ_offset, true, "addend: %08X; section: %u;", e->addend, static_cast<unsigned>(e->section));
-          }
-          else if ( offs == 1 )
-          {
-            ss << "_s" << static_cast<unsigned>(e->section) << "_bss_" << reinterpret_cast<void*>(e->addend);
-            if ( described.insert(targ_offset).second )
-              add_extra_line(targ_offset, true, "addend: %08X; section: %u (BSS);", e->addend, static_cast<unsigned>(e->section));
-          }
-          else
-          {
-            ss << '_' << reinterpret_cast<void*>(offs);
-            if ( described.insert(targ_offset).second )
-              add_extra_line(targ_offset, true, "addend: %08X; section: %u; virtual: 0x%08X;", e->addend, static_cast<unsigned>(e->section), offs);
-          }
-          force_name(targ_offset, ss.str().c_str(), 0);
-        }
+    for (size_t k = 0; k < m_plan.m_slots.size(); ++k)
+    {
+      if (k < previous.m_slots.size() && previous.m_slots[k] == current.m_slots[k])
+        continue;
+
+      rel_plan_slot const &slot = m_plan.m_slots[k];
+      uint8_t value[4];
+      write_be32(value, slot.m_value);
+      put_bytes(slot.m_address, value, sizeof(value));
+      ldr_count(LDR_WRITTEN_BYTES, sizeof(value));
+      force_name(slot.m_address, slot.m_name.c_str(), 0);
+      ldr_count(LDR_NAMES);
+      anterior.push_back(slot.m_address);
+      ++slots;
+    }
+  }
 
-        current_offset += e->offset;
-        switch (e->type)
-        {
-        case R_DOLPHIN_SECTION:
-          current_section = e->section;
-          current_offset  = 0;
-          break;
-        case R_DOLPHIN_NOP:
-          break;
-        case R_PPC_ADDR32:
-        {
-          patch_dword( this->section_address(current_section, current_offset), targ_offset );
-          put_dword(targ_offset, e->addend);
-          break;
-        }
-        case R_PPC_ADDR16_LO:
-        {
-          patch_word(this->section_address(current_section, current_offset), targ_offset & 0xFFFF);
-          put_dword(targ_offset, e->addend);
-          break;
-        }
-        case R_PPC_ADDR16_HA:
-        {
-          ea_t value = targ_offset;
-          if ((value & 0x8000) == 0x8000)
-            value += 0x00010000;
+  if (current.m_names != previous.m_names)
+  {
+    // Names of entries and map symbols that are gone
+    std::vector<uint32_t> gone;
+    std::set_difference(previous.m_named.begin(), previous.m_named.end(), current.m_named.begin(), current.m_named.end(), std::back_inserter(gone));
+    for (auto it = gone.begin(); it != gone.end(); ++it)
+      set_name(*it, "", SN_NOWARN);
+
+    for (auto it = m_plan.m_names.begin(); it != m_plan.m_names.end(); ++it)
+      force_name(it->m_address, it->m_text.c_str(), 0);
+    for (auto it = m_plan.m_entries.begin(); it != m_plan.m_entries.end(); ++it)
+      add_entry(it->m_address, it->m_address, it->m_text.c_str(), true);
+    ldr_count(LDR_NAMES, m_plan.m_names.size());
+    ldr_count(LDR_ENTRIES, m_plan.m_entries.size());
+  }
 
-          patch_word(this->section_address(current_section, current_offset), (value >> 16) & 0xFFFF);
-          put_dword(targ_offset, e->addend);
-          break;
-        }
-        case R_PPC_REL24:
-        {
-          ea_t where = this->section_address(current_section, current_offset);
-          ea_t value = targ_offset;
-          value -= where;
-          uint32_t orig = static_cast<uint32_t>(get_original_dword(where));
-          orig &= 0xFC000003;
-          orig |= value & 0x03FFFFFC;
-          patch_dword(where, orig);
-          break;
-        }
-        default:
-          msg("REL: XTRN RELOC TYPE %u UNSUPPORTED\n", static_cast<unsigned int>(e->type));
-        }
-      }
-    } // for each import
+  // Program comments are left alone, they are only ever added
+  if (current.m_comments != previous.m_comments)
+  {
+    anterior.insert(anterior.end(), previous.m_commented.begin(), previous.m_commented.end());
+    anterior.insert(anterior.end(), current.m_commented.begin(), current.m_commented.end());
   }
-  return true;
-}
 
-bool rel_track::apply_names(bool dry_run)
-{
-  // Describe the binary header
-  add_pgm_cmt("ID: %u", m_id);
-  add_pgm_cmt("Version: %u", m_version);
-  add_pgm_cmt("%u sections @ %08X:", m_num_sections, m_section_offset);
-  for ( unsigned i = 0; i < m_sections.size(); ++i )
+  // The first slot of each module also carries the comment of the module,
+  // both are written again in the order the first load wrote them
+  std::sort(anterior.begin(), anterior.end());
+  anterior.erase(std::unique(anterior.begin(), anterior.end()), anterior.end());
+  std::map<uint32_t, std::string const *> module_comments;
+  for (auto it = m_plan.m_comments.begin(); it != m_plan.m_comments.end(); ++it)
+    module_comments[it->m_address] = &it->m_text;
+  for (auto it = anterior.begin(); it != anterior.end(); ++it)
   {
-    if ( i == m_internal_bss_section )
+    delete_extra_cmts(*it, E_PREV);
+
+    size_t k = (*it - current.m_extern_start) / 4;
+    if (current.m_extern_start != 0 && *it >= current.m_extern_start && k < m_plan.m_slots.size() &&
+        m_plan.m_slots[k].m_address == *it && !m_plan.m_slots[k].m_comment.empty())
     {
-      add_pgm_cmt("    .bss%u: %u bytes", i, m_sections[i].size);
+      add_extra_line(*it, true, "%s", m_plan.m_slots[k].m_comment.c_str());
+      ldr_count(LDR_COMMENTS);
     }
-    else if ( m_sections[i].file_offset != 0 )
+
+    auto comment = module_comments.find(*it);
+    if (comment != module_comments.end())
     {
-      if ( m_sections[i].file_offset & SECTION_EXEC )
-        add_pgm_cmt("    .text%u: %u bytes @ %08X", i, m_sections[i].size, SECTION_OFF(m_sections[i].file_offset));
-      else
-        add_pgm_cmt("    .data%u: %u bytes @ %08X", i, m_sections[i].size, SECTION_OFF(m_sections[i].file_offset));
+      add_extra_cmt(*it, true, "\n%s\n", comment->second->c_str());
+      ldr_count(LDR_COMMENTS);
     }
   }
-  add_pgm_cmt("Imports: %u bytes @ %08X", m_import_size, m_import_offset);
-  add_pgm_cmt("Relocations @ %08X", m_rel_offset);
-
-  // Obtain addresses
-  ea_t epilog_addr = section_address(m_epilog_prep.m_section_id, m_epilog_prep.m_offset);
-  ea_t prolog_addr = section_address(m_prolog_prep.m_section_id, m_prolog_prep.m_offset);
-  ea_t unresolved_addr = section_address(m_unresolved_prep.m_section_id, m_unresolved_prep.m_offset);
 
-  // Make function exports
-  add_entry(epilog_addr, epilog_addr, "_epilog", true);
-  add_entry(prolog_addr, prolog_addr, "_prolog", true);
-  add_entry(unresolved_addr, unresolved_addr, "_unresolved", true);
+  // Rewritten code may branch or point somewhere new
+  if (sections != 0)
+  {
+    this->commit_offsets();
+    this->queue_functions();
+  }
 
-  // Make library functions (emphasis)
-  set_libitem(epilog_addr);
-  set_libitem(prolog_addr);
-  set_libitem(unresolved_addr);
+  msg("REL: Reloaded %u of %u sections (%u bytes changed), %u of %u relocation runs, %u import slots\n",
+      sections, static_cast<unsigned>(m_sections.size()), static_cast<unsigned>(written),
+      static_cast<unsigned>(m_plan.m_runs.size()), static_cast<unsigned>(current.m_runs.size()), slots);
 
+  this->save_reload_state(current);
   return true;
 }
 
-int idaapi enum_modules_cb(char const * file, rel_track * owner)
+bool rel_track::describe_load(rel_reload_state &state)
 {
-  // Load the file
-  linput_t * inp = open_linput(file, false);
-  rel_track rel(inp);
+  if (!this->describe_input(state))
+    return false;
+  rel_reload_describe(m_plan, state);
 
-  // If the file is good
-  if ( rel.is_good() )
+  // Relocated contents, as they are written
+  for (size_t i = 0; i < m_sections.size() && i < m_section_buffers.size(); ++i)
   {
-    std::string basename(qbasename(file));
-    std::string modulename = basename.substr(0, basename.find_last_of('.'));
-
-    if ( rel.m_id == 0 )
-      msg("%s id is 0\n", modulename.c_str());
-    owner->m_module_names[rel.m_id] = modulename;
-    owner->m_external_modules[modulename] = rel;
+    std::vector<uint8_t> const &data = m_section_buffers[i].m_data;
+    if (!data.empty())
+      rel_reload_blocks(data.data(), data.size(), state.m_sections[i].m_blocks);
   }
 
-  // close/cleanup
-  close_linput(inp);
-  return 0;
+  ea_t extern_start = this->section_address(SECTION_IMPORTS);
+  state.m_extern_start = extern_start == BADADDR ? 0 : static_cast<uint32_t>(extern_start);
+  state.m_extern_end   = extern_start == BADADDR ? 0 : m_next_seg_offset;
+  return true;
 }
 
-void rel_track::init_resolvers()
+bool rel_track::describe_input(rel_reload_state &state)
 {
-  std::string path;
-  
-  // Retrieve the directory of the current database
-  char dir[260] = {};
-  if ( !qdirname(dir, sizeof(dir), get_path(PATH_TYPE_IDB)) )
-    msg("REL: Unable to get directory of idb file.\n");
-  path = dir;
+  // Contents of the sections as in the file, before relocating
+  std::vector<uint8_t> raw;
+  state.m_sections.resize(m_sections.size());
+  for (size_t i = 0; i < m_sections.size(); ++i)
+  {
+    rel_reload_section &section = state.m_sections[i];
+    ea_t start = this->section_address(static_cast<uint8_t>(i));
+    section.m_start = start == BADADDR ? 0 : static_cast<uint32_t>(start);
+    section.m_size  = m_sections[i].size;
+    section.m_hash  = rel_hash(nullptr, 0);
+    section.m_blocks.clear();
+
+    if (SECTION_OFF(m_sections[i].file_offset) == 0 || m_sections[i].size == 0)
+      continue;
+    if (i < m_section_buffers.size() && !m_section_buffers[i].m_data.empty())
+    {
+      section.m_hash = m_section_buffers[i].m_hash;
+      continue;
+    }
+    if (!this->read_file(SECTION_OFF(m_sections[i].file_offset), m_sections[i].size, raw))
+      return err_msg("REL: Unable to read section #%u", static_cast<unsigned>(i));
+    section.m_hash = rel_hash(raw.data(), raw.size());
+  }
 
-  // Load the module names
+  // RSOs have no runs in the file, theirs come from the plan
+  if (m_rso)
+  {
+    rel_reload_describe_runs(m_plan, state);
+    state.m_resolvers = 0;
+    return true;
+  }
+  return this->describe_runs(state);
+}
+
+bool rel_track::describe_runs(rel_reload_state &state)
+{
+  state.m_runs.clear();
+  state.m_resolvers = rel_hash(nullptr, 0);
+  if (m_import_offset == 0)
+    return true;
+
+  uint32_t count = 0;
+  uint8_t const *imports = this->read_import_table(count);
+  if (imports == nullptr)
+    return false;
+
+  // Entries importing from the same module are one run
+  std::map<uint32_t, size_t> runs;
+  for (unsigned i = 0; i < count; ++i)
+  {
+    uint32_t id     = read_be32(imports + i*sizeof(import_entry));
+    uint32_t offset = read_be32(imports + i*sizeof(import_entry) + 4);
+
+    uint8_t const *data = offset <= m_max_filesize ? m_input.data(offset, m_max_filesize - offset) : nullptr;
+    if (data == nullptr)
+      return err_msg("REL: Relocations for module %u are out of bounds @0x%08X", id, offset);
+    uint32_t sections = 0;
+    size_t size = rel_scan_stream(data, m_max_filesize - offset, sections);
+    if (size == 0)
+      return err_msg("REL: Relocations for module %u are not terminated @0x%08X", id, offset);
+
+    auto it = runs.find(id);
+    if (it == runs.end())
+    {
+      it = runs.insert(std::make_pair(id, state.m_runs.size())).first;
+      rel_reload_run run = { id, 0, rel_hash(nullptr, 0) };
+
+      // What the records resolve against: the sections of another module
+      // of a linked game, or the sibling and map the slots are named from
+      if (m_link != nullptr)
+      {
+        rel_link_module const *target = id != m_id && id != 0 ? m_link->find(id) : nullptr;
+        for (size_t k = 0; target != nullptr && k < target->m_sections.size(); ++k)
+          run.m_hash = rel_hash_u32(target->m_sections[k], run.m_hash);
+      }
+      else if (id != m_id)
+      {
+        uint64_t module = this->get_dependency_hash(strfmt("module:%u", id));
+        uint64_t map = this->get_dependency_hash("map:" + this->get_import_name(id));
+        state.m_resolvers = rel_hash(&map, sizeof(map), rel_hash(&module, sizeof(module), rel_hash_u32(id, state.m_resolvers)));
+      }
+      state.m_runs.push_back(run);
+    }
+
+    rel_reload_run &run = state.m_runs[it->second];
+    run.m_sections |= sections;
+    run.m_hash = rel_hash(data, size, run.m_hash);
+  }
+  return true;
+}
+
+bool rel_track::load_previous(rel_reload_state &previous, rel_reload_state const &current) const
+{
+  if (!this->load_reload_state(previous))
+    return err_msg("REL: Nothing is known about the previous load of module %u, it can't be reloaded", m_id);
+  if (!rel_reload_same_layout(previous, current))
+    return err_msg("REL: The sections of module %u moved or changed size, it can't be reloaded in place", m_id);
+  return true;
+}
+
+bool rel_track::plan_reload(rel_reload_state &previous, rel_reload_state &current)
+{
+  // The section buffers are read here once, relocating reuses them
+  if (!this->load_section_buffers())
+    return err_msg("REL: Failed to read back section data");
+  if (!this->describe_input(current))
+    return false;
+
+  // The XTRN segment follows the sections, if there are imports
+  current.m_extern_start = m_link == nullptr && m_import_offset > 0 ? m_next_seg_offset : 0;
+  if (!this->load_previous(previous, current))
+    return false;
+
+  rel_reload_compare(previous, current, m_id, m_link != nullptr, m_changes);
+  m_partial = true;
+  return true;
+}
+
+bool rel_track::is_replanned(uint32_t module) const
+{
+  return !m_partial || m_changes.m_runs.count(module) != 0;
+}
+
+// Each module keeps its state in a blob of its own, as a linked game
+// holds many in one database
+static nodeidx_t reload_blob_index(uint32_t id)
+{
+  return static_cast<nodeidx_t>(id) << 16;
+}
+
+bool rel_track::load_reload_state(rel_reload_state &state) const
+{
+  netnode node(RELOAD_NODE, 0, true);
+  bytevec_t blob;
+  if (node.getblob(&blob, reload_blob_index(m_id), RELOAD_TAG) <= 0)
+    return false;
+  return state.deserialize(blob.data(), blob.size());
+}
+
+void rel_track::save_reload_state(rel_reload_state const &state) const
+{
+  netnode node(RELOAD_NODE, 0, true);
+  std::vector<uint8_t> blob = state.serialize();
+  node.setblob(blob.data(), blob.size(), reload_blob_index(m_id), RELOAD_TAG);
+}
+
+bool rel_track::apply_relocations()
+{
+  // Apply relocations
+  if (m_import_offset > 0)
+  {
+    uint32_t count = 0;
+    uint32_t desired_import_size = 0;
+    rel_slot_table slot_table;          // (module, packed offset) -> import slot
+    std::vector<ea_t> module_starts;    // first import slot of each module
+    rel_engine_stats & stats = m_plan.m_stats;
+
+    uint8_t const *imports = this->read_imports(count);
+    if (imports == nullptr)
+      return false;
+
+    // A reload that keeps the slots leaves imports alone unless a section
+    // they patch is rewritten, and doesn't name the slots again
+    bool externals = !m_partial || m_changes.m_externals;
+    bool name_slots = !m_partial || m_changes.m_slots;
+
+    // Module names are interned once, everything below works on dense ids
+    m_module_table.clear();
+    m_import_ids.clear();
+    m_imports.clear();
+    m_import_summaries.clear();
+    m_import_symbols.clear();
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+      // Get the entry
+      import_entry entry;
+      entry.id     = read_be32(imports + i*sizeof(import_entry));
+      entry.offset = read_be32(imports + i*sizeof(import_entry) + 4);
+
+      // Self-relocations
+      if ( entry.id == m_id )
+      {
+        if ( !this->is_replanned(entry.id) )
+          continue;
+
+        rel_stream stream;
+        if ( !this->decode_relocations(entry, stream) )
+          return false;
+
+        std::vector<rel_section_image> images = this->get_section_images();
+        std::vector<rel_patch> patches;
+        if (!rel_relocate(stream, images.data(), images.size(), images.data(), images.size(), nullptr, patches, stats, &m_references))
+          err_msg("REL: Some relocations of module %u could not be applied", entry.id);
+        this->add_run(entry.id, patches);
+        this->add_branch_targets(stream);
+      }
+      else if ( externals ) // EXTERNALS
+      {
+        // Retrieve the module name
+        std::string imp_module_name = this->get_import_name(entry.id);
+
+        uint32_t module = m_module_table.intern(imp_module_name);
+        if ( module == m_imports.size() )
+        {
+          auto it_summary = m_external_modules.find(imp_module_name);
+          m_imports.emplace_back();
+          m_import_summaries.push_back(it_summary != m_external_modules.end() ? &it_summary->second : nullptr);
+
+          rel_map const * map = this->get_map(imp_module_name);
+          if ( map != nullptr )
+            m_import_symbols.add_module(module, *map);
+          module_starts.push_back(0);
+          m_import_ids.push_back(entry.id);
+        }
+
+        // Decode all imports to get the desired size
+        rel_stream & stream = m_imports[module];
+        size_t first = stream.size();
+        if ( !this->decode_relocations(entry, stream) )
+          return false;
+
+        for (size_t k = first; k < stream.size(); ++k)
+        {
+          // Retrieve target offset for import itself
+          ea_t target_offset = m_next_seg_offset + desired_import_size;
+
+          // Also try to get a unique address for the module offset
+          uint32_t offs = this->get_external_offset(module, stream.m_addend[k], stream.m_section[k]);
+          if ( offs == 0 || offs == 1 )
+            offs = stream.m_addend[k] + 0x1000000 * stream.m_section[k];
+
+          // If the address doesn't exist, then add it and get the next import location
+          bool inserted;
+          slot_table.insert(module, offs, static_cast<uint32_t>(target_offset), inserted);
+          if ( inserted )
+          {
+            if ( module_starts[module] == 0 )
+              module_starts[module] = target_offset;
+            desired_import_size += 4;
+          }
+        }
+      }
+    } // for each module
+
+    // Unchanged slots keep the segment as it was
+    if ( !externals )
+      desired_import_size = m_changes.m_extern_size;
+
+    // Now plan the import/externals section
+    uint32_t imp_offset = m_next_seg_offset;
+    m_section_addresses[SECTION_IMPORTS] = imp_offset;
+    m_next_seg_offset += desired_import_size;
+
+    rel_plan_segment imp_segment = { imp_offset, imp_offset + desired_import_size, 0, NAME_EXTERN, CLASS_EXTERN };
+    m_plan.m_segments.emplace_back(std::move(imp_segment));
+
+    m_import_section = static_cast<uint8_t>(m_sections.size());
+
+    // Slots are 4 bytes each, laid out from the start of the segment
+    std::vector<rel_plan_slot> slots(name_slots ? desired_import_size / 4 : 0);
+
+    // Add and parse imports
+    for ( uint32_t module = 0; module < m_imports.size(); ++module )
+    {
+      std::string const & module_name = m_module_table.get_name(module);
+
+      // Add comment for module
+      ea_t target_module_start = module_starts[module];
+      if ( target_module_start == 0 )
+        return err_msg("Failed to locate start of module imports.");
+      if ( name_slots )
+      {
+        rel_plan_comment module_comment = { static_cast<uint32_t>(target_module_start), "Imports from " + module_name };
+        m_plan.m_comments.emplace_back(std::move(module_comment));
+      }
+
+      // Iterate decoded relocations, resolving each to its import slot
+      rel_stream const & stream = m_imports[module];
+      bool is_base = module_name == BASENAME;
+      std::vector<uint32_t> resolved(stream.size());
+      for ( size_t k = 0; k < stream.size(); ++k )
+      {
+        uint32_t addend = stream.m_addend[k];
+        uint8_t section = stream.m_section[k];
+
+        // Retrieve the address that was used to map to the target import
+        uint32_t offs = this->get_external_offset(module, addend, section);
+        if ( offs == 0 || offs == 1 )
+          offs = addend + 0x1000000 * section;
+
+        // Retrieve the target offset for the import
+        ea_t targ_offset = slot_table.find(module, offs);
+        if ( targ_offset == 0 )
+          return err_msg("Import was not mapped correctly. %s %08X", module_name.c_str(), addend);
+
+        resolved[k] = static_cast<uint32_t>(targ_offset);
+        if ( !name_slots )
+          continue;
+
+        // Name and describe each import slot once, the first relocation
+        // using it wins
+        rel_plan_slot & slot = slots[(targ_offset - imp_offset) / 4];
+        if ( !slot.m_name.empty() )
+          continue;
+
+        // Formatted on the stack, the slot keeps the only copy
+        char name[MAXSTR];
+        char comment[MAXSTR];
+        char const * prefix = module_name.c_str();
+        void * addend_ptr = reinterpret_cast<void*>(static_cast<size_t>(addend));
+        unsigned section_id = section;
+
+        offs = this->get_external_offset(module, addend, section, true);   // re-obtain offs without the unique address generation
+        if ( offs == 0 )
+        {
+          if ( is_base )
+            qsnprintf(name, sizeof(name), "%s%p", prefix, addend_ptr);
+          else
+            qsnprintf(name, sizeof(name), "%s_s%u_%p", prefix, section_id, addend_ptr);
+          qsnprintf(comment, sizeof(comment), "addend: %08X; section: %u;", addend, section_id);
+        }
+        else if ( offs == 1 )
+        {
+          qsnprintf(name, sizeof(name), "%s_s%u_bss_%p", prefix, section_id, addend_ptr);
+          qsnprintf(comment, sizeof(comment), "addend: %08X; section: %u (BSS);", addend, section_id);
+        }
+        else
+        {
+          qsnprintf(name, sizeof(name), "%s_%p", prefix, reinterpret_cast<void*>(static_cast<size_t>(offs)));
+          qsnprintf(comment, sizeof(comment), "addend: %08X; section: %u; virtual: 0x%08X;", addend, section_id, offs);
+        }
+
+        // Real symbol names from the module's map take precedence, targets
+        // inside of a symbol are named after it
+        uint32_t delta = 0;
+        char const * symbol = m_import_symbols.find(module, section, addend, delta);
+        if ( symbol != nullptr && delta == 0 )
+        {
+          qsnprintf(name, sizeof(name), "%s", symbol);
+        }
+        else if ( symbol != nullptr )
+        {
+          qsnprintf(name, sizeof(name), "%s_%X", symbol, delta);
+          size_t length = strlen(comment);
+          qsnprintf(comment + length, sizeof(comment) - length, " target: %s+0x%X;", symbol, delta);
+        }
+
+        // Each import slot holds its addend, written once
+        slot.m_address = static_cast<uint32_t>(targ_offset);
+        slot.m_value   = addend;
+        slot.m_name    = name;
+        slot.m_comment = comment;
+      }
+
+      if ( !this->is_replanned(m_import_ids[module]) )
+        continue;
+
+      std::vector<rel_section_image> images = this->get_section_images();
+      std::vector<rel_patch> patches;
+      if ( !rel_relocate(stream, images.data(), images.size(), nullptr, 0, resolved.data(), patches, stats, &m_references) )
+        err_msg("REL: Some relocations importing from %s could not be applied", module_name.c_str());
+      this->add_run(m_import_ids[module], patches);
+    } // for each import
+
+    if ( name_slots )
+    {
+      m_plan.m_slots.reserve(slots.size());
+      for (auto it = slots.begin(); it != slots.end(); ++it)
+        m_plan.m_slots.emplace_back(std::move(*it));
+    }
+
+    this->report_unsupported();
+  }
+
+  return true;
+}
+
+bool rel_track::apply_linked_relocations()
+{
+  if (m_import_offset == 0)
+    return true;
+
+  uint32_t count = 0;
+  uint8_t const *imports = this->read_imports(count);
+  if (imports == nullptr)
+    return false;
+
+  rel_engine_stats & stats = m_plan.m_stats;
+  std::vector<rel_section_image> images = this->get_section_images();
+
+  for (unsigned i = 0; i < count; ++i)
+  {
+    import_entry entry;
+    entry.id     = read_be32(imports + i*sizeof(import_entry));
+    entry.offset = read_be32(imports + i*sizeof(import_entry) + 4);
+    if ( !this->is_replanned(entry.id) )
+      continue;
+
+    rel_stream stream;
+    if ( !this->decode_relocations(entry, stream) )
+      return false;
+
+    // Every target has a real address: this module's own sections, the
+    // main program whose addends are absolute, or another module
+    std::vector<rel_patch> patches;
+    bool applied;
+    if ( entry.id == m_id )
+    {
+      applied = rel_relocate(stream, images.data(), images.size(), images.data(), images.size(), nullptr, patches, stats, &m_references);
+      this->add_branch_targets(stream);
+    }
+    else if ( entry.id == 0 )
+    {
+      applied = rel_relocate(stream, images.data(), images.size(), nullptr, 0, stream.m_addend.data(), patches, stats, &m_references);
+    }
+    else
+    {
+      rel_link_module const *target = m_link->find(entry.id);
+      if ( target == nullptr )
+      {
+        err_msg("REL: Module %u imports from module %u, which isn't part of the game", m_id, entry.id);
+        stats.m_failed += static_cast<uint32_t>(stream.size());
+        continue;
+      }
+
+      std::vector<rel_section_image> targets(target->m_sections.size());
+      for (size_t k = 0; k < targets.size(); ++k)
+      {
+        targets[k].m_base = target->m_sections[k];
+        targets[k].m_size = 0;
+        targets[k].m_data = nullptr;
+      }
+      applied = rel_relocate(stream, images.data(), images.size(), targets.data(), targets.size(), nullptr, patches, stats, &m_references);
+    }
+
+    if ( !applied )
+      err_msg("REL: Some relocations of module %u importing from %u could not be applied", m_id, entry.id);
+    this->add_run(entry.id, patches);
+  }
+
+  this->report_unsupported();
+  return true;
+}
+
+bool rel_track::decode_rso(uint32_t offset, uint32_t size, bool internal, rel_stream &out, std::vector<uint32_t> &symbols) const
+{
+  uint32_t count = size / sizeof(rso_relocation);
+  uint8_t const *data = m_input.data(offset, count*sizeof(rso_relocation));
+  if (count == 0)
+    return true;
+  if (data == nullptr)
+    return err_msg("RSO: Relocations are out of bounds @0x%08X", offset);
+
+  rel_decode_result result = rel_decode_rso(data, count, m_sections.data(), m_sections.size(), internal, out, symbols);
+  uint32_t where = offset + result.m_record * sizeof(rso_relocation);
+  switch (result.m_status)
+  {
+  case REL_DECODE_BAD_SECTION:
+    return err_msg("RSO: Relocation @0x%08X targets an invalid section", where);
+  case REL_DECODE_OUT_OF_BOUNDS:
+    return err_msg("RSO: Relocation @0x%08X patches outside of the sections", where);
+  default:
+    return true;
+  }
+}
+
+// Appends relocation k of from to to
+static void append_relocation(rel_stream const &from, size_t k, rel_stream &to)
+{
+  to.m_where.push_back(from.m_where[k]);
+  to.m_addend.push_back(from.m_addend[k]);
+  to.m_type.push_back(from.m_type[k]);
+  to.m_section.push_back(from.m_section[k]);
+  to.m_site.push_back(from.m_site[k]);
+}
+
+bool rel_track::apply_rso_relocations()
+{
+  // The tables and their names are spread over the whole file
+  if (!this->load_section_buffers())
+    return err_msg("RSO: Failed to read back section data");
+  if (!this->load_window(0, m_max_filesize))
+    return err_msg("RSO: Failed to read the relocation and symbol tables");
+  uint8_t const *data = m_input.data(0, m_max_filesize);
+
+  rel_engine_stats & stats = m_plan.m_stats;
+  std::vector<rel_section_image> images = this->get_section_images();
+
+  // Relocations against the module itself
+  rel_stream internal;
+  std::vector<uint32_t> symbols;
+  if (!this->decode_rso(m_rso_tables.m_internal_offset, m_rso_tables.m_internal_size, true, internal, symbols))
+    return false;
+  std::vector<rel_patch> patches;
+  if (!rel_relocate(internal, images.data(), images.size(), images.data(), images.size(), nullptr, patches, stats, &m_references))
+    err_msg("RSO: Some relocations of %s could not be applied", m_rso_name.c_str());
+  this->add_run(m_id, patches);
+  this->add_branch_targets(internal);
+
+  // One import slot per imported name, holding the address of the export
+  // it resolves to
+  uint32_t count = m_rso_tables.m_import_size / sizeof(rso_import);
+  uint32_t imp_offset = m_next_seg_offset;
+  m_section_addresses[SECTION_IMPORTS] = imp_offset;
+  m_next_seg_offset += count * 4;
+  m_import_section = static_cast<uint8_t>(m_sections.size());
+
+  rel_plan_segment imp_segment = { imp_offset, imp_offset + count * 4, 0, NAME_EXTERN, CLASS_EXTERN };
+  m_plan.m_segments.emplace_back(std::move(imp_segment));
+
+  std::vector<uint32_t> exporters(count, RSO_UNRESOLVED);
+  unsigned unresolved = 0;
+  m_plan.m_slots.reserve(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    uint8_t const *p = data + m_rso_tables.m_import_offset + i*sizeof(rso_import);
+    char const *name = rel_rso_string(data, m_max_filesize, m_rso_tables.m_import_names, read_be32(p));
+
+    rel_plan_slot slot;
+    slot.m_address = imp_offset + i * 4;
+    slot.m_value   = 0;
+    slot.m_name    = name != nullptr ? name : strfmt("import_%u", i);
+
+    rel_export found;
+    if (name != nullptr && m_exports.find(name, found))
+    {
+      exporters[i] = found.m_module;
+      slot.m_value = found.m_address;
+      slot.m_comment = strfmt("from %s; address: %08X;", m_module_names[found.m_module].c_str(), found.m_address);
+    }
+    else
+    {
+      slot.m_comment = "unresolved";
+      ++unresolved;
+    }
+    m_plan.m_slots.emplace_back(std::move(slot));
+  }
+  if (count != 0)
+  {
+    rel_plan_comment imports_comment = { imp_offset, "Imports" };
+    m_plan.m_comments.emplace_back(std::move(imports_comment));
+  }
+
+  // Relocations against imports target their slots, one run per module
+  // the imports resolved to
+  rel_stream external;
+  symbols.clear();
+  if (!this->decode_rso(m_rso_tables.m_external_offset, m_rso_tables.m_external_size, false, external, symbols))
+    return false;
+
+  std::map<uint32_t, std::pair<rel_stream, std::vector<uint32_t> > > runs;
+  for (size_t k = 0; k < external.size(); ++k)
+  {
+    if (symbols[k] >= count)
+    {
+      stats.m_failed += 1;
+      continue;
+    }
+    auto & run = runs[exporters[symbols[k]]];
+    append_relocation(external, k, run.first);
+    run.second.push_back(imp_offset + symbols[k] * 4 + external.m_addend[k]);
+  }
+  for (auto it = runs.begin(); it != runs.end(); ++it)
+  {
+    rel_stream const & stream = it->second.first;
+    patches.clear();
+    if (!rel_relocate(stream, images.data(), images.size(), nullptr, 0, it->second.second.data(), patches, stats, &m_references))
+      err_msg("RSO: Some relocations of %s against imports could not be applied", m_rso_name.c_str());
+    this->add_run(it->first, patches);
+  }
+
+  if (unresolved != 0)
+    msg("RSO: %u of %u imports are not exported by any module next to %s\n", unresolved, count, m_rso_name.c_str());
+  this->report_unsupported();
+  return true;
+}
+
+uint8_t const *rel_track::read_imports(uint32_t &count)
+{
+  // Relocations are applied to local copies of the sections, a reload
+  // has read them already
+  if (m_section_buffers.empty() && !this->load_section_buffers())
+  {
+    err_msg("REL: Failed to read back section data");
+    return nullptr;
+  }
+  return this->read_import_table(count);
+}
+
+uint8_t const *rel_track::read_import_table(uint32_t &count)
+{
+  count = m_import_size / sizeof(import_entry);
+
+  // Pull the import table and the relocation data in with a single read
+  uint32_t region_start = m_import_offset;
+  if (m_rel_offset != 0 && m_rel_offset < region_start)
+    region_start = m_rel_offset;
+  if (!m_input.contains(region_start, m_max_filesize - region_start) && !this->load_window(region_start, m_max_filesize))
+  {
+    err_msg("REL: Failed to read relocation data");
+    return nullptr;
+  }
+
+  uint8_t const *imports = m_input.data(m_import_offset, count*sizeof(import_entry));
+  if (imports == nullptr)
+    err_msg("REL: Import table is out of bounds");
+  return imports;
+}
+
+std::string rel_track::get_import_name(uint32_t id) const
+{
+  auto it_modname = m_module_names.find(id);
+  if ( it_modname != m_module_names.end() )
+    return it_modname->second;
+  if ( id == 0 )
+    return BASENAME;
+  return std::string("module") + std::to_string(static_cast<unsigned long long>(id));
+}
+
+void rel_track::report_unsupported() const
+{
+  rel_engine_stats const & stats = m_plan.m_stats;
+  for (unsigned type = 0; type < 256; ++type)
+  {
+    if (stats.m_per_type[type] != 0 && !rel_type_supported(static_cast<uint8_t>(type)))
+      msg("REL: RELOC TYPE %u UNSUPPORTED (%u relocations)\n", type, stats.m_per_type[type]);
+  }
+}
+
+bool rel_track::load_section_buffers()
+{
+  m_section_buffers.clear();
+  m_section_buffers.resize(m_sections.size());
+
+  for (size_t i = 0; i < m_sections.size(); ++i)
+  {
+    rel_section_buffer &buffer = m_section_buffers[i];
+    buffer.m_start = this->section_address(static_cast<uint8_t>(i));
+    buffer.m_dirty = false;
+    buffer.m_hash = 0;
+
+    // Only sections with file data can be patched
+    if (SECTION_OFF(m_sections[i].file_offset) == 0 || m_sections[i].size == 0 || buffer.m_start == BADADDR)
+      continue;
+
+    // Same bytes the segment is loaded with
+    if (!this->read_file(SECTION_OFF(m_sections[i].file_offset), m_sections[i].size, buffer.m_data))
+      return err_msg("REL: Unable to read section #%u", static_cast<unsigned>(i));
+    buffer.m_hash = rel_hash(buffer.m_data.data(), buffer.m_data.size());
+  }
+  return true;
+}
+
+bool rel_track::read_file(uint32_t offset, uint32_t size, std::vector<uint8_t> &out) const
+{
+  out.resize(size);
+  if (size == 0)
+    return true;
+
+  // Mapped inputs are served from memory
+  if (m_input_file == nullptr)
+  {
+    uint8_t const *p = m_input.data(offset, size);
+    if (p == nullptr)
+      return false;
+    memcpy(out.data(), p, size);
+    return true;
+  }
+
+  qlseek(m_input_file, offset, SEEK_SET);
+  return ldr_qlread(m_input_file, out.data(), size) == static_cast<ssize_t>(size);
+}
+
+bool rel_track::commit_section_buffers()
+{
+  for (size_t i = 0; i < m_section_buffers.size(); ++i)
+  {
+    rel_section_buffer &buffer = m_section_buffers[i];
+    if (buffer.m_dirty)
+    {
+      patch_bytes(buffer.m_start, buffer.m_data.data(), buffer.m_data.size());
+      ldr_count(LDR_WRITTEN_BYTES, buffer.m_data.size());
+    }
+  }
+  m_section_buffers.clear();
+  return true;
+}
+
+std::vector<rel_section_image> rel_track::get_section_images() const
+{
+  std::vector<rel_section_image> images(m_sections.size());
+  for (size_t i = 0; i < m_sections.size(); ++i)
+  {
+    ea_t base = this->section_address(static_cast<uint8_t>(i));
+    images[i].m_base = base == BADADDR ? 0 : static_cast<uint32_t>(base);
+    images[i].m_size = m_sections[i].size;
+    images[i].m_data = i < m_section_buffers.size() && !m_section_buffers[i].m_data.empty() ? m_section_buffers[i].m_data.data() : nullptr;
+  }
+  return images;
+}
+
+void rel_track::add_run(uint32_t module, std::vector<rel_patch> const &patches)
+{
+  this->write_patches(patches);
+
+  rel_plan_run run = { module, m_plan.m_patches.size(), patches.size() };
+  m_plan.m_runs.push_back(run);
+  m_plan.m_patches.insert(m_plan.m_patches.end(), patches.begin(), patches.end());
+}
+
+void rel_track::add_branch_targets(rel_stream const &stream)
+{
+  std::vector<uint32_t> &functions = m_plan.m_functions;
+  for (size_t k = 0; k < stream.size(); ++k)
+  {
+    uint8_t section = stream.m_section[k];
+    uint32_t addend = stream.m_addend[k];
+    if (stream.m_type[k] != R_PPC_REL24 || section >= m_sections.size() ||
+        (m_sections[section].file_offset & SECTION_EXEC) == 0 || addend >= m_sections[section].size)
+      continue;
+
+    ea_t target = this->section_address(section, addend);
+    if (target != BADADDR)
+      functions.push_back(static_cast<uint32_t>(target));
+  }
+}
+
+// Queues the function starts in address order, after the segments exist
+void rel_track::queue_functions() const
+{
+  for (auto it = m_plan.m_functions.begin(); it != m_plan.m_functions.end(); ++it)
+    auto_make_proc(*it);
+  ldr_count(LDR_FUNCTIONS, m_plan.m_functions.size());
+}
+
+// Operand of a D-form instruction holding its 16-bit immediate, as IDA
+// numbers them (lis and li drop rA)
+static uint8_t immediate_operand(uint32_t insn)
+{
+  uint32_t opcode = insn >> 26;
+  uint32_t ra = (insn >> 16) & 0x1F;
+  if (opcode == 14 || opcode == 15)     // addi, addis
+    return ra == 0 ? 1 : 2;
+  if (opcode == 24 || opcode == 25)     // ori, oris
+    return 2;
+  if (opcode >= 32 && opcode <= 55)     // loads and stores, d(rA)
+    return 1;
+  return REL_NO_OPERAND;
+}
+
+// The halves of an address only become offsets where both the high (HA or
+// HI) and the low half of the same target were relocated, as in lis/addi.
+// ADDR32 words become pointers outside of the text sections.
+void rel_track::plan_offsets()
+{
+  std::vector<rel_reference> &references = m_references;
+  std::sort(references.begin(), references.end(), [](rel_reference const &a, rel_reference const &b)
+  {
+    return a.m_target != b.m_target ? a.m_target < b.m_target : a.m_address < b.m_address;
+  });
+
+  std::vector<rel_plan_offset> &offsets = m_plan.m_offsets;
+  for (size_t first = 0; first < references.size(); )
+  {
+    size_t last = first;
+    bool high = false, low = false;
+    for (; last < references.size() && references[last].m_target == references[first].m_target; ++last)
+    {
+      uint8_t type = references[last].m_type;
+      high = high || type == R_PPC_ADDR16_HA || type == R_PPC_ADDR16_HI;
+      low  = low  || type == R_PPC_ADDR16_LO;
+    }
+
+    for (; first < last; ++first)
+    {
+      rel_reference const &reference = references[first];
+      bool exec = reference.m_section < m_sections.size() && (m_sections[reference.m_section].file_offset & SECTION_EXEC) != 0;
+      rel_plan_offset offset = { reference.m_address, reference.m_target, reference.m_type, 0 };
+      if (reference.m_type == R_PPC_ADDR32)
+      {
+        if (exec)
+          continue;
+      }
+      else
+      {
+        // The site is the immediate, the low halfword of the instruction
+        if (!exec || !high || !low || reference.m_offset < 2)
+          continue;
+        rel_section_buffer const &buffer = m_section_buffers[reference.m_section];
+        offset.m_address -= 2;
+        offset.m_operand = buffer.m_data.empty() ? REL_NO_OPERAND : immediate_operand(read_be32(&buffer.m_data[reference.m_offset - 2]));
+      }
+      offsets.push_back(offset);
+    }
+  }
+
+  std::sort(offsets.begin(), offsets.end(), [](rel_plan_offset const &a, rel_plan_offset const &b)
+  {
+    return a.m_address < b.m_address;
+  });
+  references.clear();
+}
+
+// Offsets and their xrefs, in address order
+void rel_track::commit_offsets() const
+{
+  // IDA has no reference type for HA halves, the PPC module registers one.
+  // Without it they only get the xref.
+  int higha16 = find_custom_refinfo("HIGHA16");
+
+  for (auto it = m_plan.m_offsets.begin(); it != m_plan.m_offsets.end(); ++it)
+  {
+    if (it->m_type == R_PPC_ADDR32)
+    {
+      create_dword(it->m_address, 4);
+      op_plain_offset(it->m_address, 0, 0);
+    }
+    else
+    {
+      // Operands are kept with the instruction, so it's decoded first
+      create_insn(it->m_address);
+      bool known = it->m_type != R_PPC_ADDR16_HA || higha16 >= 0;
+      if (it->m_operand != REL_NO_OPERAND && known)
+      {
+        uint32 type = it->m_type == R_PPC_ADDR16_LO ? REF_LOW16 : it->m_type == R_PPC_ADDR16_HI ? REF_HIGH16 : REFINFO_CUSTOM | higha16;
+        op_offset(it->m_address, it->m_operand, type, it->m_target);
+      }
+    }
+    add_dref(it->m_address, it->m_target, dr_O);
+  }
+  ldr_count(LDR_OFFSETS, m_plan.m_offsets.size());
+}
+
+void rel_track::write_patches(std::vector<rel_patch> const &patches)
+{
+  for (auto it = patches.begin(); it != patches.end(); ++it)
+  {
+    // The engine only emits patches for sites backed by a buffer
+    rel_section_buffer &buffer = m_section_buffers[it->m_section];
+    if (it->m_width == 4)
+      write_be32(&buffer.m_data[it->m_offset], it->m_value);
+    else
+      write_be16(&buffer.m_data[it->m_offset], static_cast<uint16_t>(it->m_value));
+    buffer.m_dirty = true;
+  }
+}
+
+bool rel_track::apply_names()
+{
+  std::vector<std::string> &cmt = m_plan.m_program_comments;
+
+  // Describe the binary header
+  if ( m_link_module != nullptr )
+    cmt.push_back(strfmt("Module: %s @ %08X", m_link_module->m_name.c_str(), m_link_module->m_base));
+  if ( m_rso )
+    cmt.push_back(strfmt("RSO module: %s", m_rso_name.c_str()));
+  else
+    cmt.push_back(strfmt("ID: %u", m_id));
+  cmt.push_back(strfmt("Version: %u", m_version));
+  cmt.push_back(strfmt("%u sections @ %08X:", m_num_sections, m_section_offset));
+  for ( unsigned i = 0; i < m_sections.size(); ++i )
+  {
+    if ( i == m_internal_bss_section )
+    {
+      cmt.push_back(strfmt("    .bss%u: %u bytes", i, m_sections[i].size));
+    }
+    else if ( m_sections[i].file_offset != 0 )
+    {
+      if ( m_sections[i].file_offset & SECTION_EXEC )
+        cmt.push_back(strfmt("    .text%u: %u bytes @ %08X", i, m_sections[i].size, SECTION_OFF(m_sections[i].file_offset)));
+      else
+        cmt.push_back(strfmt("    .data%u: %u bytes @ %08X", i, m_sections[i].size, SECTION_OFF(m_sections[i].file_offset)));
+    }
+  }
+  if ( m_rso )
+  {
+    rel_rso_tables const & t = m_rso_tables;
+    cmt.push_back(strfmt("Internal relocations: %u @ %08X", static_cast<unsigned>(t.m_internal_size / sizeof(rso_relocation)), t.m_internal_offset));
+    cmt.push_back(strfmt("External relocations: %u @ %08X", static_cast<unsigned>(t.m_external_size / sizeof(rso_relocation)), t.m_external_offset));
+    cmt.push_back(strfmt("Exports: %u @ %08X", static_cast<unsigned>(t.m_export_size / sizeof(rso_export)), t.m_export_offset));
+    cmt.push_back(strfmt("Imports: %u @ %08X", static_cast<unsigned>(t.m_import_size / sizeof(rso_import)), t.m_import_offset));
+  }
+  else
+  {
+    cmt.push_back(strfmt("Imports: %u bytes @ %08X", m_import_size, m_import_offset));
+    cmt.push_back(strfmt("Relocations @ %08X", m_rel_offset));
+  }
+
+  // Obtain addresses
+  ea_t epilog_addr = section_address(m_epilog_prep.m_section_id, m_epilog_prep.m_offset);
+  ea_t prolog_addr = section_address(m_prolog_prep.m_section_id, m_prolog_prep.m_offset);
+  ea_t unresolved_addr = section_address(m_unresolved_prep.m_section_id, m_unresolved_prep.m_offset);
+
+  // Plan function exports, every module of a linked game has its own
+  std::string prefix = m_link_module != nullptr ? m_link_module->m_name : std::string();
+  rel_plan_comment entries[] =
+  {
+    { static_cast<uint32_t>(epilog_addr), prefix + "_epilog" },
+    { static_cast<uint32_t>(prolog_addr), prefix + "_prolog" },
+    { static_cast<uint32_t>(unresolved_addr), prefix + "_unresolved" },
+  };
+  m_plan.m_entries.assign(entries, entries + 3);
+
+  // The exports start functions too, branches to them were collected while
+  // relocating
+  std::vector<uint32_t> &functions = m_plan.m_functions;
+  for (size_t i = 0; i < 3; ++i)
+  {
+    if (entries[i].m_address != BADADDR)
+      functions.push_back(entries[i].m_address);
+  }
+  std::sort(functions.begin(), functions.end());
+  functions.erase(std::unique(functions.begin(), functions.end()), functions.end());
+
+  // An RSO names what it exports, maps below have the last word
+  if ( m_rso && this->load_window(0, m_max_filesize) )
+  {
+    uint8_t const * data = m_input.data(0, m_max_filesize);
+    uint32_t count = m_rso_tables.m_export_size / sizeof(rso_export);
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+      uint8_t const * p = data + m_rso_tables.m_export_offset + i*sizeof(rso_export);
+      char const * name = rel_rso_string(data, m_max_filesize, m_rso_tables.m_export_names, read_be32(p));
+      uint32_t section = read_be32(p + offsetof(rso_export, section));
+      uint32_t offset = read_be32(p + offsetof(rso_export, offset));
+      if ( name == nullptr || section >= m_sections.size() || offset >= m_sections[section].size )
+        continue;
+
+      ea_t address = section_address(static_cast<uint8_t>(section), offset);
+      if ( address == BADADDR )
+        continue;
+      rel_plan_comment symbol = { static_cast<uint32_t>(address), name };
+      m_plan.m_names.emplace_back(std::move(symbol));
+    }
+  }
+
+  // Name the module's own symbols from its map
+  auto it_name = m_module_names.find(m_id);
+  rel_map const * map = it_name != m_module_names.end() ? this->get_map(it_name->second) : nullptr;
+  for ( size_t i = 0; map != nullptr && i < map->size(); ++i )
+  {
+    rel_map_symbol const & symbol = map->get_symbol(i);
+    ea_t address = section_address(symbol.m_section, symbol.m_offset);
+    if ( address == BADADDR || symbol.m_section >= m_sections.size() || symbol.m_offset >= m_sections[symbol.m_section].size )
+      continue;
+
+    rel_plan_comment name = { static_cast<uint32_t>(address), map->get_name(symbol) };
+    m_plan.m_names.emplace_back(std::move(name));
+  }
+
+  return true;
+}
+
+void rel_track::set_plan_cache(bool enabled)
+{
+  m_use_cache = enabled;
+}
+
+std::string rel_track::get_cache_path() const
+{
+  return m_directory + "/" + strfmt(CACHE_FORMAT, m_id);
+}
+
+uint64_t rel_track::hash_input()
+{
+  if ( !this->load_window(0, m_max_filesize) )
+    return 0;
+  return rel_hash(m_input.data(0, m_max_filesize), m_max_filesize);
+}
+
+// Dependencies are "module:<id>", hashing the name the id resolves to and
+// the contents of its file, and "map:<module>", hashing the stamp of the
+// map as maps are too large to hash on every open
+uint64_t rel_track::get_dependency_hash(std::string const &name) const
+{
+  if ( name.compare(0, 7, "module:") == 0 )
+  {
+    uint32_t id = static_cast<uint32_t>(strtoul(name.c_str() + 7, nullptr, 10));
+    auto it_name = m_module_names.find(id);
+    auto it_hash = m_module_hashes.find(id);
+    if ( it_name == m_module_names.end() || it_hash == m_module_hashes.end() )
+      return 0;
+    return rel_hash(it_name->second.c_str(), it_name->second.size(), it_hash->second);
+  }
+
+  if ( name.compare(0, 4, "map:") == 0 )
+  {
+    uint64_t size;
+    int64_t mtime;
+    if ( !rel_index::get_stamp(this->get_map_path(name.substr(4)).c_str(), size, mtime) )
+      return 0;
+    return rel_hash(&mtime, sizeof(mtime), rel_hash(&size, sizeof(size)));
+  }
+  return 0;
+}
+
+bool rel_track::load_plan_cache()
+{
+  std::string path = this->get_cache_path();
+  rel_plan_cache cache;
+  if ( !cache.load(path.c_str()) )
+    return false;
+
+  // Same module, resolved against the same siblings and maps
+  m_module_hash = this->hash_input();
+  if ( cache.m_module_hash != m_module_hash || cache.m_section_addresses.size() != 256 )
+    return false;
+  for ( auto it = cache.m_dependencies.begin(); it != cache.m_dependencies.end(); ++it )
+  {
+    if ( this->get_dependency_hash(it->m_name) != it->m_hash )
+      return false;
+  }
+
+  std::copy(cache.m_section_addresses.begin(), cache.m_section_addresses.end(), m_section_addresses);
+  m_next_seg_offset = cache.m_extern_end;
+  m_plan = std::move(cache.m_plan);
+
+  // Section contents come from the file with the saved patches applied,
+  // nothing is decoded or resolved
+  if ( !this->load_section_buffers() )
+    return false;
+  for ( auto it = m_plan.m_patches.begin(); it != m_plan.m_patches.end(); ++it )
+  {
+    if ( it->m_section >= m_section_buffers.size() || it->m_offset + it->m_width > m_section_buffers[it->m_section].m_data.size() )
+    {
+      m_plan.clear();
+      return err_msg("REL: Ignoring the damaged plan cache %s", path.c_str());
+    }
+  }
+  this->write_patches(m_plan.m_patches);
+
+  msg("REL: Using the plan cached in %s\n", path.c_str());
+  return true;
+}
+
+void rel_track::save_plan_cache()
+{
+  rel_plan_cache cache;
+  cache.m_module_hash = m_module_hash != 0 ? m_module_hash : this->hash_input();
+
+  std::vector<std::string> names;
+  for ( auto it = m_import_ids.begin(); it != m_import_ids.end(); ++it )
+    names.push_back(strfmt("module:%u", *it));
+  auto it_own = m_module_names.find(m_id);
+  if ( it_own != m_module_names.end() )
+    names.push_back("map:" + it_own->second);
+  for ( uint32_t module = 0; module < m_module_table.size(); ++module )
+    names.push_back("map:" + m_module_table.get_name(module));
+
+  for ( auto it = names.begin(); it != names.end(); ++it )
+  {
+    rel_cache_dependency dependency = { *it, this->get_dependency_hash(*it) };
+    cache.m_dependencies.push_back(dependency);
+  }
+
+  cache.m_section_addresses.assign(m_section_addresses, m_section_addresses + 256);
+  cache.m_extern_end = m_next_seg_offset;
+  cache.m_plan = m_plan;
+  cache.save(this->get_cache_path().c_str());
+}
+
+static int idaapi enum_modules_cb(char const * file, void * ud)
+{
+  static_cast<std::vector<std::string> *>(ud)->push_back(file);
+  return 0;
+}
+
+void rel_track::init_resolvers(bool save_index)
+{
+  ldr_scope trace("init_resolvers");
+  std::string path;
+  
+  // Retrieve the directory of the current database
+  char dir[260] = {};
+  if ( !qdirname(dir, sizeof(dir), get_path(PATH_TYPE_IDB)) )
+    msg("REL: Unable to get directory of idb file.\n");
+  path = dir;
+  m_directory = path;
+  m_maps.clear();
+
+  // List the modules in a fixed order
+  std::vector<std::string> files;
+  enumerate_files(nullptr, 0, path.c_str(), "*.rel", &enum_modules_cb, &files);
+  enumerate_files(nullptr, 0, path.c_str(), YAZ0_PATTERN, &enum_modules_cb, &files);
+  std::sort(files.begin(), files.end());
+
+  // Parse the ones that changed since the last load in parallel
+  rel_index index(path);
+  index.load();
+  index.refresh(files);
+  if ( save_index )
+    index.save();
+
+  // Load the module names
   m_module_names.clear();
-  enumerate_files(nullptr, 0, path.c_str(), "*.rel", reinterpret_cast<int(idaapi*)(char const*,void*)>(&enum_modules_cb), this);
+  m_module_hashes.clear();
+  m_external_modules.clear();
+  for ( auto it = files.begin(); it != files.end(); ++it )
+  {
+    rel_index_entry const * entry = index.find(*it);
+
+    // If the file is good
+    if ( entry != nullptr && entry->m_valid )
+    {
+      std::string modulename = rel_module_basename(it->c_str());
+
+      if ( entry->m_id == 0 )
+        msg("%s id is 0\n", modulename.c_str());
+      m_module_names[entry->m_id] = modulename;
+      m_module_hashes[entry->m_id] = entry->m_hash;
+
+      m_external_modules.erase(modulename);
+      m_external_modules.emplace(modulename, rel_module_summary(entry->m_id, entry->m_sections));
+    }
+  }
 
 
   /*std::ifstream modid(path + "/module_id.txt");
   while( modid >> id >> name )
     m_module_names[id] = name;*/
+}
+
+void rel_track::init_exports()
+{
+  ldr_scope trace("init_exports");
+
+  char dir[260] = {};
+  if ( !qdirname(dir, sizeof(dir), get_path(PATH_TYPE_IDB)) )
+    msg("RSO: Unable to get directory of idb file.\n");
+  m_directory = dir;
+  m_maps.clear();
+  m_module_names.clear();
+  m_exports.clear();
+
+  // The .sel stands for the main program, id 0 as in RELs. Modules are
+  // numbered from 1 in the order of their names.
+  std::vector<std::string> sels;
+  std::vector<std::string> rsos;
+  enumerate_files(nullptr, 0, m_directory.c_str(), SEL_PATTERN, &enum_modules_cb, &sels);
+  enumerate_files(nullptr, 0, m_directory.c_str(), RSO_PATTERN, &enum_modules_cb, &rsos);
+  std::sort(sels.begin(), sels.end());
+  std::sort(rsos.begin(), rsos.end());
+  std::vector<std::string> files(sels.begin(), sels.begin() + std::min<size_t>(sels.size(), 1));
+  files.insert(files.end(), rsos.begin(), rsos.end());
+
+  uint32_t next_id = 1;
+  bool found_self = false;
+  for ( size_t i = 0; i < files.size(); ++i )
+  {
+    bool is_sel = i < files.size() - rsos.size();
+    uint32_t id = is_sel ? 0 : next_id++;
+
+    rel_input input;
+    if ( !input.open(files[i].c_str()) )
+      continue;
+    uint8_t const * data = input.data(0, input.get_size());
+    if ( data == nullptr || !rso_probe_header(data, input.get_size(), input.get_size()) )
+      continue;
+
+    rel_rso_tables tables;
+    rel_rso_read_tables(data, tables);
+    std::string basename(qbasename(files[i].c_str()));
+    std::string modulename = basename.substr(0, basename.find_last_of('.'));
+    m_module_names[id] = modulename;
+
+    // Imports never resolve against the module itself
+    std::string name = rel_rso_module_name(data, input.get_size(), tables);
+    if ( !is_sel && !found_self && (name.empty() ? modulename : name) == m_rso_name )
+    {
+      m_id = id;
+      found_self = true;
+      continue;
+    }
+
+    // Exporters are placed as if loaded alone at START, like REL siblings
+    std::vector<uint32_t> bases;
+    if ( !is_sel )
+    {
+      uint32_t num_sections = read_be32(data + offsetof(rsohdr, num_sections));
+      uint32_t section_offset = read_be32(data + offsetof(rsohdr, section_offset));
+      std::vector<section_entry> sections(num_sections);
+      for ( uint32_t k = 0; k < num_sections; ++k )
+      {
+        sections[k].file_offset = read_be32(data + section_offset + k*sizeof(section_entry));
+        sections[k].size        = read_be32(data + section_offset + k*sizeof(section_entry) + 4);
+      }
+      rel_module_summary summary(id, sections);
+      for ( uint32_t k = 0; k < num_sections; ++k )
+        bases.push_back(summary.get_virtual_base(static_cast<uint8_t>(k)));
+    }
+
+    if ( !m_exports.add_module(id, data, input.get_size(), tables, is_sel ? nullptr : bases.data(), bases.size()) )
+      msg("RSO: The export table of %s is out of bounds\n", basename.c_str());
+  }
+  m_exports.build();
 
-  // Load the function names
-  // TODO: load map files matching module names
+  // Modules opened from elsewhere get an id after their neighbours
+  if ( !found_self )
+    m_id = next_id;
+  m_module_names[m_id] = m_rso_name;
+
+  msg("RSO: %u exports from %u modules\n", static_cast<unsigned>(m_exports.size()), static_cast<unsigned>(files.size()));
+}
+
+std::string rel_track::get_map_path(std::string const &modulename) const
+{
+  // The main program's map is named after main.dol
+  bool base = modulename == BASENAME;
+  return m_directory + "/" + (base ? std::string(BASE_MAP_NAME) : modulename) + MAP_EXTENSION;
 }
 
-uint32_t rel_track::get_external_offset(std::string const &modulename, uint32_t offset, uint8_t section, bool virt) const
+rel_map const *rel_track::get_map(std::string const &modulename)
 {
-  auto it = m_external_modules.find(modulename);
+  auto it = m_maps.find(modulename);
+  if ( it == m_maps.end() )
+  {
+    bool base = modulename == BASENAME;
+    std::string path = this->get_map_path(modulename);
+
+    it = m_maps.insert(std::make_pair(modulename, rel_map())).first;
+    rel_map & map = it->second;
+    if ( map.load(path.c_str(), base) && !base )
+    {
+      // Section indices come from the module the map was built for
+      std::vector<section_entry> const * sections = nullptr;
+      auto it_own = m_module_names.find(m_id);
+      auto it_summary = m_external_modules.find(modulename);
+      if ( it_own != m_module_names.end() && it_own->second == modulename )
+        sections = &m_sections;
+      else if ( it_summary != m_external_modules.end() )
+        sections = &it_summary->second.get_sections();
+
+      std::string mismatch;
+      if ( sections == nullptr )
+      {
+        msg("REL: No section table for %s, ignoring %s\n", modulename.c_str(), path.c_str());
+        map.clear();
+      }
+      else if ( !map.match_sections(*sections, mismatch) )
+      {
+        msg("REL: The %s section layout of %s doesn't fit the sections of %s, ignoring the map\n",
+            mismatch.c_str(), path.c_str(), modulename.c_str());
+        map.clear();
+      }
+    }
+    if ( map.size() != 0 )
+      msg("REL: %u symbols from %s\n", static_cast<unsigned>(map.size()), path.c_str());
+  }
+  return it->second.size() != 0 ? &it->second : nullptr;
+}
+
+uint32_t rel_track::get_external_offset(uint32_t module, uint32_t offset, uint8_t section, bool virt) const
+{
+  rel_module_summary const * summary = m_import_summaries[module];
   // Check for existence
-  if ( it == m_external_modules.end() )
+  if ( summary == nullptr )
   {
     return 0;
   }
 
   // Check for section validity
-  if ( section >= it->second.m_sections.size() )
+  if ( section >= summary->get_num_sections() )
   {
-    msg("REL: Module %s had invalid section reference %u\n", modulename.c_str(), static_cast<unsigned int>(section));
+    msg("REL: Module %s had invalid section reference %u\n", m_module_table.get_name(module).c_str(), static_cast<unsigned int>(section));
     return 0;
   }
 
-  uint32_t section_offset = SECTION_OFF(it->second.m_sections[section].file_offset);
-  if ( section_offset == 0 )
+  if ( summary->is_bss(section) )
     return 1;
 
-  uint32_t first_offset = 0;
-  for ( unsigned i = 0; i < it->second.m_sections.size() && first_offset == 0; ++i )
-    first_offset = SECTION_OFF(it->second.m_sections[i].file_offset);
-  
   if ( virt )
+    return summary->get_virtual_base(section) + offset;
+  return summary->get_section_offset(section) + offset;
+}
+
+rel_module_summary::rel_module_summary(uint32_t id, std::vector<section_entry> const &sections)
+  : m_id(id)
+  , m_first_offset(0)
+  , m_sections(sections)
+  , m_offsets(sections.size())
+  , m_virtual_bases(sections.size())
+  , m_bss(sections.size())
+{
+  for ( unsigned i = 0; i < sections.size() && m_first_offset == 0; ++i )
+    m_first_offset = SECTION_OFF(sections[i].file_offset);
+
+  for ( unsigned i = 0; i < sections.size(); ++i )
   {
-    section_offset -= first_offset;
-    section_offset += START;
+    uint32_t offset = SECTION_OFF(sections[i].file_offset);
+    m_offsets[i] = offset;
+    m_bss[i] = offset == 0;
+    m_virtual_bases[i] = offset != 0 ? offset - m_first_offset + START : 0;
   }
+}
+
+uint32_t rel_module_summary::get_id() const
+{
+  return m_id;
+}
+
+size_t rel_module_summary::get_num_sections() const
+{
+  return m_offsets.size();
+}
 
-  return section_offset + offset;
+uint32_t rel_module_summary::get_section_offset(uint8_t section) const
+{
+  return section < m_offsets.size() ? m_offsets[section] : 0;
+}
+
+uint32_t rel_module_summary::get_virtual_base(uint8_t section) const
+{
+  return section < m_virtual_bases.size() ? m_virtual_bases[section] : 0;
+}
+
+bool rel_module_summary::is_bss(uint8_t section) const
+{
+  return section >= m_bss.size() || m_bss[section] != 0;
+}
+
+uint32_t rel_module_summary::get_first_offset() const
+{
+  return m_first_offset;
+}
+
+std::vector<section_entry> const &rel_module_summary::get_sections() const
+{
+  return m_sections;
 }
@@ -2,12 +2,26 @@
 #define __REL_TRACK_H__
 
 #include "rel.h"
+#include "rel_input.h"
+#include "rel_decode.h"
+#include "rel_engine.h"
+#include "rel_plan.h"
+#include "rel_tables.h"
+#include "rel_map.h"
+#include "rel_symbols.h"
+#include "rel_reload.h"
+#include "rel_rso.h"
+#include "rel_yaz0.h"
 #include <cstdio>
 #include <vector>
 #include <map>
 
 #define BASENAME "_BASE_"
 
+// Netnode keeping what each load wrote, for reloading in place
+#define RELOAD_NODE "$ rel reload"
+#define RELOAD_TAG  'R'
+
 struct fxn_naming_entry
 {
   uint32_t m_offset;
@@ -16,33 +30,196 @@ struct fxn_naming_entry
 
 #define SECTION_IMPORTS 99
 
+class rel_link;
+struct rel_link_module;
+
+// Local copy of a section's bytes. Relocations are applied here and the
+// result is committed to the database with a single write.
+struct rel_section_buffer
+{
+  ea_t m_start;
+  std::vector<uint8_t> m_data;
+  bool m_dirty;
+  uint64_t m_hash;      // of the file contents, before relocating
+};
+
+// Immutable description of a sibling module, holding only what is needed
+// to resolve imports against it. Section bases are precomputed into flat
+// arrays so resolving an import is plain indexing.
+class rel_module_summary
+{
+public:
+  rel_module_summary(uint32_t id, std::vector<section_entry> const &sections);
+
+  uint32_t get_id() const;
+  size_t get_num_sections() const;
+
+  // File offset of a section without flags, 0 for bss or unused sections
+  uint32_t get_section_offset(uint8_t section) const;
+
+  // Address of a section if the module was loaded alone at START, 0 for
+  // bss or unused sections
+  uint32_t get_virtual_base(uint8_t section) const;
+
+  // True if the section has no file data
+  bool is_bss(uint8_t section) const;
+
+  // File offset of the first section with data
+  uint32_t get_first_offset() const;
+
+  // Section table, as in the file
+  std::vector<section_entry> const &get_sections() const;
+
+private:
+  uint32_t m_id;
+  uint32_t m_first_offset;
+  std::vector<section_entry> m_sections;
+  std::vector<uint32_t> m_offsets;
+  std::vector<uint32_t> m_virtual_bases;
+  std::vector<uint8_t> m_bss;
+};
+
 class rel_track
 {
 public:
   rel_track();
   rel_track(linput_t *p_input);
+  rel_track(char const *path);
+  // A module in memory that outlives the track, such as a file of a
+  // mapped disc image
+  rel_track(uint8_t const *data, uint32_t size);
 
   bool is_good() const;
 
+  // True for .rso modules of the Wii dynamic linker, false for RELs
+  bool is_rso() const;
+
+  // True if the file is Yaz0 compressed, the module is then held in memory
+  bool is_compressed() const;
+
+  // Switches to another handle on the same file
+  void rebind(linput_t *p_input);
+
+  uint32_t get_id() const;
+  std::vector<section_entry> const &get_sections() const;
+
+  // Alignment of the image and the bss, 0 before version 2
+  uint32_t get_align() const;
+  uint32_t get_bss_align() const;
+  uint32_t get_file_size() const;
+
+  // Loads the module at its place in a linked game instead of at START.
+  // Imports are bound to the other modules and the main program directly.
+  // Returns false if the game has no place for this module.
+  bool link(rel_link const &game);
+
+  // Reuses the plan of an earlier load of the same module against the
+  // same siblings, saved next to the database. Off by default.
+  void set_plan_cache(bool enabled);
+
   //section_entry const * get_section(uint entry_id) const;
   ea_t section_address(uint8_t section, uint32_t offset = 0) const;
 
-  bool apply_patches(bool dry_run = false);
+  // Plans the load and, unless dry_run is set, commits it to the database.
+  // With reload set the module is already in the database and only what
+  // changed since it was loaded is written.
+  bool apply_patches(bool dry_run = false, bool reload = false);
+  rel_load_plan const &get_plan() const;
 private:
+  void parse();
+  bool load_window(uint32_t begin, uint32_t end);
+
+  bool inflate_input();
   bool read_header();
+  bool read_rso_header(uint8_t const *header);
   bool read_sections();
   bool verify_section(uint32_t offset, uint32_t size) const;
+  bool decode_relocations(import_entry const &entry, rel_stream &out) const;
 
   bool validate_header() const;
 
-  bool create_sections(bool dry_run = false);
-  bool apply_relocations(bool dry_run = false);
-  bool apply_names(bool dry_run = false);
+  bool create_sections();
+  bool apply_relocations();
+  bool apply_linked_relocations();
+  bool apply_rso_relocations();
+  bool decode_rso(uint32_t offset, uint32_t size, bool internal, rel_stream &out, std::vector<uint32_t> &symbols) const;
+  bool apply_names();
+  bool commit_plan();
+  bool commit_changes(rel_reload_state &previous, rel_reload_state &current);
+
+  // Hashes of what the plan writes, kept in the database between loads
+  bool describe_load(rel_reload_state &state);
+
+  // Hashes of the sections and relocation runs as in the file, and of what
+  // the slots resolve against. Known before relocating.
+  bool describe_input(rel_reload_state &state);
+  bool describe_runs(rel_reload_state &state);
+
+  // Loads the state of the last load and checks the module can be
+  // reloaded in place
+  bool load_previous(rel_reload_state &previous, rel_reload_state const &current) const;
+
+  // Compares the module with its last load before relocating, so that
+  // only the runs in m_changes are planned
+  bool plan_reload(rel_reload_state &previous, rel_reload_state &current);
+
+  // False for the runs a reload leaves alone
+  bool is_replanned(uint32_t module) const;
+  bool load_reload_state(rel_reload_state &state) const;
+  void save_reload_state(rel_reload_state const &state) const;
+
+  bool read_file(uint32_t offset, uint32_t size, std::vector<uint8_t> &out) const;
+  bool load_section_buffers();
+  bool commit_section_buffers();
+  std::vector<rel_section_image> get_section_images() const;
+  void write_patches(std::vector<rel_patch> const &patches);
+
+  // Applies the patches of one import table entry and adds them to the plan
+  void add_run(uint32_t module, std::vector<rel_patch> const &patches);
 
-  // Initializes the name and module resolvers
-  void init_resolvers();
+  // Adds the targets of the REL24 relocations of a self-relocation stream
+  // that land in executable sections to the function starts of the plan
+  void add_branch_targets(rel_stream const &stream);
+  void queue_functions() const;
 
-  uint32_t get_external_offset(std::string const &modulename, uint32_t offset, uint8_t section, bool virt = false) const;
+  // Turns the references collected while relocating into the offsets of
+  // the plan, and creates them
+  void plan_offsets();
+  void commit_offsets() const;
+
+  // Loads the section buffers and the import table, count is set to the
+  // number of import entries
+  uint8_t const *read_imports(uint32_t &count);
+  uint8_t const *read_import_table(uint32_t &count);
+
+  // Name of the module an import entry refers to, its slots are prefixed
+  // with it
+  std::string get_import_name(uint32_t id) const;
+  void report_unsupported() const;
+  void trace_plan() const;
+
+  // Initializes the name and module resolvers, saving the module index
+  // next to the database unless save_index is false
+  void init_resolvers(bool save_index);
+
+  // Numbers the .sel and .rso files next to the database and indexes
+  // their exports
+  void init_exports();
+
+  // Linker map of a module, loaded on first use. nullptr if there is none
+  // or it doesn't match the module's section table.
+  rel_map const *get_map(std::string const &modulename);
+  std::string get_map_path(std::string const &modulename) const;
+
+  // Plan cache, keyed by the contents of the module and what it resolved against
+  std::string get_cache_path() const;
+  uint64_t hash_input();
+  uint64_t get_dependency_hash(std::string const &name) const;
+  bool load_plan_cache();
+  void save_plan_cache();
+
+  // module is an id interned in m_module_table
+  uint32_t get_external_offset(uint32_t module, uint32_t offset, uint8_t section, bool virt = false) const;
 
   //
   uint32_t m_id;
@@ -62,27 +239,56 @@ private:
   uint32_t m_bss_size;
 
   uint32_t m_rel_offset;
+
+  uint32_t m_align;
+  uint32_t m_bss_align;
   //
 
   bool m_valid;
+  bool m_rso;
+  bool m_compressed;
+  uint32_t m_header_size;
   uint32_t m_max_filesize;
   linput_t * m_input_file;
+  rel_input m_input;
 
   //uint32_t m_next_file_offset;
   uint32_t m_next_seg_offset;
   uint8_t m_import_section;
   uint8_t m_internal_bss_section;
-  std::map<std::string, std::vector<rel_entry> > m_imports;
+
+  // Imported modules, indexed by their interned id
+  rel_name_table m_module_table;
+  std::vector<uint32_t> m_import_ids;     // id each module was first imported as
+  std::vector<rel_stream> m_imports;
+  std::vector<rel_module_summary const *> m_import_summaries;   // null if not found
+  rel_symbol_index m_import_symbols;      // symbols of the modules with a map
 
   std::vector<section_entry> m_sections;
+  std::vector<rel_section_buffer> m_section_buffers;
+  std::vector<rel_reference> m_references;   // of all runs, until planned
+  rel_load_plan m_plan;
+  rel_reload_changes m_changes;             // what a reload redoes
+  bool m_partial;                           // only the runs in m_changes are planned
 
   std::map<uint32_t,std::string> m_module_names;
-  std::map<uint32_t, std::map<uint32_t,std::string> > m_function_names;
-  std::map<uint8_t, uint32_t> m_segment_address_map;
+  std::map<uint32_t,uint64_t> m_module_hashes;   // contents of each sibling
+  std::string m_directory;                  // of the database and the sibling modules
+  std::map<std::string, rel_map> m_maps;    // by module name
+  uint32_t m_section_addresses[256];   // loaded address per section, 0 if unmapped
+
+  std::map<std::string, rel_module_summary> m_external_modules;
+
+  rel_link const *m_link;                   // game this module is linked into, if any
+  rel_link_module const *m_link_module;
 
-  std::map<std::string, rel_track> m_external_modules;
+  // Names of an RSO, and the exports of the modules next to it
+  rel_rso_tables m_rso_tables;
+  std::string m_rso_name;
+  rel_export_index m_exports;
 
-  friend int idaapi enum_modules_cb(char const * file, rel_track * owner);
+  bool m_use_cache;
+  uint64_t m_module_hash;                   // contents of this module, 0 until needed
 };
 
 #endif // #ifndef __REL_TRACK_H__
@@ -0,0 +1,133 @@
+#include "rel_yaz0.h"
+#include <cstring>
+
+// Longest run a single back reference can copy
+#define YAZ0_MAX_RUN  (0xFF + 0x12)
+
+bool rel_yaz0_probe(uint8_t const *data, size_t data_size, uint32_t &size)
+{
+  if ( data == nullptr || data_size < YAZ0_HEADER_SIZE || read_be32(data) != YAZ0_MAGIC )
+    return false;
+  size = read_be32(data + 4);
+  return true;
+}
+
+// Copies a back reference of len bytes from dist bytes behind d. Runs may
+// overlap their own output, which repeats the last dist bytes.
+static inline void copy_run(uint8_t *d, size_t dist, size_t len)
+{
+  uint8_t const *from = d - dist;
+  if ( dist == 1 )
+  {
+    memset(d, *from, len);
+  }
+  else if ( dist >= 8 )
+  {
+    // Eight bytes at a time, every chunk reads only bytes written before
+    // it. The caller leaves room for the last chunk to run over.
+    for ( size_t i = 0; i < len; i += 8 )
+      memcpy(d + i, from + i, 8);
+  }
+  else
+  {
+    for ( size_t i = 0; i < len; ++i )
+      d[i] = from[i];
+  }
+}
+
+size_t rel_yaz0_decode(uint8_t const *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+  uint8_t const *s = src;
+  uint8_t const *s_end = src + src_size;
+  uint8_t *d = dst;
+  uint8_t *d_end = dst + dst_size;
+
+  while ( d < d_end && s < s_end )
+  {
+    unsigned group = *s++;
+
+    // A whole group takes at most 24 bytes of input and 8 maximum runs of
+    // output. With that much room left nothing needs checking but the
+    // distances.
+    if ( s_end - s >= 24 && static_cast<size_t>(d_end - d) >= 8*YAZ0_MAX_RUN + 8 )
+    {
+      if ( group == 0xFF )
+      {
+        memcpy(d, s, 8);
+        d += 8;
+        s += 8;
+        continue;
+      }
+
+      for ( int i = 0; i < 8; ++i, group <<= 1 )
+      {
+        if ( group & 0x80 )
+        {
+          *d++ = *s++;
+          continue;
+        }
+
+        size_t dist = ((s[0] & 0x0F) << 8 | s[1]) + 1;
+        size_t len = s[0] >> 4;
+        s += 2;
+        len = len != 0 ? len + 2 : *s++ + 0x12;
+        if ( dist > static_cast<size_t>(d - dst) )
+          return static_cast<size_t>(d - dst);
+
+        copy_run(d, dist, len);
+        d += len;
+      }
+      continue;
+    }
+
+    // Near either end, check everything and stop exactly at dst_size
+    for ( int i = 0; i < 8 && d < d_end; ++i, group <<= 1 )
+    {
+      if ( group & 0x80 )
+      {
+        if ( s >= s_end )
+          return static_cast<size_t>(d - dst);
+        *d++ = *s++;
+        continue;
+      }
+
+      if ( s_end - s < 2 )
+        return static_cast<size_t>(d - dst);
+      size_t dist = ((s[0] & 0x0F) << 8 | s[1]) + 1;
+      size_t len = s[0] >> 4;
+      s += 2;
+      if ( len != 0 )
+      {
+        len += 2;
+      }
+      else
+      {
+        if ( s >= s_end )
+          return static_cast<size_t>(d - dst);
+        len = *s++ + 0x12;
+      }
+      if ( dist > static_cast<size_t>(d - dst) )
+        return static_cast<size_t>(d - dst);
+
+      if ( len > static_cast<size_t>(d_end - d) )
+        len = static_cast<size_t>(d_end - d);
+      uint8_t const *from = d - dist;
+      for ( size_t j = 0; j < len; ++j )
+        d[j] = from[j];
+      d += len;
+    }
+  }
+
+  return static_cast<size_t>(d - dst);
+}
+
+std::string rel_module_basename(char const *path)
+{
+  std::string name(path);
+  name = name.substr(name.find_last_of("/\\") + 1);
+
+  size_t const ext_size = sizeof(YAZ0_EXTENSION) - 1;
+  if ( name.size() > ext_size && name.compare(name.size() - ext_size, ext_size, YAZ0_EXTENSION) == 0 )
+    name.resize(name.size() - ext_size);
+  return name.substr(0, name.find_last_of('.'));
+}
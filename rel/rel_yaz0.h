@@ -0,0 +1,26 @@
+#ifndef __REL_YAZ0_H__
+#define __REL_YAZ0_H__
+
+#include "rel_format.h"
+#include <cstddef>
+#include <string>
+
+#define YAZ0_MAGIC        0x59617A30  // "Yaz0"
+#define YAZ0_HEADER_SIZE  16
+#define YAZ0_PATTERN      "*.szs"
+#define YAZ0_EXTENSION    ".szs"
+
+// Checks for a Yaz0 header, setting size to the decompressed size
+bool rel_yaz0_probe(uint8_t const *data, size_t data_size, uint32_t &size);
+
+// Inflates the stream following a Yaz0 header into dst, stopping once
+// dst_size bytes have been produced, so a small dst only decodes the
+// start of the file. Returns the number of bytes produced, which is less
+// than dst_size if the stream is truncated or damaged.
+size_t rel_yaz0_decode(uint8_t const *src, size_t src_size, uint8_t *dst, size_t dst_size);
+
+// Name of a module file without its directory and extensions, where
+// "d_a_npc.rel.szs" is "d_a_npc" like "d_a_npc.rel"
+std::string rel_module_basename(char const *path);
+
+#endif // #ifndef __REL_YAZ0_H__
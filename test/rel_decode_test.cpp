@@ -0,0 +1,197 @@
+/*
+*  Unit tests of the relocation decoder, comparing the scalar, SSE2 and
+*  AVX2 paths on the same randomized streams.
+*
+*  rel_decode_test (exits non-zero if a check fails)
+*
+*/
+
+#include "../rel/rel_decode.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#define RECORD_SIZE   8
+#define MAX_RECORDS   40      // a few times the widest vector of records
+#define MAX_SKEW      33      // unaligned starts, past a cache line
+#define NUM_SECTIONS  4
+#define SECTION_SIZE  0x100000
+
+static unsigned g_checks = 0;
+static unsigned g_failures = 0;
+
+#define CHECK(condition) check(condition, #condition, __FILE__, __LINE__)
+
+static void check(bool condition, char const *text, char const *file, int line)
+{
+  ++g_checks;
+  if (!condition)
+  {
+    printf("%s:%d: check failed: %s\n", file, line, text);
+    ++g_failures;
+  }
+}
+
+static char const * const g_path_names[] = { "scalar", "SSE2", "AVX2" };
+
+static uint32_t next_random(uint32_t &state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static void record(uint8_t *p, uint16_t offset, uint8_t type, uint8_t section, uint32_t addend)
+{
+  p[0] = static_cast<uint8_t>(offset >> 8);
+  p[1] = static_cast<uint8_t>(offset);
+  p[2] = type;
+  p[3] = section;
+  p[4] = static_cast<uint8_t>(addend >> 24);
+  p[5] = static_cast<uint8_t>(addend >> 16);
+  p[6] = static_cast<uint8_t>(addend >> 8);
+  p[7] = static_cast<uint8_t>(addend);
+}
+
+// count records that decode, then the terminator and records past it.
+// R_DOLPHIN_END shows up in every byte but the type of the records before
+// the terminator, so only the type byte may be looked at.
+static std::vector<uint8_t> make_stream(size_t count, size_t trailing, uint32_t &state)
+{
+  static uint8_t const types[] =
+  {
+    R_PPC_ADDR32, R_PPC_ADDR24, R_PPC_ADDR16_LO, R_PPC_ADDR16_HA, R_PPC_REL24, R_PPC_REL14,
+    R_PPC_NONE, R_DOLPHIN_NOP, R_DOLPHIN_SECTION, R_DOLPHIN_MRKREF,
+  };
+
+  std::vector<uint8_t> data((count + 1 + trailing) * RECORD_SIZE);
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint32_t roll = next_random(state);
+    uint8_t type = types[roll % sizeof(types)];
+    uint8_t section = (roll >> 8) & 1 ? R_DOLPHIN_END : static_cast<uint8_t>((roll >> 9) % NUM_SECTIONS);
+    if (type == R_DOLPHIN_SECTION)
+      section = static_cast<uint8_t>((roll >> 9) % NUM_SECTIONS);
+    uint16_t offset = (roll >> 12) & 1 ? 0xCBCB : static_cast<uint16_t>((roll >> 13) & 0xFC);
+    uint32_t addend = (roll >> 20) & 1 ? 0xCBCBCBCB : next_random(state);
+    record(&data[i * RECORD_SIZE], offset, type, section, addend);
+  }
+  record(&data[count * RECORD_SIZE], 0, R_DOLPHIN_END, 0, 0);
+  for (size_t i = count + 1; i < count + 1 + trailing; ++i)
+    record(&data[i * RECORD_SIZE], 0, (next_random(state) & 1) ? R_DOLPHIN_END : R_PPC_ADDR32, 0, 0);
+  return data;
+}
+
+struct decoded
+{
+  rel_decode_result m_result;
+  size_t m_scanned;
+  uint32_t m_scanned_sections;
+  rel_stream m_stream;
+};
+
+static decoded decode(uint8_t const *data, size_t size, uint32_t const *sizes)
+{
+  decoded out;
+  out.m_result = rel_decode_stream(data, size, sizes, NUM_SECTIONS, out.m_stream);
+  out.m_scanned = rel_scan_stream(data, size, out.m_scanned_sections);
+  return out;
+}
+
+static bool same(decoded const &a, decoded const &b)
+{
+  return a.m_result.m_status == b.m_result.m_status &&
+         a.m_result.m_consumed == b.m_result.m_consumed &&
+         a.m_result.m_record == b.m_result.m_record &&
+         a.m_scanned == b.m_scanned &&
+         a.m_scanned_sections == b.m_scanned_sections &&
+         a.m_stream.m_where == b.m_stream.m_where &&
+         a.m_stream.m_addend == b.m_stream.m_addend &&
+         a.m_stream.m_type == b.m_stream.m_type &&
+         a.m_stream.m_section == b.m_stream.m_section &&
+         a.m_stream.m_site == b.m_stream.m_site;
+}
+
+// Decodes data copied skew bytes past an aligned start with every path,
+// checking each against the scalar one
+static void compare_paths(std::vector<uint8_t> const &data, size_t size, size_t skew, uint32_t const *sizes,
+                          char const *what, size_t count)
+{
+  std::vector<uint64_t> storage((skew + data.size()) / sizeof(uint64_t) + 1);
+  uint8_t *p = reinterpret_cast<uint8_t *>(storage.data()) + skew;
+  std::copy(data.begin(), data.end(), p);
+
+  rel_decode_set_path(REL_DECODE_SCALAR);
+  decoded expected = decode(p, size, sizes);
+  for (int path = REL_DECODE_SSE2; path <= REL_DECODE_AVX2; ++path)
+  {
+    if (!rel_decode_set_path(static_cast<rel_decode_path>(path)))
+      continue;
+    bool matches = same(expected, decode(p, size, sizes));
+    if (!matches)
+    {
+      printf("%s:%d: %s path differs on %s, %u records, skew %u\n", __FILE__, __LINE__, g_path_names[path],
+             what, static_cast<unsigned>(count), static_cast<unsigned>(skew));
+    }
+    CHECK(matches);
+  }
+}
+
+// The terminator at every position, at every start alignment
+static void test_terminator_positions()
+{
+  uint32_t sizes[NUM_SECTIONS] = { SECTION_SIZE, SECTION_SIZE, SECTION_SIZE, SECTION_SIZE };
+  uint32_t state = 0x12345678;
+  for (size_t count = 0; count <= MAX_RECORDS; ++count)
+  {
+    for (size_t skew = 0; skew < MAX_SKEW; ++skew)
+    {
+      size_t trailing = next_random(state) % 8;
+      std::vector<uint8_t> data = make_stream(count, trailing, state);
+      compare_paths(data, data.size(), skew, sizes, "a terminated stream", count);
+
+      // Without the terminator, and with a partial record at the end
+      compare_paths(data, count * RECORD_SIZE, skew, sizes, "an unterminated stream", count);
+      compare_paths(data, count * RECORD_SIZE + 7, skew, sizes, "a partial terminator", count);
+    }
+  }
+}
+
+// Decoding errors stop at the same record on every path
+static void test_errors()
+{
+  uint32_t small[NUM_SECTIONS] = { 0x10, 0x10, 0x10, 0x10 };
+  uint32_t state = 0x9E3779B9;
+  for (size_t count = 1; count <= MAX_RECORDS; ++count)
+  {
+    for (size_t skew = 0; skew < 8; ++skew)
+    {
+      std::vector<uint8_t> data = make_stream(count, 1, state);
+      compare_paths(data, data.size(), skew, small, "small sections", count);
+
+      size_t bad = next_random(state) % count;
+      data[bad * RECORD_SIZE + 2] = R_DOLPHIN_SECTION;
+      data[bad * RECORD_SIZE + 3] = NUM_SECTIONS;
+      uint32_t sizes[NUM_SECTIONS] = { SECTION_SIZE, SECTION_SIZE, SECTION_SIZE, SECTION_SIZE };
+      compare_paths(data, data.size(), skew, sizes, "a bad section", count);
+    }
+  }
+}
+
+int main()
+{
+  for (int path = REL_DECODE_SCALAR; path <= REL_DECODE_AVX2; ++path)
+  {
+    if (!rel_decode_path_supported(static_cast<rel_decode_path>(path)))
+      printf("%s path isn't supported here, not compared\n", g_path_names[path]);
+  }
+  rel_decode_path best = rel_decode_get_path();
+
+  test_terminator_positions();
+  test_errors();
+
+  rel_decode_set_path(best);
+  printf("%u checks, %u failed\n", g_checks, g_failures);
+  return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+/*
+*  Unit tests of the relocation engine, which builds without the IDA SDK.
+*
+*  rel_engine_test (exits non-zero if a check fails)
+*
+*/
+
+#include "../rel/rel_engine.h"
+#include <cstdio>
+
+static unsigned g_checks = 0;
+static unsigned g_failures = 0;
+
+#define CHECK(condition) check(condition, #condition, __FILE__, __LINE__)
+
+static void check(bool condition, char const *text, char const *file, int line)
+{
+  ++g_checks;
+  if (!condition)
+  {
+    printf("%s:%d: check failed: %s\n", file, line, text);
+    ++g_failures;
+  }
+}
+
+// Checks the patch of a relocation that applies, down to the word written
+static void check_patch(uint8_t type, uint32_t where, uint32_t target, uint32_t original, uint32_t width, uint32_t value, int line)
+{
+  rel_patch patch;
+  rel_engine_status status = rel_compute_patch(type, where, target, original, patch);
+  check(status == REL_ENGINE_OK, "status == REL_ENGINE_OK", __FILE__, line);
+  if (status != REL_ENGINE_OK)
+    return;
+  check(patch.m_address == where, "patch.m_address == where", __FILE__, line);
+  check(patch.m_original == original, "patch.m_original == original", __FILE__, line);
+  check(patch.m_width == width, "patch.m_width == width", __FILE__, line);
+  if (patch.m_value != value)
+    printf("%s:%d: type %u wrote %08X, expected %08X\n", __FILE__, line, static_cast<unsigned>(type), patch.m_value, value);
+  check(patch.m_value == value, "patch.m_value == value", __FILE__, line);
+}
+
+static rel_engine_status compute(uint8_t type, uint32_t where, uint32_t target, uint32_t original)
+{
+  rel_patch patch;
+  return rel_compute_patch(type, where, target, original, patch);
+}
+
+#define PPC_BL      0x48000001    // bl 0
+#define PPC_BLA     0x48000003    // bla 0
+#define PPC_BEQ     0x41820000    // beq 0
+#define PPC_BEQA    0x41820002    // beqa 0
+#define PPC_BEQA_Y  0x41A20002    // beqa+ 0, the y (hint) bit of BO set
+
+static void test_absolute()
+{
+  check_patch(R_PPC_ADDR32, 0x80001000, 0x80456789, 0xDEADBEEF, 4, 0x80456789, __LINE__);
+  check_patch(R_PPC_ADDR32, 0x80001000, 0x00000000, 0xDEADBEEF, 4, 0x00000000, __LINE__);
+
+  // The opcode, AA and LK bits stay, the low bits of the target are dropped
+  check_patch(R_PPC_ADDR24, 0x80001000, 0x00001234, PPC_BLA, 4, 0x48001237, __LINE__);
+  check_patch(R_PPC_ADDR24, 0x80001000, 0x00001237, PPC_BLA, 4, 0x48001237, __LINE__);
+  check_patch(R_PPC_ADDR24, 0x80001000, 0x01FFFFFC, PPC_BLA, 4, 0x49FFFFFF, __LINE__);
+  check_patch(R_PPC_ADDR24, 0x80001000, 0xFE000000, PPC_BLA, 4, 0x4A000003, __LINE__);
+
+  // Targets past the sign extended 26 bits of the field
+  CHECK(compute(R_PPC_ADDR24, 0x80001000, 0x02000000, PPC_BLA) == REL_ENGINE_OUT_OF_RANGE);
+  CHECK(compute(R_PPC_ADDR24, 0x80001000, 0xFDFFFFFC, PPC_BLA) == REL_ENGINE_OUT_OF_RANGE);
+  CHECK(compute(R_PPC_ADDR24, 0x80001000, 0x80451234, PPC_BLA) == REL_ENGINE_OUT_OF_RANGE);
+
+  // The whole address has to fit the halfword, signed or not
+  check_patch(R_PPC_ADDR16,    0x80001002, 0x00001234, 0xFFFF, 2, 0x1234, __LINE__);
+  check_patch(R_PPC_ADDR16,    0x80001002, 0x0000FFFF, 0x0000, 2, 0xFFFF, __LINE__);
+  check_patch(R_PPC_ADDR16,    0x80001002, 0xFFFF8000, 0x0000, 2, 0x8000, __LINE__);
+  CHECK(compute(R_PPC_ADDR16, 0x80001002, 0x00010000, 0x0000) == REL_ENGINE_OUT_OF_RANGE);
+  CHECK(compute(R_PPC_ADDR16, 0x80001002, 0xFFFF7FFF, 0x0000) == REL_ENGINE_OUT_OF_RANGE);
+  CHECK(compute(R_PPC_ADDR16, 0x80001002, 0x80451234, 0x0000) == REL_ENGINE_OUT_OF_RANGE);
+
+  check_patch(R_PPC_ADDR16_LO, 0x80001002, 0x80451234, 0xFFFF, 2, 0x1234, __LINE__);
+  check_patch(R_PPC_ADDR16_LO, 0x80001002, 0x8045FFFF, 0x0000, 2, 0xFFFF, __LINE__);
+  check_patch(R_PPC_ADDR16_HI, 0x80001002, 0x80451234, 0x0000, 2, 0x8045, __LINE__);
+  check_patch(R_PPC_ADDR16_HI, 0x80001002, 0x8045FFFF, 0x0000, 2, 0x8045, __LINE__);
+}
+
+// The high half rounds up when the low half is negative as a signed
+// immediate, so lis/addi add up to the target
+static void test_high_adjusted()
+{
+  check_patch(R_PPC_ADDR16_HA, 0x80001002, 0x80451234, 0x0000, 2, 0x8045, __LINE__);
+  check_patch(R_PPC_ADDR16_HA, 0x80001002, 0x80457FFF, 0x0000, 2, 0x8045, __LINE__);
+  check_patch(R_PPC_ADDR16_HA, 0x80001002, 0x80458000, 0x0000, 2, 0x8046, __LINE__);
+  check_patch(R_PPC_ADDR16_HA, 0x80001002, 0x8045FFFF, 0x0000, 2, 0x8046, __LINE__);
+  check_patch(R_PPC_ADDR16_HA, 0x80001002, 0x7FFF8000, 0x0000, 2, 0x8000, __LINE__);
+  check_patch(R_PPC_ADDR16_HA, 0x80001002, 0xFFFF8000, 0x0000, 2, 0x0000, __LINE__);
+
+  // lis r3, ha; addi r3, r3, lo gives back the target
+  uint32_t targets[] = { 0x80458000, 0x8045FFFC, 0x80457FFC, 0x80450000 };
+  for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); ++i)
+  {
+    rel_patch ha, lo;
+    rel_compute_patch(R_PPC_ADDR16_HA, 0, targets[i], 0, ha);
+    rel_compute_patch(R_PPC_ADDR16_LO, 0, targets[i], 0, lo);
+    uint32_t sum = (ha.m_value << 16) + static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(lo.m_value)));
+    CHECK(sum == targets[i]);
+  }
+}
+
+// Like OSLink the prediction hint is left as assembled
+static void test_absolute_branches()
+{
+  check_patch(R_PPC_ADDR14,          0x80001000, 0x00001230, PPC_BEQA,   4, 0x41821232, __LINE__);
+  check_patch(R_PPC_ADDR14,          0x80001000, 0x00001233, PPC_BEQA,   4, 0x41821232, __LINE__);
+  check_patch(R_PPC_ADDR14_BRTAKEN,  0x80001000, 0x00001230, PPC_BEQA_Y, 4, 0x41A21232, __LINE__);
+  check_patch(R_PPC_ADDR14_BRTAKEN,  0x80001000, 0x00001230, PPC_BEQA,   4, 0x41821232, __LINE__);
+  check_patch(R_PPC_ADDR14_BRNTAKEN, 0x80001000, 0x00001230, PPC_BEQA,   4, 0x41821232, __LINE__);
+  check_patch(R_PPC_ADDR14_BRNTAKEN, 0x80001000, 0x00001230, PPC_BEQA_Y, 4, 0x41A21232, __LINE__);
+
+  // The first and last 32 KB of the address space, sign extended
+  check_patch(R_PPC_ADDR14, 0x80001000, 0x00007FFC, PPC_BEQA, 4, 0x41827FFE, __LINE__);
+  check_patch(R_PPC_ADDR14, 0x80001000, 0xFFFF8000, PPC_BEQA, 4, 0x41828002, __LINE__);
+  CHECK(compute(R_PPC_ADDR14, 0x80001000, 0x00008000, PPC_BEQA) == REL_ENGINE_OUT_OF_RANGE);
+  CHECK(compute(R_PPC_ADDR14, 0x80001000, 0xFFFF7FFC, PPC_BEQA) == REL_ENGINE_OUT_OF_RANGE);
+  CHECK(compute(R_PPC_ADDR14_BRTAKEN, 0x80001000, 0x80001230, PPC_BEQA_Y) == REL_ENGINE_OUT_OF_RANGE);
+  CHECK(compute(R_PPC_ADDR14_BRNTAKEN, 0x80001000, 0x80001230, PPC_BEQA) == REL_ENGINE_OUT_OF_RANGE);
+}
+
+static void test_relative_branches()
+{
+  // bl, forwards and backwards, to the limits of the 26-bit displacement
+  check_patch(R_PPC_REL24, 0x80001000, 0x80001100, PPC_BL, 4, 0x48000101, __LINE__);
+  check_patch(R_PPC_REL24, 0x80001000, 0x80000F00, PPC_BL, 4, 0x4BFFFF01, __LINE__);
+  check_patch(R_PPC_REL24, 0x80001000, 0x80001000, PPC_BL, 4, 0x48000001, __LINE__);
+  check_patch(R_PPC_REL24, 0x80001000, 0x80001000 + 0x01FFFFFC, PPC_BL, 4, 0x49FFFFFD, __LINE__);
+  check_patch(R_PPC_REL24, 0x80001000, 0x80001000 - 0x02000000, PPC_BL, 4, 0x4A000001, __LINE__);
+  CHECK(compute(R_PPC_REL24, 0x80001000, 0x80001000 + 0x02000000, PPC_BL) == REL_ENGINE_OUT_OF_RANGE);
+  CHECK(compute(R_PPC_REL24, 0x80001000, 0x80001000 - 0x02000004, PPC_BL) == REL_ENGINE_OUT_OF_RANGE);
+  CHECK(compute(R_PPC_REL24, 0x80001000, 0x00001000, PPC_BL) == REL_ENGINE_OUT_OF_RANGE);
+
+  // beq, to the limits of the 16-bit displacement
+  check_patch(R_PPC_REL14, 0x80001000, 0x80001010, PPC_BEQ, 4, 0x41820010, __LINE__);
+  check_patch(R_PPC_REL14, 0x80001000, 0x80000FF0, PPC_BEQ, 4, 0x4182FFF0, __LINE__);
+  check_patch(R_PPC_REL14, 0x80001000, 0x80001000 + 0x7FFC, PPC_BEQ, 4, 0x41827FFC, __LINE__);
+  check_patch(R_PPC_REL14, 0x80001000, 0x80001000 - 0x8000, PPC_BEQ, 4, 0x41828000, __LINE__);
+  check_patch(R_PPC_REL14, 0x80001000, 0x80001010, 0x41A20000, 4, 0x41A20010, __LINE__);
+  CHECK(compute(R_PPC_REL14, 0x80001000, 0x80001000 + 0x8000, PPC_BEQ) == REL_ENGINE_OUT_OF_RANGE);
+  CHECK(compute(R_PPC_REL14, 0x80001000, 0x80001000 - 0x8004, PPC_BEQ) == REL_ENGINE_OUT_OF_RANGE);
+}
+
+static void test_no_patch()
+{
+  CHECK(compute(R_PPC_NONE, 0x80001000, 0x80002000, 0) == REL_ENGINE_SKIPPED);
+  CHECK(compute(R_DOLPHIN_MRKREF, 0x80001000, 0x80002000, 0) == REL_ENGINE_SKIPPED);
+  CHECK(compute(12, 0x80001000, 0x80002000, 0) == REL_ENGINE_UNSUPPORTED);
+  CHECK(compute(R_DOLPHIN_NOP, 0x80001000, 0x80002000, 0) == REL_ENGINE_UNSUPPORTED);
+
+  for (unsigned type = R_PPC_NONE; type <= R_PPC_REL14; ++type)
+    CHECK(rel_type_supported(static_cast<uint8_t>(type)));
+  CHECK(rel_type_supported(R_DOLPHIN_MRKREF));
+  CHECK(!rel_type_supported(12));
+}
+
+static void push(rel_stream &stream, uint8_t type, uint32_t where, uint8_t section, uint32_t addend)
+{
+  stream.m_where.push_back(where);
+  stream.m_addend.push_back(addend);
+  stream.m_type.push_back(type);
+  stream.m_section.push_back(section);
+  stream.m_site.push_back(1);
+}
+
+// A stream against the module's own sections: NONE and MRKREF leave no
+// patch, a branch out of range is counted as failed
+static void test_relocate()
+{
+  uint8_t text[16] = { 0x48, 0x00, 0x00, 0x01, 0xDE, 0xAD, 0xBE, 0xEF, 0x3C, 0x60, 0x00, 0x00, 0x48, 0x00, 0x00, 0x01 };
+  rel_section_image images[3] =
+  {
+    { 0, 0, nullptr },
+    { 0x80001000, sizeof(text), text },
+    { 0x80002000, 0x100, nullptr },     // bss
+  };
+
+  rel_stream stream;
+  push(stream, R_PPC_NONE, 0, 1, 0);
+  push(stream, R_PPC_REL24, 0, 2, 0x10);
+  push(stream, R_DOLPHIN_MRKREF, 4, 1, 0);
+  push(stream, R_PPC_ADDR32, 4, 2, 0x20);
+  push(stream, R_PPC_ADDR16_HA, 10, 2, 0x8000);
+
+  std::vector<rel_patch> patches;
+  std::vector<rel_reference> references;
+  rel_engine_stats stats;
+  rel_engine_reset(stats);
+  CHECK(rel_relocate(stream, images, 3, images, 3, nullptr, patches, stats, &references));
+  CHECK(patches.size() == 3);
+  CHECK(stats.m_patches == 3 && stats.m_failed == 0 && stats.m_unsupported == 0);
+  CHECK(stats.m_per_type[R_PPC_NONE] == 1 && stats.m_per_type[R_DOLPHIN_MRKREF] == 1);
+  if (patches.size() == 3)
+  {
+    CHECK(patches[0].m_address == 0x80001000 && patches[0].m_value == 0x48001011);
+    CHECK(patches[1].m_address == 0x80001004 && patches[1].m_value == 0x80002020 && patches[1].m_original == 0xDEADBEEF);
+    CHECK(patches[2].m_address == 0x8000100A && patches[2].m_width == 2 && patches[2].m_value == 0x8001);
+    CHECK(patches[2].m_section == 1 && patches[2].m_offset == 10);
+  }
+
+  // Only the ADDR32 and ADDR16 relocations are references
+  CHECK(references.size() == 2);
+  if (references.size() == 2)
+  {
+    CHECK(references[0].m_type == R_PPC_ADDR32 && references[0].m_target == 0x80002020);
+    CHECK(references[1].m_type == R_PPC_ADDR16_HA && references[1].m_target == 0x8000A000);
+  }
+
+  rel_stream far;
+  push(far, R_PPC_REL24, 12, 0, 0);
+  rel_section_image distant[2] = { images[0], images[1] };
+  distant[0].m_base = 0x90000000;
+  patches.clear();
+  rel_engine_reset(stats);
+  CHECK(!rel_relocate(far, images, 3, distant, 2, nullptr, patches, stats));
+  CHECK(patches.empty() && stats.m_failed == 1);
+}
+
+static void record(uint8_t *p, uint16_t offset, uint8_t type, uint8_t section, uint32_t addend)
+{
+  write_be16(p, offset);
+  p[2] = type;
+  p[3] = section;
+  write_be32(p + 4, addend);
+}
+
+// Scanning finds the end of the records and the sections they switch to,
+// without decoding them
+static void test_scan()
+{
+  uint8_t data[6 * 8] = {};
+  record(data,      0, R_DOLPHIN_SECTION, 1, 0);
+  record(data + 8,  4, R_PPC_ADDR32, 3, 0x10);
+  record(data + 16, 0, R_DOLPHIN_SECTION, 3, 0);
+  record(data + 24, 8, R_DOLPHIN_NOP, 0, 0);
+  record(data + 32, 0, R_DOLPHIN_END, 0, 0);
+  record(data + 40, 0, R_DOLPHIN_SECTION, 5, 0);
+
+  uint32_t sections = 0;
+  CHECK(rel_scan_stream(data, sizeof(data), sections) == 40);
+  CHECK(sections == ((1u << 1) | (1u << 3)));
+  CHECK(rel_scan_stream(data, 32, sections) == 0);
+}
+
+int main()
+{
+  test_absolute();
+  test_high_adjusted();
+  test_absolute_branches();
+  test_relative_branches();
+  test_no_patch();
+  test_relocate();
+  test_scan();
+
+  printf("%u checks, %u failed\n", g_checks, g_failures);
+  return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+/*
+*  Unit tests of the linker map parser, built against the stand-in of the
+*  IDA SDK in bench/stub.
+*
+*  rel_map_test (exits non-zero if a check fails)
+*
+*/
+
+#include "../rel/rel_map.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define MAP_PATH "rel_map_test.map"
+
+static unsigned g_checks = 0;
+static unsigned g_failures = 0;
+
+#define CHECK(condition) check(condition, #condition, __FILE__, __LINE__)
+
+static void check(bool condition, char const *text, char const *file, int line)
+{
+  ++g_checks;
+  if (!condition)
+  {
+    printf("%s:%d: check failed: %s\n", file, line, text);
+    ++g_failures;
+  }
+}
+
+// A section layout with one object entry and a symbol per size, laid out
+// back to back from offset 0
+static std::string layout(char const *section, std::vector<uint32_t> const &sizes, char const *prefix)
+{
+  std::string out = std::string(section) + " section layout\n";
+  out += "  Starting        Virtual  File\n  address  Size   address  offset\n  ---------------------------------\n";
+
+  uint32_t total = 0;
+  for (size_t i = 0; i < sizes.size(); ++i)
+    total += sizes[i];
+
+  char line[160];
+  if (total != 0)
+  {
+    snprintf(line, sizeof(line), "  %08x %06x %08x 000000e0  1 %s \tobject.o \n", 0, total, 0, section);
+    out += line;
+  }
+  uint32_t offset = 0;
+  for (size_t i = 0; i < sizes.size(); ++i)
+  {
+    snprintf(line, sizeof(line), "  %08x %06x %08x 000000e0  4 %s_%u \tobject.o \n", offset, sizes[i], 0, prefix, static_cast<unsigned>(i));
+    out += line;
+    offset += sizes[i];
+  }
+  return out + "\n\n";
+}
+
+static bool load(rel_map &map, std::string const &text)
+{
+  FILE *fp = fopen(MAP_PATH, "wb");
+  if (fp == nullptr)
+    return false;
+  bool written = fwrite(text.data(), 1, text.size(), fp) == text.size();
+  written = fclose(fp) == 0 && written;
+  bool loaded = written && map.load(MAP_PATH, false);
+  remove(MAP_PATH);
+  return loaded;
+}
+
+static section_entry section(uint32_t offset, uint32_t size, bool exec)
+{
+  section_entry entry;
+  entry.file_offset = offset | (exec ? SECTION_EXEC : 0);
+  entry.size = size;
+  return entry;
+}
+
+static bool named(char const *name, char const *expected)
+{
+  return name != nullptr && strcmp(name, expected) == 0;
+}
+
+// The usual CodeWarrior order: .text, .ctors, .dtors, .rodata, .data, .bss
+static std::vector<section_entry> default_sections()
+{
+  std::vector<section_entry> sections;
+  sections.push_back(section(0, 0, false));
+  sections.push_back(section(0x100, 0x30, true));
+  sections.push_back(section(0x130, 0x4, false));
+  sections.push_back(section(0x134, 0x4, false));
+  sections.push_back(section(0x138, 0x8, false));
+  sections.push_back(section(0x140, 0x20, false));
+  sections.push_back(section(0, 0x10, false));
+  return sections;
+}
+
+static std::string default_map()
+{
+  return layout(".text", std::vector<uint32_t>{ 0x10, 0x20 }, "function") +
+         layout(".ctors", std::vector<uint32_t>{ 0x4 }, "ctors") +
+         layout(".dtors", std::vector<uint32_t>{ 0x4 }, "dtors") +
+         layout(".rodata", std::vector<uint32_t>{ 0x8 }, "constant") +
+         layout(".data", std::vector<uint32_t>{ 0x10, 0x10 }, "object") +
+         layout(".bss", std::vector<uint32_t>{ 0x10 }, "zero");
+}
+
+static void test_default_layout()
+{
+  rel_map map;
+  std::string mismatch;
+  CHECK(load(map, default_map()));
+  CHECK(map.size() == 8);
+  CHECK(map.get_sections().size() == 6);
+  CHECK(map.match_sections(default_sections(), mismatch));
+  CHECK(map.size() == 8);
+
+  CHECK(named(map.find(1, 0x10), "function_1"));
+  CHECK(named(map.find(2, 0), "ctors_0"));
+  CHECK(named(map.find(4, 0), "constant_0"));
+  CHECK(named(map.find(5, 0x10), "object_1"));
+  CHECK(named(map.find(6, 0), "zero_0"));
+  CHECK(map.get_sections()[4].m_name == ".data");
+  CHECK(map.get_sections()[4].m_size == 0x20);
+  CHECK(map.get_sections()[4].m_index == 5);
+}
+
+// .init ahead of .text, and .sdata after .data, as in some SDK modules
+static void test_other_layout()
+{
+  std::vector<section_entry> sections;
+  sections.push_back(section(0, 0, false));
+  sections.push_back(section(0x100, 0x8, true));    // .init
+  sections.push_back(section(0x108, 0x30, true));   // .text
+  sections.push_back(section(0x138, 0x4, false));   // .ctors
+  sections.push_back(section(0x13C, 0x4, false));   // .dtors
+  sections.push_back(section(0, 0, false));         // unused
+  sections.push_back(section(0x140, 0x20, false));  // .data
+  sections.push_back(section(0x160, 0x8, false));   // .sdata
+  sections.push_back(section(0, 0x10, false));      // .bss
+
+  std::vector<uint32_t> none;
+  std::string text = layout(".init", std::vector<uint32_t>{ 0x8 }, "init") +
+                     layout(".text", std::vector<uint32_t>{ 0x10, 0x20 }, "function") +
+                     layout(".ctors", std::vector<uint32_t>{ 0x4 }, "ctors") +
+                     layout(".dtors", none, "dtors") +
+                     layout(".data", std::vector<uint32_t>{ 0x10, 0x10 }, "object") +
+                     layout(".sdata", std::vector<uint32_t>{ 0x8 }, "small") +
+                     layout(".bss", std::vector<uint32_t>{ 0x10 }, "zero");
+
+  rel_map map;
+  std::string mismatch;
+  CHECK(load(map, text));
+  CHECK(map.match_sections(sections, mismatch));
+  CHECK(map.size() == 8);
+
+  // The CodeWarrior order would have put .text symbols in .init
+  CHECK(named(map.find(1, 0), "init_0"));
+  CHECK(named(map.find(2, 0), "function_0"));
+  CHECK(named(map.find(2, 0x10), "function_1"));
+  CHECK(named(map.find(3, 0), "ctors_0"));
+  CHECK(map.get_sections()[3].m_index == 0);
+  CHECK(named(map.find(6, 0x10), "object_1"));
+  CHECK(named(map.find(7, 0), "small_0"));
+  CHECK(named(map.find(8, 0), "zero_0"));
+  CHECK(map.find(5, 0) == nullptr);
+
+  // The symbols stay sorted for lookups
+  for (size_t i = 1; i < map.size(); ++i)
+  {
+    rel_map_symbol const &a = map.get_symbol(i - 1);
+    rel_map_symbol const &b = map.get_symbol(i);
+    CHECK(a.m_section < b.m_section || (a.m_section == b.m_section && a.m_offset < b.m_offset));
+  }
+}
+
+// Maps of another build are refused rather than misplacing symbols
+static void test_mismatch()
+{
+  rel_map map;
+  std::string mismatch;
+
+  // .text grew past the module's
+  std::vector<section_entry> sections = default_sections();
+  sections[1].size = 0x20;
+  CHECK(load(map, default_map()));
+  CHECK(!map.match_sections(sections, mismatch));
+  CHECK(mismatch == ".text");
+
+  // No bss section for .bss
+  sections = default_sections();
+  sections.pop_back();
+  CHECK(load(map, default_map()));
+  CHECK(!map.match_sections(sections, mismatch));
+  CHECK(mismatch == ".bss");
+
+  // Code where the module has data
+  sections = default_sections();
+  sections[1].file_offset &= ~SECTION_EXEC;
+  CHECK(load(map, default_map()));
+  CHECK(!map.match_sections(sections, mismatch));
+  CHECK(mismatch == ".text");
+}
+
+int main()
+{
+  test_default_layout();
+  test_other_layout();
+  test_mismatch();
+
+  printf("%u checks, %u failed\n", g_checks, g_failures);
+  return g_failures == 0 ? 0 : 1;
+}